@@ -0,0 +1,558 @@
+// Generated by specialize from profile/profile_config.json. Do not edit.
+//
+// evolve_specialized() is equivalent to evolve() for a 300x300 world with these populations:
+//     0: "Plant A"
+//     1: "Plant B"
+//     2: "Plant C"
+//     3: "Herbivore"
+//     4: "Carnivore"
+
+// Return true if evolve_specialized() may be used in place of evolve() for the given parameters.
+bool evolve_specialized_applies(simulation_params const* params) {
+    if (params->w != 300 || params->h != 300 || params->population_count != 5) {
+        return false;
+    }
+    population_params const*const p = params->populations;
+    return true
+        && p[0].motile == false
+        && p[0].trophic_level == 0
+        && p[0].energy_at_birth == 1
+        && p[0].energy_maximum == 2
+        && p[0].energy_threshold_replicate == 2
+        && p[0].energy_cost_replicate == 1
+        && p[0].energy_gain == 2
+        && p[0].energy_cost_move == 0
+        && p[0].replication_space_needed == 5
+        && p[0].neighborhood == NEIGHBORHOOD_MOORE
+        && p[0].neighborhood_radius == 1
+        && p[1].motile == false
+        && p[1].trophic_level == 0
+        && p[1].energy_at_birth == 1
+        && p[1].energy_maximum == 3
+        && p[1].energy_threshold_replicate == 3
+        && p[1].energy_cost_replicate == 1
+        && p[1].energy_gain == 2
+        && p[1].energy_cost_move == 0
+        && p[1].replication_space_needed == 4
+        && p[1].neighborhood == NEIGHBORHOOD_MOORE
+        && p[1].neighborhood_radius == 1
+        && p[2].motile == false
+        && p[2].trophic_level == 0
+        && p[2].energy_at_birth == 1
+        && p[2].energy_maximum == 3
+        && p[2].energy_threshold_replicate == 3
+        && p[2].energy_cost_replicate == 1
+        && p[2].energy_gain == 3
+        && p[2].energy_cost_move == 0
+        && p[2].replication_space_needed == 3
+        && p[2].neighborhood == NEIGHBORHOOD_MOORE
+        && p[2].neighborhood_radius == 1
+        && p[3].motile == true
+        && p[3].trophic_level == 1
+        && p[3].energy_at_birth == 10
+        && p[3].energy_maximum == 20
+        && p[3].energy_threshold_replicate == 20
+        && p[3].energy_cost_replicate == 10
+        && p[3].energy_gain == 0
+        && p[3].energy_cost_move == 1
+        && p[3].replication_space_needed == 6
+        && p[3].neighborhood == NEIGHBORHOOD_MOORE
+        && p[3].neighborhood_radius == 1
+        && p[4].motile == true
+        && p[4].trophic_level == 2
+        && p[4].energy_at_birth == 100
+        && p[4].energy_maximum == 500
+        && p[4].energy_threshold_replicate == 500
+        && p[4].energy_cost_replicate == 200
+        && p[4].energy_gain == 0
+        && p[4].energy_cost_move == 3
+        && p[4].replication_space_needed == 8
+        && p[4].neighborhood == NEIGHBORHOOD_MOORE
+        && p[4].neighborhood_radius == 1;
+}
+
+// Take one time step.
+void evolve_specialized(world* wld) {
+    organism* const map = wld->map;
+    u32* const tally = wld->pop_tally;
+    u32* const directions = wld->directions;
+    u64 const key_first_pass = evolve_rand_key(wld, 0);
+    u64 const key_second_pass = evolve_rand_key(wld, 1);
+
+    // First pass: Each organism decides which direction to move.
+    for (u16 y = 0; y < 300; ++y) {
+        u16 const ys[3] = { (u16)(y == 0 ? 299 : y - 1), y, (u16)(y == 299 ? 0 : y + 1) };
+        for (u16 x = 0; x < 300; ++x) {
+            size_t const c = 5u * ((size_t)y * 300u + x);
+            u16 const xs[3] = { (u16)(x == 0 ? 299 : x - 1), x, (u16)(x == 299 ? 0 : x + 1) };
+            size_t const n[8] = {
+                5u * ((size_t)ys[0] * 300u + xs[0]), 5u * ((size_t)ys[0] * 300u + xs[1]), 5u * ((size_t)ys[0] * 300u + xs[2]),
+                5u * ((size_t)ys[1] * 300u + xs[0]), 5u * ((size_t)ys[1] * 300u + xs[2]),
+                5u * ((size_t)ys[2] * 300u + xs[0]), 5u * ((size_t)ys[2] * 300u + xs[1]), 5u * ((size_t)ys[2] * 300u + xs[2]),
+            };
+            if (x == 0) {
+                evolve_draw_directions(wld, key_first_pass, y, directions);
+            }
+            {
+                organism* const org = &map[c + 0];
+                org->existed = org->exists;
+                if (org->exists) {
+                    org->energy += 2;
+                    int const living_neighbors =
+                          map[n[0] + 0].exists
+                        + map[n[1] + 0].exists
+                        + map[n[2] + 0].exists
+                        + map[n[3] + 0].exists
+                        + map[n[4] + 0].exists
+                        + map[n[5] + 0].exists
+                        + map[n[6] + 0].exists
+                        + map[n[7] + 0].exists;
+                    bool const org_can_replicate =
+                        org->energy >= 2 && living_neighbors <= 3;
+                    org->ready_to_replicate = org_can_replicate;
+                    if (org_can_replicate) {
+                        u32 ru = directions[5u * x + 0];
+                        if (ru >= 4)
+                            ++ru;
+                        org->target = (point){ .x = xs[ru / 3], .y = ys[ru % 3] };
+                        map[5u * ((size_t)org->target.y * 300u + org->target.x) + 0].contenders |=
+                            evolve_contender_bit(1 - (i32)(ru / 3), 1 - (i32)(ru % 3));
+                    } else {
+                        org->target = (point){ .x = x, .y = y };
+                    }
+                }
+            }
+            {
+                organism* const org = &map[c + 1];
+                org->existed = org->exists;
+                if (org->exists) {
+                    org->energy += 2;
+                    int const living_neighbors =
+                          map[n[0] + 1].exists
+                        + map[n[1] + 1].exists
+                        + map[n[2] + 1].exists
+                        + map[n[3] + 1].exists
+                        + map[n[4] + 1].exists
+                        + map[n[5] + 1].exists
+                        + map[n[6] + 1].exists
+                        + map[n[7] + 1].exists;
+                    bool const org_can_replicate =
+                        org->energy >= 3 && living_neighbors <= 4;
+                    org->ready_to_replicate = org_can_replicate;
+                    if (org_can_replicate) {
+                        u32 ru = directions[5u * x + 1];
+                        if (ru >= 4)
+                            ++ru;
+                        org->target = (point){ .x = xs[ru / 3], .y = ys[ru % 3] };
+                        map[5u * ((size_t)org->target.y * 300u + org->target.x) + 1].contenders |=
+                            evolve_contender_bit(1 - (i32)(ru / 3), 1 - (i32)(ru % 3));
+                    } else {
+                        org->target = (point){ .x = x, .y = y };
+                    }
+                }
+            }
+            {
+                organism* const org = &map[c + 2];
+                org->existed = org->exists;
+                if (org->exists) {
+                    org->energy += 3;
+                    int const living_neighbors =
+                          map[n[0] + 2].exists
+                        + map[n[1] + 2].exists
+                        + map[n[2] + 2].exists
+                        + map[n[3] + 2].exists
+                        + map[n[4] + 2].exists
+                        + map[n[5] + 2].exists
+                        + map[n[6] + 2].exists
+                        + map[n[7] + 2].exists;
+                    bool const org_can_replicate =
+                        org->energy >= 3 && living_neighbors <= 5;
+                    org->ready_to_replicate = org_can_replicate;
+                    if (org_can_replicate) {
+                        u32 ru = directions[5u * x + 2];
+                        if (ru >= 4)
+                            ++ru;
+                        org->target = (point){ .x = xs[ru / 3], .y = ys[ru % 3] };
+                        map[5u * ((size_t)org->target.y * 300u + org->target.x) + 2].contenders |=
+                            evolve_contender_bit(1 - (i32)(ru / 3), 1 - (i32)(ru % 3));
+                    } else {
+                        org->target = (point){ .x = x, .y = y };
+                    }
+                }
+            }
+            {
+                organism* const org = &map[c + 3];
+                org->existed = org->exists;
+                if (org->exists) {
+                    int const living_neighbors =
+                          map[n[0] + 3].exists
+                        + map[n[1] + 3].exists
+                        + map[n[2] + 3].exists
+                        + map[n[3] + 3].exists
+                        + map[n[4] + 3].exists
+                        + map[n[5] + 3].exists
+                        + map[n[6] + 3].exists
+                        + map[n[7] + 3].exists;
+                    bool const org_can_replicate =
+                        org->energy >= 20 && living_neighbors <= 2;
+                    org->ready_to_replicate = org_can_replicate;
+                    {
+                        u32 ru = directions[5u * x + 3];
+                        if (ru >= 4)
+                            ++ru;
+                        org->target = (point){ .x = xs[ru / 3], .y = ys[ru % 3] };
+                        map[5u * ((size_t)org->target.y * 300u + org->target.x) + 3].contenders |=
+                            evolve_contender_bit(1 - (i32)(ru / 3), 1 - (i32)(ru % 3));
+                    }
+                }
+            }
+            {
+                organism* const org = &map[c + 4];
+                org->existed = org->exists;
+                if (org->exists) {
+                    int const living_neighbors =
+                          map[n[0] + 4].exists
+                        + map[n[1] + 4].exists
+                        + map[n[2] + 4].exists
+                        + map[n[3] + 4].exists
+                        + map[n[4] + 4].exists
+                        + map[n[5] + 4].exists
+                        + map[n[6] + 4].exists
+                        + map[n[7] + 4].exists;
+                    bool const org_can_replicate =
+                        org->energy >= 500 && living_neighbors <= 0;
+                    org->ready_to_replicate = org_can_replicate;
+                    {
+                        u32 ru = directions[5u * x + 4];
+                        if (ru >= 4)
+                            ++ru;
+                        org->target = (point){ .x = xs[ru / 3], .y = ys[ru % 3] };
+                        map[5u * ((size_t)org->target.y * 300u + org->target.x) + 4].contenders |=
+                            evolve_contender_bit(1 - (i32)(ru / 3), 1 - (i32)(ru % 3));
+                    }
+                }
+            }
+        }
+    }
+
+    // Second pass: Organisms move or replicate to targets, with uniformly random choice when there is
+    // contention for the same cell.
+    for (u16 y = 0; y < 300; ++y) {
+        for (u16 x = 0; x < 300; ++x) {
+            size_t const c = 5u * ((size_t)y * 300u + x);
+            {
+                organism* const winner = &map[c + 0];
+                point const to = winner->target;
+                if (winner->exists && (to.x != x || to.y != y)) {
+                    i32 const dx = to.x == x ? 0 : (to.x == (x == 299 ? 0 : x + 1) ? 1 : -1);
+                    i32 const dy = to.y == y ? 0 : (to.y == (y == 299 ? 0 : y + 1) ? 1 : -1);
+                    u8 const mine = evolve_contender_bit(-dx, -dy);
+                    organism* const org = &map[5u * ((size_t)to.y * 300u + to.x) + 0];
+                    if ((org->contenders & mine) && org->existed) {
+                        org->contenders = 0;
+                    } else if (org->contenders & mine) {
+                        if (org->contenders != mine) {
+                            u8 k = 0;
+                            u8 drawn = 0;
+                            for (u8 bits = org->contenders; bits; bits &= (u8)(bits - 1)) {
+                                ++k;
+                                if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, to.x, to.y, 0, k)) {
+                                    drawn = bits & (u8)-bits;
+                                }
+                            }
+                            org->contenders = drawn;
+                        }
+                        if (org->contenders == mine) {
+                            org->contenders = 0;
+                            {
+                                *org = (organism){
+                                    .birthday = wld->step,
+                                    .energy = 1,
+                                    .kills = 0,
+                                    .exists = true,
+                                };
+                                ++tally[0];
+                                if (winner->energy > 1) {
+                                    winner->energy -= 1;
+                                } else {
+                                    winner->energy = 0;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            {
+                organism* const winner = &map[c + 1];
+                point const to = winner->target;
+                if (winner->exists && (to.x != x || to.y != y)) {
+                    i32 const dx = to.x == x ? 0 : (to.x == (x == 299 ? 0 : x + 1) ? 1 : -1);
+                    i32 const dy = to.y == y ? 0 : (to.y == (y == 299 ? 0 : y + 1) ? 1 : -1);
+                    u8 const mine = evolve_contender_bit(-dx, -dy);
+                    organism* const org = &map[5u * ((size_t)to.y * 300u + to.x) + 1];
+                    if ((org->contenders & mine) && org->existed) {
+                        org->contenders = 0;
+                    } else if (org->contenders & mine) {
+                        if (org->contenders != mine) {
+                            u8 k = 0;
+                            u8 drawn = 0;
+                            for (u8 bits = org->contenders; bits; bits &= (u8)(bits - 1)) {
+                                ++k;
+                                if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, to.x, to.y, 1, k)) {
+                                    drawn = bits & (u8)-bits;
+                                }
+                            }
+                            org->contenders = drawn;
+                        }
+                        if (org->contenders == mine) {
+                            org->contenders = 0;
+                            {
+                                *org = (organism){
+                                    .birthday = wld->step,
+                                    .energy = 1,
+                                    .kills = 0,
+                                    .exists = true,
+                                };
+                                ++tally[1];
+                                if (winner->energy > 1) {
+                                    winner->energy -= 1;
+                                } else {
+                                    winner->energy = 0;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            {
+                organism* const winner = &map[c + 2];
+                point const to = winner->target;
+                if (winner->exists && (to.x != x || to.y != y)) {
+                    i32 const dx = to.x == x ? 0 : (to.x == (x == 299 ? 0 : x + 1) ? 1 : -1);
+                    i32 const dy = to.y == y ? 0 : (to.y == (y == 299 ? 0 : y + 1) ? 1 : -1);
+                    u8 const mine = evolve_contender_bit(-dx, -dy);
+                    organism* const org = &map[5u * ((size_t)to.y * 300u + to.x) + 2];
+                    if ((org->contenders & mine) && org->existed) {
+                        org->contenders = 0;
+                    } else if (org->contenders & mine) {
+                        if (org->contenders != mine) {
+                            u8 k = 0;
+                            u8 drawn = 0;
+                            for (u8 bits = org->contenders; bits; bits &= (u8)(bits - 1)) {
+                                ++k;
+                                if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, to.x, to.y, 2, k)) {
+                                    drawn = bits & (u8)-bits;
+                                }
+                            }
+                            org->contenders = drawn;
+                        }
+                        if (org->contenders == mine) {
+                            org->contenders = 0;
+                            {
+                                *org = (organism){
+                                    .birthday = wld->step,
+                                    .energy = 1,
+                                    .kills = 0,
+                                    .exists = true,
+                                };
+                                ++tally[2];
+                                if (winner->energy > 1) {
+                                    winner->energy -= 1;
+                                } else {
+                                    winner->energy = 0;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            {
+                organism* const winner = &map[c + 3];
+                point const to = winner->target;
+                if (winner->exists && (to.x != x || to.y != y)) {
+                    i32 const dx = to.x == x ? 0 : (to.x == (x == 299 ? 0 : x + 1) ? 1 : -1);
+                    i32 const dy = to.y == y ? 0 : (to.y == (y == 299 ? 0 : y + 1) ? 1 : -1);
+                    u8 const mine = evolve_contender_bit(-dx, -dy);
+                    organism* const org = &map[5u * ((size_t)to.y * 300u + to.x) + 3];
+                    if ((org->contenders & mine) && org->existed) {
+                        org->contenders = 0;
+                    } else if (org->contenders & mine) {
+                        if (org->contenders != mine) {
+                            u8 k = 0;
+                            u8 drawn = 0;
+                            for (u8 bits = org->contenders; bits; bits &= (u8)(bits - 1)) {
+                                ++k;
+                                if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, to.x, to.y, 3, k)) {
+                                    drawn = bits & (u8)-bits;
+                                }
+                            }
+                            org->contenders = drawn;
+                        }
+                        if (org->contenders == mine) {
+                            org->contenders = 0;
+                            if (winner->ready_to_replicate) {
+                                *org = (organism){
+                                    .birthday = wld->step,
+                                    .energy = 10,
+                                    .kills = 0,
+                                    .exists = true,
+                                };
+                                ++tally[3];
+                                if (winner->energy > 10) {
+                                    winner->energy -= 10;
+                                } else {
+                                    winner->energy = 0;
+                                }
+                            } else {
+                                *org = *winner;
+                                *winner = (organism){ .existed = true };
+                                if (org->energy > 1) {
+                                    org->energy -= 1;
+                                } else {
+                                    org->energy = 0;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            {
+                organism* const winner = &map[c + 4];
+                point const to = winner->target;
+                if (winner->exists && (to.x != x || to.y != y)) {
+                    i32 const dx = to.x == x ? 0 : (to.x == (x == 299 ? 0 : x + 1) ? 1 : -1);
+                    i32 const dy = to.y == y ? 0 : (to.y == (y == 299 ? 0 : y + 1) ? 1 : -1);
+                    u8 const mine = evolve_contender_bit(-dx, -dy);
+                    organism* const org = &map[5u * ((size_t)to.y * 300u + to.x) + 4];
+                    if ((org->contenders & mine) && org->existed) {
+                        org->contenders = 0;
+                    } else if (org->contenders & mine) {
+                        if (org->contenders != mine) {
+                            u8 k = 0;
+                            u8 drawn = 0;
+                            for (u8 bits = org->contenders; bits; bits &= (u8)(bits - 1)) {
+                                ++k;
+                                if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, to.x, to.y, 4, k)) {
+                                    drawn = bits & (u8)-bits;
+                                }
+                            }
+                            org->contenders = drawn;
+                        }
+                        if (org->contenders == mine) {
+                            org->contenders = 0;
+                            if (winner->ready_to_replicate) {
+                                *org = (organism){
+                                    .birthday = wld->step,
+                                    .energy = 100,
+                                    .kills = 0,
+                                    .exists = true,
+                                };
+                                ++tally[4];
+                                if (winner->energy > 200) {
+                                    winner->energy -= 200;
+                                } else {
+                                    winner->energy = 0;
+                                }
+                            } else {
+                                *org = *winner;
+                                *winner = (organism){ .existed = true };
+                                if (org->energy > 3) {
+                                    org->energy -= 3;
+                                } else {
+                                    org->energy = 0;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Third pass: Predation and death.
+    for (u16 y = 0; y < 300; ++y) {
+        for (u16 x = 0; x < 300; ++x) {
+            size_t const c = 5u * ((size_t)y * 300u + x);
+            {
+                organism* const org = &map[c + 0];
+                if (org->exists) {
+                    if (org->energy == 0) {
+                        *org = (organism){0};
+                        --tally[0];
+                    }
+                    org->energy = MIN(2, org->energy);
+                }
+            }
+            {
+                organism* const org = &map[c + 1];
+                if (org->exists) {
+                    if (org->energy == 0) {
+                        *org = (organism){0};
+                        --tally[1];
+                    }
+                    org->energy = MIN(3, org->energy);
+                }
+            }
+            {
+                organism* const org = &map[c + 2];
+                if (org->exists) {
+                    if (org->energy == 0) {
+                        *org = (organism){0};
+                        --tally[2];
+                    }
+                    org->energy = MIN(3, org->energy);
+                }
+            }
+            {
+                organism* const org = &map[c + 3];
+                if (org->exists) {
+                    organism* const prey_0 = &map[c + 0];
+                    if (prey_0->exists) {
+                        org->energy += prey_0->energy;
+                        *prey_0 = (organism){0};
+                        --tally[0];
+                        ++org->kills;
+                    }
+                    organism* const prey_1 = &map[c + 1];
+                    if (prey_1->exists) {
+                        org->energy += prey_1->energy;
+                        *prey_1 = (organism){0};
+                        --tally[1];
+                        ++org->kills;
+                    }
+                    organism* const prey_2 = &map[c + 2];
+                    if (prey_2->exists) {
+                        org->energy += prey_2->energy;
+                        *prey_2 = (organism){0};
+                        --tally[2];
+                        ++org->kills;
+                    }
+                    if (org->energy == 0) {
+                        *org = (organism){0};
+                        --tally[3];
+                    }
+                    org->energy = MIN(20, org->energy);
+                }
+            }
+            {
+                organism* const org = &map[c + 4];
+                if (org->exists) {
+                    organism* const prey_3 = &map[c + 3];
+                    if (prey_3->exists) {
+                        org->energy += prey_3->energy;
+                        *prey_3 = (organism){0};
+                        --tally[3];
+                        ++org->kills;
+                    }
+                    if (org->energy == 0) {
+                        *org = (organism){0};
+                        --tally[4];
+                    }
+                    org->energy = MIN(500, org->energy);
+                }
+            }
+        }
+    }
+
+    ++wld->step;
+}
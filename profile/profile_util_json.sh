@@ -1,9 +1,15 @@
 #!/bin/env bash
 
-if [ "$#" -ne 1 ]
+# Benchmark the JSON parser on the given files, or on the generated corpus (see `make json_corpus`).
+# Build first with `make json_bench`.
+
+if [ "$#" -eq 0 ]
 then
-  echo "Usage: profile_util_json.sh <large_test_file.json>"
-  exit 1
+  if [ ! -d ../build/json_corpus ]
+  then
+    python3 ../scripts/gen_json_corpus.py ../build/json_corpus || exit 1
+  fi
+  set -- ../build/json_corpus/*.json
 fi
 
-hyperfine "../build/util_json_test $1"
+../build/json_bench "$@"
@@ -0,0 +1,157 @@
+#!/bin/env python3
+
+# Generate a reproducible corpus of JSON files for benchmarking the parser in src/util.c (see src/json_bench.c). Each
+# file stresses a different part of the parser. The same seed and scale always give the same files.
+
+import argparse
+import pathlib
+import random
+
+
+def write_deep_nesting(f, rng, scale):
+    # Many values, each nested hundreds of levels deep, alternating between objects and arrays.
+    f.write('[\n')
+    n = 2000 * scale
+    for i in range(n):
+        depth = rng.randint(16, 500)
+        opened = []
+        for d in range(depth):
+            if d % 2 == 0:
+                f.write('{"level_%d": ' % d)
+                opened.append('}')
+            else:
+                f.write('[%d, ' % rng.randint(-1000, 1000))
+                opened.append(']')
+        f.write('null')
+        f.write(''.join(reversed(opened)))
+        f.write(',\n' if i + 1 < n else '\n')
+    f.write(']\n')
+
+
+def write_flat_array(f, rng, scale):
+    # One huge array of small scalars.
+    n = 1_500_000 * scale
+    scalars = ['true', 'false', 'null', '"a"', '"bc"', '""']
+    f.write('[')
+    for i in range(n):
+        if i:
+            f.write(',')
+        r = rng.random()
+        if r < 0.6:
+            f.write(str(rng.randint(-100000, 100000)))
+        else:
+            f.write(rng.choice(scalars))
+    f.write(']\n')
+
+
+def random_string(rng, length):
+    # Mostly ASCII, with escape sequences and some UTF-8.
+    pieces = []
+    while length > 0:
+        r = rng.random()
+        if r < 0.05:
+            pieces.append(rng.choice(['\\"', '\\\\', '\\n', '\\t', '\\/', '\\r', '\\b', '\\f']))
+        elif r < 0.07:
+            pieces.append(rng.choice(['é', 'ß', '→', '漢']))
+        elif r < 0.08:
+            pieces.append('\\u%04x' % rng.randint(0x20, 0xFFFF))
+        else:
+            run = rng.randint(1, 40)
+            pieces.append(''.join(rng.choice('abcdefghijklmnopqrstuvwxyz      ') for _ in range(run)))
+        length -= len(pieces[-1])
+    return ''.join(pieces)
+
+
+def write_long_strings(f, rng, scale):
+    # Long strings, from one to 64 KiB, with escapes.
+    f.write('[\n')
+    n = 400 * scale
+    for i in range(n):
+        f.write('  "%s"' % random_string(rng, rng.randint(1 << 10, 1 << 16)))
+        f.write(',\n' if i + 1 < n else '\n')
+    f.write(']\n')
+
+
+def random_number(rng):
+    r = rng.random()
+    if r < 0.3:
+        return str(rng.randint(-10**9, 10**9))
+    elif r < 0.4:
+        return str(rng.randint(-10**18, 10**18))
+    elif r < 0.6:
+        digits = rng.randint(1, 12)
+        return '%.*f' % (digits, rng.uniform(-1e4, 1e4))
+    elif r < 0.8:
+        # As Python writes floats: the shortest repr, up to 17 digits, with an exponent when very small or large.
+        return repr(rng.uniform(-1, 1) * 10.0 ** rng.randint(-12, 24))
+    else:
+        # Like learning rates and tolerances.
+        return '%.*e' % (rng.randint(0, 6), rng.uniform(1, 10) * 10.0 ** rng.randint(-300, 300))
+
+
+def write_numeric(f, rng, scale):
+    # Rows of numbers, like a recorded trajectory.
+    f.write('{"rows": [\n')
+    n = 40_000 * scale
+    for i in range(n):
+        f.write('  [%s]' % ', '.join(random_number(rng) for _ in range(16)))
+        f.write(',\n' if i + 1 < n else '\n')
+    f.write(']}\n')
+
+
+def write_many_keys(f, rng, scale):
+    # One object with very many keys, each holding a small object, like named regions.
+    f.write('{\n')
+    n = 100_000 * scale
+    for i in range(n):
+        f.write('  "region_%07d": {"x": %d, "y": %d, "species": "s%d", "density": %.3f}' % (
+            i, rng.randint(0, 4096), rng.randint(0, 4096), rng.randint(0, 50), rng.random()))
+        f.write(',\n' if i + 1 < n else '\n')
+    f.write('}\n')
+
+
+def write_records(f, rng, scale):
+    # Pretty-printed records of mixed types, like a batch job list: mostly whitespace and short tokens.
+    f.write('[\n')
+    n = 50_000 * scale
+    for i in range(n):
+        f.write('    {\n')
+        f.write('        "id": %d,\n' % i)
+        f.write('        "name": "job %s",\n' % random_string(rng, rng.randint(4, 24)))
+        f.write('        "enabled": %s,\n' % rng.choice(['true', 'false']))
+        f.write('        "priority": %s,\n' % random_number(rng))
+        f.write('        "tags": [%s],\n' % ', '.join('"t%d"' % rng.randint(0, 99) for _ in range(rng.randint(0, 6))))
+        f.write('        "parent": %s\n' % (str(rng.randint(0, i)) if i and rng.random() < 0.5 else 'null'))
+        f.write('    }' + (',\n' if i + 1 < n else '\n'))
+    f.write(']\n')
+
+
+CORPUS = {
+    'deep_nesting': write_deep_nesting,
+    'flat_array': write_flat_array,
+    'long_strings': write_long_strings,
+    'numeric': write_numeric,
+    'many_keys': write_many_keys,
+    'records': write_records,
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate a reproducible JSON benchmark corpus.')
+    parser.add_argument('out_dir', type=pathlib.Path, help='Directory to write the files into.')
+    parser.add_argument('--seed', type=int, default=1, help='Random seed (default: 1).')
+    parser.add_argument('--scale', type=int, default=1, help='Multiply the size of each file (default: 1).')
+    args = parser.parse_args()
+
+    args.out_dir.mkdir(parents=True, exist_ok=True)
+    for name, write in CORPUS.items():
+        # Seed each file separately, so that files don't change when others are added.
+        rng = random.Random('%d/%s' % (args.seed, name))
+        path = args.out_dir / (name + '.json')
+        with open(path, 'w', encoding='utf-8', newline='\n') as f:
+            write(f, rng, args.scale)
+        print('%s: %.1f MB' % (path, path.stat().st_size / 1e6))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,102 @@
+#!/bin/env python3
+
+# Generate src/pow5_table.h: 128-bit approximations of powers of five, for converting between decimal and binary
+# floating point in src/util.c:
+#  - For parsing, by the Eisel-Lemire algorithm in json_decimal_to_double(). This follows the reference implementation
+#    in fast_float (https://github.com/fastfloat/fast_float), which has the proofs of why these approximations suffice.
+#  - For writing the shortest decimal that round-trips, by the Ryu algorithm in json_shortest_decimal(). This follows
+#    the reference implementation (https://github.com/ulfjack/ryu).
+
+import argparse
+import pathlib
+
+POW5_MIN = -342  # Below 10^-342, every double rounds to zero.
+POW5_MAX = 308  # Above 10^308, every double rounds to infinity.
+
+RYU_POW5_INV_COUNT = 342
+RYU_POW5_COUNT = 326
+RYU_POW5_BITS = 125  # Bits of precision in both of Ryu's tables.
+
+
+def pow5_128(q):
+    # The most significant 128 bits of 5^q (for q < 0, of 2^b / 5^-q, rounded up), normalized so that the top bit is set.
+    if q >= 0:
+        power5 = 5 ** q
+        while power5 < (1 << 127):
+            power5 *= 2
+        while power5 >= (1 << 128):
+            power5 //= 2
+        return power5
+    power5 = 5 ** -q
+    z = 0
+    while (1 << z) < power5:
+        z += 1
+    if q >= -27:
+        return 2 ** (z + 127) // power5 + 1
+    c = 2 ** (2 * z + 2 * 64) // power5 + 1
+    while c >= (1 << 128):
+        c //= 2
+    return c
+
+
+def ryu_pow5_inv(i):
+    # 2^(bits(5^i) - 1 + RYU_POW5_BITS) / 5^i, rounded up.
+    power5 = 5 ** i
+    return (1 << (power5.bit_length() - 1 + RYU_POW5_BITS)) // power5 + 1
+
+
+def ryu_pow5(i):
+    # The most significant RYU_POW5_BITS bits of 5^i.
+    power5 = 5 ** i
+    shift = power5.bit_length() - RYU_POW5_BITS
+    return power5 >> shift if shift >= 0 else power5 << -shift
+
+
+def table_lines(name, count, comment, values):
+    lines = ['static const uint64_t %s[%s][2] = {' % (name, count)]
+    for i, c in enumerate(values):
+        lines.append('    { 0x%016xull, 0x%016xull },  // %s' % (c & ((1 << 64) - 1), c >> 64, comment % i))
+    lines.append('};')
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate the power-of-five table for parsing floating-point numbers.')
+    parser.add_argument('out', type=pathlib.Path, nargs='?', default=pathlib.Path(__file__).parent / '../src/pow5_table.h',
+                        help='Header to write (default: src/pow5_table.h).')
+    args = parser.parse_args()
+
+    lines = [
+        '// Generated by scripts/gen_pow5_table.py. Do not edit.',
+        '//',
+        '// For each q in [POW5_TABLE_MIN, POW5_TABLE_MAX], the most significant 128 bits of 5^q (normalized, so that the',
+        '// top bit is set), as two 64-bit words: high, then low. See json_decimal_to_double() in util.c.',
+        '',
+        '#define POW5_TABLE_MIN (%d)' % POW5_MIN,
+        '#define POW5_TABLE_MAX %d' % POW5_MAX,
+        '',
+        'static const uint64_t pow5_table[2 * (POW5_TABLE_MAX - POW5_TABLE_MIN + 1)] = {',
+    ]
+    for q in range(POW5_MIN, POW5_MAX + 1):
+        c = pow5_128(q)
+        lines.append('    0x%016xull, 0x%016xull,  // 5^%d' % (c >> 64, c & ((1 << 64) - 1), q))
+    lines.append('};')
+    lines += [
+        '',
+        '// For Ryu, with RYU_POW5_BITS bits of precision, as two 64-bit words: low, then high. For each i:',
+        '//  - ryu_pow5_inv_table[i]: 2^(bits(5^i) - 1 + RYU_POW5_BITS) / 5^i, rounded up.',
+        '//  - ryu_pow5_table[i]: The most significant RYU_POW5_BITS bits of 5^i.',
+        '',
+        '#define RYU_POW5_BITS %d' % RYU_POW5_BITS,
+        '#define RYU_POW5_INV_COUNT %d' % RYU_POW5_INV_COUNT,
+        '#define RYU_POW5_COUNT %d' % RYU_POW5_COUNT,
+        '',
+    ]
+    lines += table_lines('ryu_pow5_inv_table', 'RYU_POW5_INV_COUNT', '5^-%d',
+                         (ryu_pow5_inv(i) for i in range(RYU_POW5_INV_COUNT)))
+    lines.append('')
+    lines += table_lines('ryu_pow5_table', 'RYU_POW5_COUNT', '5^%d', (ryu_pow5(i) for i in range(RYU_POW5_COUNT)))
+    args.out.write_text('\n'.join(lines) + '\n')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,171 @@
+#!/bin/env python3
+
+# Watch a running simulation through its telemetry segment in shared memory (see telemetry in src/simulation.c), e.g.,
+# with `"telemetry": {"name": "ecosystem"}` in its configuration file:
+#
+#     $ ./scripts/monitor.py ecosystem
+#
+# Any number of monitors can attach, and detach, at any time, without slowing the simulation down. Each prints the
+# population tallies of each step, in the same format as the simulation's output, from the oldest still in the ring.
+
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+MAGIC = b'ECOTELE1'
+VERSION = 1
+# The layout, which doesn't change: telemetry_header, up to the state.
+LAYOUT = struct.Struct('=8s11I4x3Q')
+LAYOUT_FIELDS = ('magic', 'version', 'population_count', 'w', 'h', 'num_steps', 'ring_capacity', 'record_size',
+                 'image_w', 'image_h', 'image_interval', 'pid', 'populations_offset', 'ring_offset', 'image_offset')
+STATE_OFFSET = 128  # seq, step, records, params_hash, status.
+STATE = struct.Struct('=5Q')
+IMAGE_STATE_OFFSET = 192  # image_seq, image_step.
+IMAGE_STATE = struct.Struct('=2Q')
+HEADER_SIZE = 208
+NAME_BYTES = 60
+STATUS_FINISHED = 2
+
+
+def attach(name, wait):
+    # Map the segment, once the simulation has created it, and return it with its layout.
+    while True:
+        try:
+            if os.name == 'nt':
+                # The size must be known to map a named segment, so map the header first.
+                shm = mmap.mmap(-1, HEADER_SIZE, tagname='Local\\' + name, access=mmap.ACCESS_READ)
+                layout = dict(zip(LAYOUT_FIELDS, LAYOUT.unpack_from(shm, 0)))
+                shm.close()
+                size = layout['image_offset'] + layout['image_w'] * layout['image_h'] * layout['population_count'] \
+                    if layout['image_offset'] else layout['ring_offset'] + layout['ring_capacity'] * layout['record_size']
+                shm = mmap.mmap(-1, size, tagname='Local\\' + name, access=mmap.ACCESS_READ)
+            else:
+                with open('/dev/shm/' + name, 'rb') as f:
+                    shm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+            layout = dict(zip(LAYOUT_FIELDS, LAYOUT.unpack_from(shm, 0)))
+            if layout['magic'] == MAGIC:
+                break
+            shm.close()
+        except (FileNotFoundError, OSError, ValueError):
+            pass
+        if not wait:
+            sys.exit('No simulation is publishing telemetry as %s.' % name)
+        time.sleep(0.1)
+    if layout['version'] != VERSION:
+        sys.exit('Unsupported telemetry version %d.' % layout['version'])
+    populations = []
+    for pop in range(layout['population_count']):
+        offset = layout['populations_offset'] + (4 + NAME_BYTES) * pop
+        color, = struct.unpack_from('=I', shm, offset)
+        populations.append((shm[offset + 4:offset + 4 + NAME_BYTES].rstrip(b'\0').decode(), color))
+    return shm, layout, populations
+
+
+def read_state(shm):
+    # Copy the state of the run under its seqlock: Retry until seq is even, and unchanged.
+    while True:
+        seq, step, records, params_hash, status = STATE.unpack_from(shm, STATE_OFFSET)
+        if seq % 2 == 0 and struct.unpack_from('=Q', shm, STATE_OFFSET)[0] == seq:
+            return step, records, params_hash, status
+
+
+def read_record(shm, layout, i):
+    # Copy record i, or return None if it has been overwritten.
+    offset = layout['ring_offset'] + (i % layout['ring_capacity']) * layout['record_size']
+    stamp, = struct.unpack_from('=Q', shm, offset)
+    if stamp != i + 1:
+        return None
+    step, time_ns = struct.unpack_from('=Qq', shm, offset + 8)
+    tally = struct.unpack_from('=%dI' % layout['population_count'], shm, offset + 24)
+    if struct.unpack_from('=Q', shm, offset)[0] != i + 1:
+        return None
+    return step, time_ns, tally
+
+
+def read_image(shm, layout):
+    # Copy the latest image under its seqlock, and return its step and densities, as [population][y][x] bytes.
+    size = layout['image_w'] * layout['image_h'] * layout['population_count']
+    while True:
+        seq, step = IMAGE_STATE.unpack_from(shm, IMAGE_STATE_OFFSET)
+        pixels = shm[layout['image_offset']:layout['image_offset'] + size]
+        if seq % 2 == 0 and struct.unpack_from('=Q', shm, IMAGE_STATE_OFFSET)[0] == seq:
+            return (step, pixels) if seq > 0 else (None, None)
+
+
+def write_image(filename, layout, populations, pixels):
+    # Write the image as a PPM, blending the populations' colors by their densities, as the simulation's window does
+    # when zoomed out.
+    w, h = layout['image_w'], layout['image_h']
+    out = bytearray(3 * w * h)
+    for pop, (_, color) in enumerate(populations):
+        channels = ((color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF)
+        plane = pixels[pop * w * h:(pop + 1) * w * h]
+        for i, density in enumerate(plane):
+            if density:
+                for c in range(3):
+                    out[3 * i + c] = min(255, out[3 * i + c] + channels[c] * density // 255)
+    with open(filename + '.tmp', 'wb') as f:
+        f.write(b'P6\n%d %d\n255\n' % (w, h) + bytes(out))
+    os.replace(filename + '.tmp', filename)
+
+
+def format_tallies(layout, populations, step, tally):
+    sizes = ' | '.join('"%s": %d' % (name, n) for (name, _), n in zip(populations, tally))
+    if layout['num_steps']:
+        return 'Time %d/%d: Population sizes: { %s }' % (step, layout['num_steps'], sizes)
+    return 'Time %d: Population sizes: { %s }' % (step, sizes)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Watch a running simulation through its telemetry.')
+    parser.add_argument('name', help='The telemetry segment\'s name, from the configuration file.')
+    parser.add_argument('--wait', action='store_true', help='Wait for the simulation to start.')
+    parser.add_argument('--from-now', action='store_true',
+                        help='Only print steps from now on, rather than from the oldest in the ring.')
+    parser.add_argument('--image', metavar='FILE.ppm', help='Keep writing the latest image of the world to this file.')
+    parser.add_argument('--interval', type=float, default=0.05, help='Seconds between polls (default: 0.05).')
+    args = parser.parse_args()
+
+    shm, layout, populations = attach(args.name, args.wait)
+    if args.image and not layout['image_offset']:
+        sys.exit('The simulation doesn\'t publish an image; set "image_width" in its "telemetry".')
+    _, records, params_hash, status = read_state(shm)
+    next_record = records if args.from_now else max(0, records - layout['ring_capacity'])
+    image_step = None
+    try:
+        while True:
+            _, records, hash_now, status = read_state(shm)
+            if hash_now != params_hash:
+                print('[INFO] The population parameters were reloaded.', file=sys.stderr)
+                params_hash = hash_now
+            if records - next_record > layout['ring_capacity']:
+                # Fell behind: The oldest of these were overwritten.
+                print('[WARNING] Missed %d steps.' % (records - layout['ring_capacity'] - next_record), file=sys.stderr)
+                next_record = records - layout['ring_capacity']
+            while next_record < records:
+                record = read_record(shm, layout, next_record)
+                if record is None:
+                    print('[WARNING] Missed a step.', file=sys.stderr)
+                else:
+                    print(format_tallies(layout, populations, record[0], record[2]))
+                next_record += 1
+            sys.stdout.flush()
+            if args.image:
+                step, pixels = read_image(shm, layout)
+                if step is not None and step != image_step:
+                    write_image(args.image, layout, populations, pixels)
+                    image_step = step
+            if status == STATUS_FINISHED:
+                break
+            time.sleep(args.interval)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        shm.close()
+
+
+if __name__ == '__main__':
+    main()
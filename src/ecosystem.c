@@ -7,441 +7,463 @@
 
 #include "fenster.h"
 
-#include "util.c"
+#include "simulation.c"
 
+#ifdef EVOLVE_SPECIALIZED
+// Generated by the specialize tool; see the Makefile.
+#include "evolve_specialized.c"
+#endif
 
-#define FPS 60
 
-#define BLACK 0x000000
-#define WHITE 0xFFFFFF
-#define YELLOW 0xFFFF00
-#define RED 0xFF0000
-#define GREEN 0x00FF00
-#define BLUE 0x0000FF
-#define CYAN 0x00FFFF
-
-
-typedef struct population_params {
-    buffer name;
-    u32 color;
-    bool motile;
-    u8 trophic_level;
-    u32 initial_population_size;
-    u16 energy_at_birth;
-    u16 energy_maximum;
-    u16 energy_threshold_replicate;
-    u16 energy_cost_replicate;
-    u16 energy_gain;
-    u16 energy_cost_move;
-    u8 replication_space_needed;
-} population_params;
-
-typedef struct simulation_params {
-    bool rng_seed_given;
-    u64 rng_seed;
-    u16 w;
-    u16 h;
-    bool visual;
-    bool run_forever;
-    u32 num_steps;
-    u16 population_count;
-    population_params* populations; // Array
-} simulation_params;
+#define FPS 60
 
-simulation_params simulation_params_create(u16 population_count) {
-    simulation_params sp = {0};
-    if ((sp.populations = calloc(population_count, sizeof *sp.populations))) {
-        sp.population_count = population_count;
-    } else {
-        fprintf(stderr, "Failed to allocate memory for simulation_params.\n");
-    }
-    return sp;
-}
+/**** Viewing ****/
 
-void simulation_params_destroy(simulation_params *sp) {
-    for (int i = 0; i < sp->population_count; ++i) {
-        buffer_destroy(&(sp->populations[i].name));
-    }
-    sp->population_count = 0;
-    free(sp->populations);
-    sp->populations = NULL;
-}
+// The window is a viewport onto the world, which can be panned, and zoomed in or out; see view. Zoomed out, each pixel
+// covers many cells, so it's drawn from a mipmap: a pyramid of levels, where each texel of level k counts the cells
+// of each population in a square of 2^k x 2^k cells. Only the blocks of cells that changed since the last frame are
+// recounted, so a frame costs time in proportion to the window's pixels and the changes, rather than to the world.
 
+#define VIEW_MAX_WIDTH 1280  // The largest window, in pixels.
+#define VIEW_MAX_HEIGHT 800
+#define VIEW_MAX_SCALE 64.0  // The most pixels per cell.
+#define VIEW_ZOOM_STEP 1.25
+#define VIEW_OUTSIDE 0x202020  // The color beyond the world's edges.
+#define MIPMAP_BLOCK_SHIFT 3  // Changes are tracked in blocks of 2^MIPMAP_BLOCK_SHIFT cells square.
+#define MIPMAP_MAX_LEVELS 16  // Enough to reduce the largest world to one texel.
 
-typedef struct point {
-    u16 x;
-    u16 y;
-} point;
+// Whether population pop occupies cell (x, y) of src, e.g., a world; see world_occupied().
+typedef bool (*occupied_fn)(void const* src, u16 pop, u16 x, u16 y);
 
-bool coincide(point a, point b) {
-    return a.x == b.x && a.y == b.y;
+bool world_occupied(void const* src, u16 pop, u16 x, u16 y) {
+    return world_map_idx((world const*)src, x, y, pop)->exists;
 }
 
-typedef struct organism {
-    u32 birthday;
-    point target;
-    u16 energy;
-    u16 kills;
-    bool exists;
-    bool existed;
-    bool ready_to_replicate;
-} organism;
-
-typedef struct world {
-    simulation_params params;
+typedef struct mipmap {
     u16 w;
     u16 h;
-    u32 step;
-    u32* pop_tally;
-    organism* map;  // 3D array of dimensions [h][w][num_populations].
-} world;
-
-// Return a pointer to the organism wld->map[y][x][pop].
-organism* world_map_idx(world const* wld, u16 x, u16 y, u16 pop) {
-    return &wld->map[(wld->params.population_count)*(y*(wld->w) + x) + pop];
+    u16 population_count;
+    u8 levels;  // Levels 1 to levels are stored; level 0 is the source itself.
+    u16 level_w[MIPMAP_MAX_LEVELS + 1];
+    u16 level_h[MIPMAP_MAX_LEVELS + 1];
+    u32* counts[MIPMAP_MAX_LEVELS + 1];  // For each level, [level_h][level_w][population_count].
+    u16 blocks_w;
+    u16 blocks_h;
+    u8* dirty;  // For each block, whether it changed since the last mipmap_update().
+    u32* dirty_list;  // The blocks that changed, in the order they were marked.
+    u32 dirty_count;
+} mipmap;
+
+void mipmap_destroy(mipmap* mm) {
+    for (u8 k = 1; k <= mm->levels; ++k) {
+        free(mm->counts[k]);
+    }
+    free(mm->dirty);
+    free(mm->dirty_list);
+    *mm = (mipmap){0};
 }
 
-int population_create(world* wld, u16 pop_id);
-
-bool world_create(world* wld, simulation_params params) {
-    wld->params = params;
-    wld->w = params.w;
-    wld->h = params.h;
-    wld->step = 0;
-    wld->pop_tally = (u32*)calloc(
-        (size_t)params.population_count,
-        sizeof *wld->pop_tally);
-    wld->map = (organism*)calloc(
-        (size_t)wld->h * (size_t)wld->w * params.population_count,
-        sizeof *wld->map);
-
-    /**** Seed RNG prior to generating populations. ****/
-    if (wld->params.rng_seed_given) {
-        rand_init_from_seed(&rand_state_global, wld->params.rng_seed);
-    } else {
-        rand_init_from_time(&rand_state_global);
+// Mark the blocks of cells that overlap columns [x_begin, x_end) and rows [y_begin, y_end) as changed.
+void mipmap_mark(mipmap* mm, u16 x_begin, u16 y_begin, u16 x_end, u16 y_end) {
+    if (x_begin >= x_end || y_begin >= y_end) {
+        return;
     }
-
-    for (u16 pop = 0; pop < params.population_count; ++pop) {
-        if (0 != population_create(wld, pop)) {
-            return false;
+    for (u32 by = y_begin >> MIPMAP_BLOCK_SHIFT; by <= (u32)(y_end - 1) >> MIPMAP_BLOCK_SHIFT; ++by) {
+        for (u32 bx = x_begin >> MIPMAP_BLOCK_SHIFT; bx <= (u32)(x_end - 1) >> MIPMAP_BLOCK_SHIFT; ++bx) {
+            u32 const block = by * mm->blocks_w + bx;
+            if (!mm->dirty[block]) {
+                mm->dirty[block] = 1;
+                mm->dirty_list[mm->dirty_count++] = block;
+            }
         }
     }
-    return true;
 }
 
-void world_destroy(world* wld) {
-    free(wld->pop_tally);
-    wld->pop_tally = NULL;
-    free(wld->map);
-    wld->map = NULL;
-    *wld = (world){0};
+// Mark the blocks of cells that may have changed in wld's last step, i.e., those in tiles that are awake; see
+// evolve_update_tiles().
+void mipmap_mark_tiles(mipmap* mm, world const* wld) {
+    for (u16 tile_y = 0; tile_y < wld->tiles_h; ++tile_y) {
+        u16 x_begin = 0, x_end = 0;
+        u16 const y_begin = (u16)(tile_y * TILE_SIZE);
+        u16 const y_end = (u16)MIN((u32)wld->h, (u32)y_begin + TILE_SIZE);
+        for (u16 tile_x = 0; evolve_next_tile_run(wld, tile_y, TILE_AWAKE, &tile_x, &x_begin, &x_end); ) {
+            mipmap_mark(mm, x_begin, y_begin, x_end, y_end);
+        }
+    }
 }
 
-
-// Parameters:
-//     wld: A valid (created) world.
-//     counter: Array of size wld->num_populations.
-void population_count(world* wld, u32 counter[]) {
-    u16 const num_populations = wld->params.population_count;
-    for (int i = 0; i < num_populations; ++i) {
-        counter[i] = 0;
+// Create a mipmap of a w x h source of population_count populations, with every block marked as changed, so that the
+// first mipmap_update() counts everything.
+// Return: true on success; false if memory couldn't be allocated.
+// Notes: If this call is successful, then the caller is responsible for calling mipmap_destroy(mm).
+bool mipmap_create(mipmap* mm, u16 w, u16 h, u16 population_count) {
+    *mm = (mipmap){
+        .w = w,
+        .h = h,
+        .population_count = population_count,
+        .blocks_w = (u16)(((u32)w + (1u << MIPMAP_BLOCK_SHIFT) - 1) >> MIPMAP_BLOCK_SHIFT),
+        .blocks_h = (u16)(((u32)h + (1u << MIPMAP_BLOCK_SHIFT) - 1) >> MIPMAP_BLOCK_SHIFT),
+    };
+    mm->level_w[0] = w;
+    mm->level_h[0] = h;
+    bool ok = true;
+    for (u8 k = 1; ok && k <= MIPMAP_MAX_LEVELS && (mm->level_w[k - 1] > 1 || mm->level_h[k - 1] > 1); ++k) {
+        mm->level_w[k] = (u16)((mm->level_w[k - 1] + 1) / 2);
+        mm->level_h[k] = (u16)((mm->level_h[k - 1] + 1) / 2);
+        mm->counts[k] = calloc((size_t)mm->level_w[k] * mm->level_h[k] * population_count, sizeof *mm->counts[k]);
+        ok = mm->counts[k] != NULL;
+        mm->levels = k;
     }
-    organism const * const end = wld->map + (wld->w * wld->h * num_populations);
-    u16 spc = 0;
-    for (organism const* org = wld->map;
-         org != end;
-         ++org, ++spc
-        ) {
-        spc %= num_populations;
-        counter[spc] += org->exists;
+    size_t const blocks = (size_t)mm->blocks_w * mm->blocks_h;
+    mm->dirty = calloc(blocks, sizeof *mm->dirty);
+    mm->dirty_list = calloc(blocks, sizeof *mm->dirty_list);
+    if (!ok || !mm->dirty || !mm->dirty_list) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory for the mipmap.\n");
+        mipmap_destroy(mm);
+        return false;
     }
+    mipmap_mark(mm, 0, 0, w, h);
+    return true;
 }
 
-// Precondition: world_create(wld) has already been called, and  0 <= id < num_populations.
-// Returns: 0 on success, nonzero on failure.
-int population_create(world* wld, u16 pop_id) {
-    population_params const*const params = &wld->params.populations[pop_id];
-
-    // u32 is big enough for maximum u16 * u16.
-    u32 const map_cells = (u32)wld->w * (u32)wld->h;
-    if (map_cells < params->initial_population_size) {
-        fprintf(stderr, "Cannot create population: World map is too small.\n");
-        return 1;
-    }
-
-    bool *occupancy = malloc((sizeof *occupancy) * map_cells);
-    rand_combination(map_cells, params->initial_population_size, occupancy);
-    for (u16 y = 0; y < wld->h; ++y) {
-        for (u16 x = 0; x < wld->w; ++x) {
-            organism* const org = world_map_idx(wld, x, y, pop_id);
-            if (occupancy[y*wld->w + x]) {
-                *org = (organism){
-                    .exists = true,
-                    .birthday = wld->step,
-                    .energy = params->energy_at_birth,
-                    .kills = 0,
-                };
-                ++wld->pop_tally[pop_id];
-            } else {
-                *org = (organism){0};
+// Recount the texels of every level over the blocks marked as changed, from the source, src.
+void mipmap_update(mipmap* mm, occupied_fn occupied, void const* src) {
+    u16 const npops = mm->population_count;
+    // Level by level, so that each texel is counted from an up-to-date level below. A texel of a high level covers
+    // many blocks, so it may be counted once for each that changed; but each count is only of four texels.
+    for (u8 k = 1; k <= mm->levels; ++k) {
+        u32* const counts = mm->counts[k];
+        u32 const* const below = mm->counts[k - 1];
+        u32 const w_below = mm->level_w[k - 1];
+        u32 const h_below = mm->level_h[k - 1];
+        for (u32 i = 0; i < mm->dirty_count; ++i) {
+            u32 const block = mm->dirty_list[i];
+            u32 const x_begin = (block % mm->blocks_w) << MIPMAP_BLOCK_SHIFT;
+            u32 const y_begin = (block / mm->blocks_w) << MIPMAP_BLOCK_SHIFT;
+            u32 const x_last = MIN(x_begin + (1u << MIPMAP_BLOCK_SHIFT), (u32)mm->w) - 1;
+            u32 const y_last = MIN(y_begin + (1u << MIPMAP_BLOCK_SHIFT), (u32)mm->h) - 1;
+            for (u32 ty = y_begin >> k; ty <= y_last >> k; ++ty) {
+                for (u32 tx = x_begin >> k; tx <= x_last >> k; ++tx) {
+                    u32* const texel = &counts[((size_t)ty * mm->level_w[k] + tx) * npops];
+                    memset(texel, 0, (sizeof *texel) * npops);
+                    for (u32 y = 2 * ty; y < MIN(2 * ty + 2, h_below); ++y) {
+                        for (u32 x = 2 * tx; x < MIN(2 * tx + 2, w_below); ++x) {
+                            for (u16 pop = 0; pop < npops; ++pop) {
+                                texel[pop] += k == 1 ? occupied(src, pop, (u16)x, (u16)y) :
+                                    below[((size_t)y * w_below + x) * npops + pop];
+                            }
+                        }
+                    }
+                }
             }
         }
     }
-    free(occupancy);
-
-    if (wld->pop_tally[pop_id] != params->initial_population_size) {
-        fprintf(
-            stderr,
-            "Error creating population %u: Created %u/%u organisms.\n",
-            pop_id,
-            wld->pop_tally[pop_id],
-            params->initial_population_size);
-        return 1;
+    for (u32 i = 0; i < mm->dirty_count; ++i) {
+        mm->dirty[mm->dirty_list[i]] = 0;
     }
+    mm->dirty_count = 0;
+}
 
-    return 0;
+// The part of the world shown in the window.
+typedef struct view {
+    f64 x;  // The point of the world (in cells, fractional) at the window's top left corner.
+    f64 y;
+    f64 scale;  // Pixels per cell: more than 1 when zoomed in, less than 1 when zoomed out.
+    f64 min_scale;  // Zoomed out as far as this, the whole world fits in half the window.
+    bool dragging;  // Panning with the mouse, which was at (drag_x, drag_y).
+    int drag_x;
+    int drag_y;
+} view;
+
+// The size of a window that shows a w x h world at up to zoom pixels per cell, but fits on a screen.
+void view_window_size(u16 w, u16 h, u8 zoom, u16* win_w, u16* win_h) {
+    *win_w = (u16)MIN((u32)w * zoom, VIEW_MAX_WIDTH);
+    *win_h = (u16)MIN((u32)h * zoom, VIEW_MAX_HEIGHT);
 }
 
-// Take one time step.
-void evolve(world* wld) {
-    population_params const*const pop_params = wld->params.populations;
-    u16 const npops = wld->params.population_count;
-
-    // First pass: Each organism decides which direction to move.
-    for (u16 y = 0; y < wld->h; ++y) {
-        for (u16 x = 0; x < wld->w; ++x) {
-            for (u16 pop = 0; pop < npops; ++pop ) {
-                organism* org = world_map_idx(wld, x, y, pop);
-                org->existed = org->exists;
-                if (!org->exists) {
-                    continue;
-                }
-                // Passive energy gain.
-                org->energy += pop_params[pop].energy_gain;
-
-                bool org_can_move = pop_params[pop].motile;
-
-                u8 living_neighbors = 0;
-                u16 xs[3] = { (x == 0 ? wld->w - 1 : x - 1), x, (u16)(x + 1) % wld->w };
-                u16 ys[3] = { (y == 0 ? wld->h - 1 : y - 1), y, (u16)(y + 1) % wld->h };
-                for (size_t i = 0; i < 3; ++i) {
-                    for (size_t j = 0; j < 3; ++j) {
-                        if (i == 1 && j == 1) continue;
-                        point maybe = { .x = xs[j], .y = ys[i] };
-                        organism* neighbor = world_map_idx(wld, maybe.x, maybe.y, pop);
-                        if (neighbor->exists) {
-                            ++living_neighbors;
-                        }
-                    }
-                }
+// Show the whole of a w x h world in f, at up to zoom pixels per cell.
+view view_fit(u16 w, u16 h, struct fenster const* f, u8 zoom) {
+    f64 const fit = MIN(MIN((f64)f->width / w, (f64)f->height / h), (f64)zoom);
+    return (view){
+        .x = ((f64)w - f->width / fit) / 2,
+        .y = ((f64)h - f->height / fit) / 2,
+        .scale = fit,
+        .min_scale = MIN(fit, 1.0) / 2,
+    };
+}
 
-                bool org_can_replicate =
-                    (org->energy >= pop_params[pop].energy_threshold_replicate) &&
-                    (living_neighbors + pop_params[pop].replication_space_needed <= 8);
-                org->ready_to_replicate = org_can_replicate;
-
-                if (org_can_move || org_can_replicate) {
-                    u16 xs[3] = { (x == 0 ? wld->w - 1 : x - 1), x, (u16)(x + 1) % wld->w };
-                    u16 ys[3] = { (y == 0 ? wld->h - 1 : y - 1), y, (u16)(y + 1) % wld->h };
-                    u32 ru = rand_unif(0, 7);
-                    if (ru >= 4)
-                        ++ru;
-                    org->target = (point){
-                        .x = xs[ru / 3],
-                        .y = ys[ru % 3],
-                    };
-                } else {
-                    // This one shall remain where it is.
-                    org->target = (point){.x = x, .y = y};
-                }
-            }
-        }
-    }
+// Zoom v by factor, keeping the point of the world under pixel (px, py) where it is.
+void view_zoom(view* v, f64 factor, int px, int py) {
+    f64 const scale = MAX(v->min_scale, MIN(VIEW_MAX_SCALE, v->scale * factor));
+    v->x += px / v->scale - px / scale;
+    v->y += py / v->scale - py / scale;
+    v->scale = scale;
+}
 
-    // Second pass: Organisms move or replicate to targets, with uniformly random choice when there is contention for
-    // the same cell.
-    for (u16 y = 0; y < wld->h; ++y) {
-        for (u16 x = 0; x < wld->w; ++x) {
-            for (u16 pop = 0; pop < npops; ++pop ) {
-                organism* org = world_map_idx(wld, x, y, pop);
-                if (org->existed) {
-                    // This site is occupied, sorry -- nobody from this population gets to move here.
-                    continue;
-                }
+// Pan and zoom v from the user's input to f, where pressed is the key that was just pressed (see key_pressed()):
+//  - Drag with the mouse, or press W, A, S, D: Pan.
+//  - = and -: Zoom in and out, about the mouse pointer.
+//  - F: Show the whole world, at up to zoom pixels per cell.
+// Return: Whether v changed.
+bool view_input(view* v, struct fenster const* f, int pressed, u16 w, u16 h, u8 zoom) {
+    bool changed = true;
+    bool const pointer_inside = f->x >= 0 && f->x < f->width && f->y >= 0 && f->y < f->height;
+    if (f->mouse && v->dragging) {
+        changed = f->x != v->drag_x || f->y != v->drag_y;
+        v->x -= (f->x - v->drag_x) / v->scale;
+        v->y -= (f->y - v->drag_y) / v->scale;
+    } else if (pressed == '=' || pressed == '-') {
+        view_zoom(v, pressed == '=' ? VIEW_ZOOM_STEP : 1 / VIEW_ZOOM_STEP, pointer_inside ? f->x : f->width / 2,
+                  pointer_inside ? f->y : f->height / 2);
+    } else if (pressed == 'W' || pressed == 'S') {
+        v->y += (pressed == 'W' ? -f->height : f->height) / (8 * v->scale);
+    } else if (pressed == 'A' || pressed == 'D') {
+        v->x += (pressed == 'A' ? -f->width : f->width) / (8 * v->scale);
+    } else if (pressed == 'F') {
+        *v = view_fit(w, h, f, zoom);
+    } else {
+        changed = false;
+    }
+    v->dragging = f->mouse;
+    v->drag_x = f->x;
+    v->drag_y = f->y;
+    return changed;
+}
 
-                // Algorithm: Reservoir sampling: Each condending neighbor is selected with equal probability.
-                u8 k = 0;  // Neighbors that want to move here.
-                organism* winner = {0};
-                u16 xs[3] = { (x == 0 ? wld->w - 1 : x - 1), x, (u16)(x + 1) % wld->w };
-                u16 ys[3] = { (y == 0 ? wld->h - 1 : y - 1), y, (u16)(y + 1) % wld->h };
-                for (size_t i = 0; i < 3; ++i) {
-                    for (size_t j = 0; j < 3; ++j) {
-                        if (i == 1 && j == 1) continue;
-                        point maybe = { .x = xs[j], .y = ys[i] };
-                        organism* contender = world_map_idx(wld, maybe.x, maybe.y, pop);
-                        if (contender->exists &&
-                            coincide(contender->target, (point){x, y})) {
-                            ++k;
-                            if (rand_unif(1, k) == k) {
-                                winner = contender;
-                            }
-                        }
+// Draw the part of a source (e.g., a world; see occupied_fn) in view v into f: Zoomed in, each cell in the color of
+// the last population in it, as it always was; zoomed out, each pixel in the colors of the populations, weighed by
+// their density in the texel of the mipmap mm that the pixel covers. mm must be up to date; see mipmap_update().
+void render_view(
+    struct fenster const* f,
+    view const* v,
+    mipmap const* mm,
+    occupied_fn occupied,
+    void const* src,
+    u32 const colors[]
+    ) {
+    // Zoomed out, the finest level whose texels are at least as large as a pixel, so that each cell counts.
+    u8 k = 0;
+    while (k < mm->levels && (f64)(1u << k) * v->scale < 1.0) {
+        ++k;
+    }
+    u16 const npops = mm->population_count;
+    u32 const* const counts = mm->counts[k];
+    u32 const area_shift = 2u * k;
+    i64 tx_of[VIEW_MAX_WIDTH];  // For each column of pixels, its texel, or -1 beyond the world.
+    for (int px = 0; px < f->width && px < VIEW_MAX_WIDTH; ++px) {
+        f64 const x = floor((v->x + (px + 0.5) / v->scale) / (f64)(1u << k));
+        tx_of[px] = x >= 0 && x < mm->level_w[k] ? (i64)x : -1;
+    }
+    for (int py = 0; py < f->height; ++py) {
+        f64 const y = floor((v->y + (py + 0.5) / v->scale) / (f64)(1u << k));
+        i64 const ty = y >= 0 && y < mm->level_h[k] ? (i64)y : -1;
+        for (int px = 0; px < f->width && px < VIEW_MAX_WIDTH; ++px) {
+            i64 const tx = tx_of[px];
+            u32 color = VIEW_OUTSIDE;
+            if (tx < 0 || ty < 0) {
+                // Beyond the world's edges.
+            } else if (k == 0) {
+                color = BLACK;
+                for (u16 pop = 0; pop < npops; ++pop) {
+                    if (occupied(src, pop, (u16)tx, (u16)ty)) {
+                        color = colors[pop];
                     }
                 }
-
-                if (winner) {
-                    if (winner->ready_to_replicate) {
-                        // Replicate.
-                        *org = (organism){
-                            .birthday = wld->step,
-                            .energy = pop_params[pop].energy_at_birth,
-                            .kills = 0,
-                            .exists = true,
-                        };
-                        ++wld->pop_tally[pop];
-                        if (winner->energy > pop_params[pop].energy_cost_replicate) {
-                            winner->energy -= pop_params[pop].energy_cost_replicate;
-                        } else {
-                            winner->energy = 0;
-                            // Don't die yet, because there's still a chance to survive by predating.
-                        }
-                    } else {
-                        // Move.
-                        *org = *winner;
-                        *winner = (organism){ .existed = true };
-                        if (org->energy > pop_params[pop].energy_cost_move) {
-                            org->energy -= pop_params[pop].energy_cost_move;
-                        } else {
-                            org->energy = 0;
-                            // Don't die yet, because there's still a chance to survive by predating.
-                        }
-                    }
+            } else {
+                u32 const* const texel = &counts[((size_t)ty * mm->level_w[k] + (size_t)tx) * npops];
+                u64 r = 0, g = 0, b = 0;
+                for (u16 pop = 0; pop < npops; ++pop) {
+                    r += (u64)texel[pop] * ((colors[pop] >> 16) & 0xFF);
+                    g += (u64)texel[pop] * ((colors[pop] >> 8) & 0xFF);
+                    b += (u64)texel[pop] * (colors[pop] & 0xFF);
                 }
+                color = (u32)(MIN(r >> area_shift, 0xFF) << 16 | MIN(g >> area_shift, 0xFF) << 8 |
+                              MIN(b >> area_shift, 0xFF));
             }
+            fenster_pixel(f, px, py) = color;
         }
     }
+}
 
-    // Third pass: Predation and death.
-    for (u16 y = 0; y < wld->h; ++y) {
-        for (u16 x = 0; x < wld->w; ++x) {
-            for (u16 pop = 0; pop < npops; ++pop ) {
-                organism* org = world_map_idx(wld, x, y, pop);
-                if (!org->exists) {
-                    continue;
-                }
+// Return the first key that's down in f but wasn't at the last call, or 0 if there is none. held holds the keys that
+// were down, so that each press acts once.
+int key_pressed(struct fenster const* f, int held[256]) {
+    int pressed = 0;
+    for (int k = 0; k < 256 && !pressed; ++k) {
+        if (f->keys[k] && !held[k]) {
+            pressed = k;
+        }
+    }
+    memcpy(held, f->keys, sizeof f->keys);
+    return pressed;
+}
 
-                // Predate.
-                for (u16 other_pop = 0; other_pop < npops; ++other_pop) {
-                    if (pop_params[pop].trophic_level == 0 ||
-                        pop_params[pop].trophic_level - 1 != pop_params[other_pop].trophic_level) {
-                        // This is not a prey population.
-                        continue;
-                    }
-                    organism* prey = world_map_idx(wld, x, y, other_pop);
-                    if (prey->exists) {
-                        org->energy += prey->energy;
-                        *prey = (organism){0};
-                        --wld->pop_tally[other_pop];
-                        ++org->kills;
-                    }
-                }
 
-                // Die.
-                if (org->energy == 0) {
-                    *org = (organism){0};
-                    --wld->pop_tally[pop];
-                }
+/**** Running ****/
 
-                org->energy = MIN(pop_params[pop].energy_maximum, org->energy);
-            }
-        }
+// Write a line with the population tallies after the given step to out, or, if out is NULL, to stdout.
+void print_tallies(async_writer* out, world const* wld, u32 step, u32 const tally[]) {
+    buffer line = {0};
+    bool ok = true;
+    if (!wld->params.run_forever) {
+        ok = buffer_appendf(&line, "Time %u/%u: Population sizes: { ", step, wld->params.num_steps);
+    } else {
+        ok = buffer_appendf(&line, "Time %u: Population sizes: { ", step);
     }
-
-    ++wld->step;
+    for (u16 pop = 0; ok && pop < wld->params.population_count; ++pop) {
+        buffer const name = wld->params.populations[pop].name;
+        ok = buffer_appendf(&line, "%s\"%.*s\": %u", pop ? " | " : "", (int)name.len, name.p, tally[pop]);
+    }
+    ok = ok && buffer_appendf(&line, " }\n");
+    if (ok && out) {
+        async_writer_write(out, line.p, line.len);
+    } else if (ok) {
+        fwrite(line.p, 1, line.len, stdout);
+    }
+    buffer_destroy(&line);
 }
 
-void render(
-    world const* wld,
-    struct fenster const* f,
-    u8 zoom
-    ) {
-    // Clear display.
-    /*for (int i = 0; i < f->width; i++) {
-        for (int j = 0; j < f->height; j++) {
-            fenster_pixel(f, i, j) = BLACK;
+// Skip to the last step of a run in a detected, exact steady state (see steady_state), with the same results as
+// running it: Print the tallies of the skipped steps, which repeat, and take only the steps needed to reach the same
+// point in the cycle as the last step. The skipped steps are published to tm, unless it's NULL.
+void fast_forward(async_writer* out, telemetry* tm, world* wld, evolve_fn step, steady_state const* ss, bool verbose) {
+    u32 const last = wld->params.num_steps;
+    for (u32 t = ss->step + 1; (verbose || tm) && t < last; ++t) {
+        if (verbose) {
+            print_tallies(out, wld, t, steady_state_future_tally(ss, t));
         }
-    }*/
-    for (u16 y = 0; y < wld->h; ++y) {
-        for (u16 x = 0; x < wld->w; ++x) {
-            u32 color = BLACK;
-            for (u16 pop = 0; pop < wld->params.population_count; ++pop ) {
-                organism const*const org = world_map_idx(wld, x, y, pop);
-                if (org->exists) {
-                    color = wld->params.populations[pop].color;
-                }
-            }
-            for (u8 i = 0; i < zoom; ++i) {
-                for (u8 j = 0; j < zoom; ++j) {
-                    fenster_pixel(f, zoom*x + i, zoom*y + j) = color;
-                }
-            }
+        if (tm) {
+            telemetry_publish(tm, wld, t, steady_state_future_tally(ss, t));
         }
     }
+    for (u32 remaining = (last - ss->step) % ss->period; remaining > 0; --remaining) {
+        step(wld);
+    }
+    wld->step = last;
 }
 
-
-void run(world* wld, u8 zoom, bool verbose) {
+// Run the simulation. If config_filename isn't NULL, then reload population parameters from it whenever it changes.
+void run(world* wld, evolve_fn step, u8 zoom, bool verbose, char const* config_filename) {
     bool const forever = wld->params.run_forever;
     i64 prev_render = 0;
     bool display_fenster = wld->params.visual;
 
+    steady_state_params const ssp = wld->params.steady_state;
+    steady_state steady = {0};
+    bool const detecting = (ssp.extinction || ssp.repetition_window > 0 || ssp.unchanged_tally_steps > 0) &&
+        steady_state_create(&steady, ssp, wld->params.population_count);
+    if (ssp.repetition_window > 0) {
+        world_track_hash(wld);
+    }
+
+    // Steady state detection and recording look at every step, so they take them one at a time.
+    record_params const rp = wld->params.record;
+    u32 const block_steps = detecting || rp.file ? 1 : MAX(wld->params.block_steps, 1);
+    u32* const tallies = block_steps > 1 && wld->params.processes > 1 ?
+        calloc((size_t)block_steps * wld->params.population_count, sizeof *tallies) : NULL;
+
+    // Split the world between processes, which exchange halos every block_steps steps. (Before starting the thread
+    // that watches the configuration, which they wouldn't have.)
+    decomposition dec;
+    bool const decomposed = !detecting && wld->params.processes > 1 &&
+        decomposition_start(&dec, wld, wld->params.processes, block_steps);
+
+    config_watch watch;
+    bool const watching = config_filename && config_watch_start(&watch, config_filename, &wld->params);
+
+    // Output is written by another thread, so that a slow consumer doesn't hold up the simulation.
+    output_params const op = wld->params.output;
+    async_writer writer;
+    bool const writing = async_writer_open(&writer, stdout, op.ring_bytes ? op.ring_bytes : OUTPUT_DEFAULT_RING_BYTES,
+                                           op.policy, op.spill_file ? op.spill_file : OUTPUT_DEFAULT_SPILL_FILE);
+    async_writer* const output = writing ? &writer : NULL;
+
+    recorder rec;
+    bool const recording = rp.file && recorder_open(&rec, wld, rp.file,
+        rp.keyframe_interval ? rp.keyframe_interval : HISTORY_DEFAULT_KEYFRAME_INTERVAL);
+
+    telemetry_params const tp = wld->params.telemetry;
+    telemetry tm;
+    bool const publishing = tp.name && telemetry_open(&tm, wld, tp.name,
+        tp.ring_records ? tp.ring_records : TELEMETRY_DEFAULT_RING_RECORDS, tp.image_width, MAX(tp.image_interval, 1));
+
     u32* buf = NULL;
+    u16 win_w, win_h;
+    view_window_size(wld->w, wld->h, zoom, &win_w, &win_h);
     struct fenster f = {
         .title = "Ecosystem Simulation",
-        .width = (wld->w * zoom),
-        .height = (wld->h * zoom),
+        .width = win_w,
+        .height = win_h,
         .buf = NULL,
     };
+    mipmap mm = {0};
+    view v = {0};
+    int held[256] = {0};
+    u32 marked_step = wld->step;  // The step as of which the mipmap's changed blocks are marked.
+    u32* const colors = malloc((sizeof *colors) * MAX(wld->params.population_count, 1));
+    for (u16 pop = 0; colors && pop < wld->params.population_count; ++pop) {
+        colors[pop] = wld->params.populations[pop].color;
+    }
+    if (display_fenster && (!colors || !mipmap_create(&mm, wld->w, wld->h, wld->params.population_count))) {
+        fprintf(stderr, "[ERROR] Failed to set up the display; running without it.\n");
+        display_fenster = false;
+    }
     if (display_fenster) {
-        buf = malloc((sizeof *buf) * wld->w * wld->h * zoom * zoom);
+        buf = malloc((sizeof *buf) * win_w * win_h);
         f.buf = buf;
         fenster_open(&f);
+        v = view_fit(wld->w, wld->h, &f, zoom);
 
         // Bugfix: no fenster display for first frame.
         fenster_sleep(1000/FPS);
         prev_render = fenster_time();
-        render(wld, &f, zoom);
+        mipmap_update(&mm, world_occupied, wld);
+        render_view(&f, &v, &mm, world_occupied, wld, colors);
     }
 
     while (true) {
         if (verbose) {
-            if (!forever) {
-                fprintf(stdout, "Time %u/%u: Population sizes: { ", wld->step, wld->params.num_steps);
-            } else {
-                fprintf(stdout, "Time %u: Population sizes: { ", wld->step);
-            }
-            for (int pop = 0; pop < wld->params.population_count; ++pop) {
-                if (pop) {
-                    printf(" | ");
+            print_tallies(output, wld, wld->step, wld->pop_tally);
+        }
+        if (recording && ((decomposed && !decomposition_gather(&dec, wld)) || !recorder_add(&rec, wld))) {
+            fprintf(stderr, "[ERROR] Failed to record time %u; stopping.\n", wld->step);
+            break;
+        }
+        if (publishing) {
+            telemetry_publish(&tm, wld, wld->step, wld->pop_tally);
+            if (telemetry_image_due(&tm, wld)) {
+                if (decomposed && !decomposition_gather(&dec, wld)) {
+                    break;
                 }
-                fprintf(stdout, "\"");
-                buffer_printf(wld->params.populations[pop].name, stdout);
-                fprintf(stdout, "\": %u", wld->pop_tally[pop]);
+                telemetry_publish_image(&tm, wld);
             }
-            fprintf(stdout, " }\n");
         }
 
         if (display_fenster) {
+            // The blocks that may have changed in the last step; after a jump (e.g., by fast_forward()), all of them.
+            if (wld->step == marked_step + 1) {
+                mipmap_mark_tiles(&mm, wld);
+            } else if (wld->step != marked_step) {
+                mipmap_mark(&mm, 0, 0, wld->w, wld->h);
+            }
+            marked_step = wld->step;
             if (fenster_loop(&f) != 0) {
                 // User closed window?
                 break;
             }
+            view_input(&v, &f, key_pressed(&f, held), wld->w, wld->h, zoom);
             // Simple framerate controller.
             i64 now = fenster_time();
             if (now - prev_render > 1000/FPS) {
                 prev_render = now;
-                render(wld, &f, zoom);
+                if (decomposed) {
+                    if (!decomposition_gather(&dec, wld)) {
+                        break;
+                    }
+                    mipmap_mark(&mm, 0, 0, wld->w, wld->h);
+                }
+                mipmap_update(&mm, world_occupied, wld);
+                render_view(&f, &v, &mm, world_occupied, wld, colors);
             }
             // Can change this to slow down the simulation.
             //fenster_sleep(30);
@@ -451,220 +473,262 @@ void run(world* wld, u8 zoom, bool verbose) {
             break;
         }
 
-        evolve(wld);
+        if (detecting && steady_state_update(&steady, wld)) {
+            fprintf(stderr, "[INFO] ");
+            steady_state_print(&steady, stderr);
+            if (!forever && steady.exact && steady.params.fast_forward) {
+                fprintf(stderr, " Fast-forwarding to time %u.\n", wld->params.num_steps);
+                fast_forward(output, publishing ? &tm : NULL, wld, step, &steady, verbose);
+                // Show the last step.
+                continue;
+            }
+            fprintf(stderr, " Stopping%s.\n", steady.params.fast_forward ?
+                    ", since the rest of the run isn't determined" : "");
+            break;
+        }
+
+        if (watching && config_watch_apply(&watch, wld)) {
+            fprintf(stderr, "[INFO] Reloaded population parameters from %s at time %u.\n", config_filename, wld->step);
+#ifdef EVOLVE_SPECIALIZED
+            if (step == evolve_specialized && !evolve_specialized_applies(&wld->params)) {
+                fprintf(stderr, "[WARNING] Reloaded configuration differs from the one this binary was specialized "
+                        "for; using the generic evolve().\n");
+                step = evolve;
+            }
+#endif
+            world_wake_tiles(wld);
+            if (decomposed && !decomposition_update_params(&dec, wld)) {
+                break;
+            }
+            if (detecting) {
+                steady_state_reset(&steady);
+            }
+        }
+
+        if (decomposed) {
+            // Print the steps in between, which aren't seen above.
+            u32 const first = wld->step + 1;
+            u32 const steps = forever ? block_steps : MIN(block_steps, wld->params.num_steps - wld->step);
+            if (!decomposition_step(&dec, wld, steps, tallies)) {
+                break;
+            }
+            for (u32 i = 0; (verbose || publishing) && tallies && i + 1 < steps; ++i) {
+                u32 const* const tally = &tallies[(size_t)i * wld->params.population_count];
+                if (verbose) {
+                    print_tallies(output, wld, first + i, tally);
+                }
+                if (publishing) {
+                    telemetry_publish(&tm, wld, first + i, tally);
+                }
+            }
+        } else {
+            step(wld);
+        }
     }
 
+    if (watching) {
+        config_watch_stop(&watch);
+    }
+    if (publishing) {
+        telemetry_close(&tm);
+    }
+    if (recording && !recorder_close(&rec)) {
+        fprintf(stderr, "[ERROR] Failed to write the history to %s.\n", rp.file);
+    }
+    if (output) {
+        async_writer_close(output);
+    }
+    if (decomposed) {
+        decomposition_stop(&dec);
+    }
+    steady_state_destroy(&steady);
+    free(tallies);
+
     if (display_fenster) {
         fenster_close(&f);
         f.buf = NULL;
         free(buf);
         buf = NULL;
     }
+    mipmap_destroy(&mm);
+    free(colors);
 }
 
-u32 parse_color(buffer *buf) {
-    u32 result = 0;
-    for (size_t i = 0; i < buf->len; ++i) {
-        if ('0' <= buf->p[i] && buf->p[i] <= '9') {
-            result <<= 4;
-            result += (u32)(buf->p[i] - '0');
-        } else if ('A' <= buf->p[i] && buf->p[i] <= 'F') {
-            result <<= 4;
-            result += 10 + (u32)(buf->p[i] - 'A');
-        } else if ('\'' == buf->p[i]) {
-            continue;
-        } else {
-            fprintf(stderr, "Error: Invalid character in color string.\n");
-            return WHITE;
+
+/**** Replaying ****/
+
+// A frame of a history, decoded, as the source of a mipmap; see occupied_fn.
+typedef struct replay_source {
+    history const* hs;
+    u8 const* planes;
+} replay_source;
+
+bool replay_occupied(void const* src, u16 pop, u16 x, u16 y) {
+    replay_source const* rs = src;
+    return history_occupied(rs->hs, rs->planes, pop, x, y);
+}
+
+// Mark the blocks of mm where the frame in planes differs from the one shown before, and make it the one shown. (A
+// byte of a bitplane holds 8 cells of a row, so it's within a block.)
+void replay_mark_changes(mipmap* mm, history const* hs, u8 const planes[], u8 shown[]) {
+    for (size_t i = 0; i < hs->planes_size; ++i) {
+        if (planes[i] != shown[i]) {
+            u16 const x = (u16)(i % hs->row_bytes * 8);
+            u16 const y = (u16)(i / hs->row_bytes % hs->h);
+            mipmap_mark(mm, x, y, (u16)MIN((u32)x + 8, (u32)hs->w), (u16)(y + 1));
         }
     }
-    return result;
+    memcpy(shown, planes, hs->planes_size);
 }
 
-bool config_load(char const* filename, simulation_params* params) {
-    bool config_valid = true;
-
-    json_data data = {0};
-    if (!json_read_from_file(filename, &data)) {
-        fprintf(stderr, "Failed to parse file %s: Invalid JSON format.\n", filename);
-        config_valid = false;
+// Write the step, tallies and playback state of the current frame of a replay to stderr.
+void replay_status(history const* hs, history_cursor const* cur, u32 last, u32 speed, bool paused) {
+    buffer line = {0};
+    bool ok = buffer_appendf(&line, "[INFO] Time %u/%u: Population sizes: { ", cur->step, last);
+    for (u16 pop = 0; ok && pop < hs->population_count; ++pop) {
+        history_population const* p = &hs->populations[pop];
+        ok = buffer_appendf(&line, "%s\"%.*s\": %u", pop ? " | " : "", (int)p->name_len, p->name,
+                            history_tally(hs, cur, pop));
     }
-    if (config_valid && data->type != JSON_TYPE_OBJECT) {
-        fprintf(stderr, "[ERROR] Did not find JSON object at top level.\n");
-        json_data_destroy(&data);
-        config_valid = false;
+    if (ok && buffer_appendf(&line, " } (%s, %u steps per frame)\n", paused ? "paused" : "playing", speed)) {
+        fwrite(line.p, 1, line.len, stderr);
     }
+    buffer_destroy(&line);
+}
 
-    if (config_valid) {
-        json_value *jv = {0};
+// Play back a history file recorded by run() (see recorder), from first_step on, without simulating anything:
+//  - Space: Pause, or resume.
+//  - Right, Left: Step forward, or back, one frame, and pause.
+//  - Up, Down: Play twice as fast, or half as fast.
+//  - 0 to 9: Seek to that tenth of the run. Home, End: Seek to the first, or the last, step.
+//  - Page Up, Page Down: Seek back, or forward, by one keyframe interval.
+// Seeking decodes the frames from the keyframe before the target, found in the file's index; see history_seek(). The
+// file is memory-mapped, so only the pages that are decoded are read.
+// Return: true on success; false if the file couldn't be read.
+bool replay(char const* filename, u32 first_step, u8 zoom) {
+    file_view file;
+    if (!file_view_open(filename, &file)) {
+        fprintf(stderr, "[ERROR] Cannot read %s.\n", filename);
+        return false;
+    }
+    history hs;
+    if (!history_open(&hs, (u8 const*)file.buf.p, file.buf.len)) {
+        file_view_close(&file);
+        return false;
+    }
+    u16 win_w, win_h;
+    view_window_size(hs.w, hs.h, zoom, &win_w, &win_h);
+    u8* const planes = malloc(MAX(hs.planes_size, 1));
+    u8* const shown = calloc(MAX(hs.planes_size, 1), 1);  // The frame that the mipmap is of.
+    u32* const buf = malloc((sizeof *buf) * win_w * win_h);
+    u32* const colors = malloc((sizeof *colors) * MAX(hs.population_count, 1));
+    for (u16 pop = 0; colors && pop < hs.population_count; ++pop) {
+        colors[pop] = hs.populations[pop].color;
+    }
+    mipmap mm = {0};
+    history_cursor cur;
+    // The last step is that of the last frame after the last keyframe.
+    bool ok = planes && shown && buf && colors && history_seek(&hs, UINT32_MAX, &cur, planes);
+    u32 const last = ok ? cur.step : 0;
+    ok = ok && history_seek(&hs, MAX(first_step, history_first_step(&hs)), &cur, planes);
+    if (!ok || !mipmap_create(&mm, hs.w, hs.h, hs.population_count)) {
+        fprintf(stderr, "[ERROR] %s has no frames, or is corrupt.\n", filename);
+        free(colors);
+        free(buf);
+        free(shown);
+        free(planes);
+        history_close(&hs);
+        file_view_close(&file);
+        return false;
+    }
 
-        if (!(jv = json_find_child_of_type(data, "populations", JSON_TYPE_ARRAY))) {
-            fprintf(stderr, "No 'populations' found.\n");
-            config_valid = false;
+    struct fenster f = {
+        .title = "Ecosystem Replay",
+        .width = win_w,
+        .height = win_h,
+        .buf = buf,
+    };
+    fenster_open(&f);
+    view v = view_fit(hs.w, hs.h, &f, zoom);
+    replay_source const src = { &hs, planes };
+    replay_mark_changes(&mm, &hs, planes, shown);
+    mipmap_update(&mm, replay_occupied, &src);
+    render_view(&f, &v, &mm, replay_occupied, &src, colors);
+    i64 prev_render = fenster_time();
+    u32 speed = 1;
+    bool paused = false;
+    int held[256] = {0};
+    replay_status(&hs, &cur, last, speed, paused);
+    while (ok && fenster_loop(&f) == 0 && !f.keys[27]) {
+        int const pressed = key_pressed(&f, held);
+        bool const moved = view_input(&v, &f, pressed, hs.w, hs.h, zoom);
+
+        u32 target = cur.step;  // Where to seek, if a key asks for it.
+        bool seek = true;
+        if (pressed == ' ') {
+            paused = !paused;
+            seek = false;
+        } else if (pressed == 19) {  // Right
+            paused = true;
+            seek = !history_next(&hs, &cur, planes);
+        } else if (pressed == 20) {  // Left
+            paused = true;
+            target = cur.step > 0 ? cur.step - 1 : 0;
+        } else if (pressed == 17 || pressed == 18) {  // Up, down
+            speed = pressed == 17 ? MIN(speed * 2, 1u << 16) : MAX(speed / 2, 1);
+            seek = false;
+        } else if (pressed >= '0' && pressed <= '9') {
+            target = (u32)((u64)last * (u32)(pressed - '0') / 10);
+        } else if (pressed == 2 || pressed == 5) {  // Home, end
+            target = pressed == 2 ? 0 : last;
+        } else if (pressed == 3 || pressed == 4) {  // Page up, page down
+            target = pressed == 3 ? cur.step - MIN(cur.step, hs.keyframe_interval) :
+                (u32)MIN((u64)last, (u64)cur.step + hs.keyframe_interval);
         } else {
-            *params = simulation_params_create(clamp_size_t_u16(json_count_children(jv)));
+            seek = false;
+        }
+        if (pressed && seek) {
+            // Before the first frame, show the first.
+            ok = history_seek(&hs, MAX(target, history_first_step(&hs)), &cur, planes);
         }
 
-
-        if (!(jv = json_find_child(data, "random_seed")) ||
-            !(jv->type == JSON_TYPE_NULL || jv->type == JSON_TYPE_INTEGER)) {
-            fprintf(stderr, "Failed to find 'random_seed'.\n");
-            config_valid = false;
-        } else {
-            if (jv->type == JSON_TYPE_NULL) {
-                params->rng_seed_given = false;
-            } else {
-                params->rng_seed_given = true;
-                params->rng_seed = (u64)(jv->datum.integer);
+        i64 const now = fenster_time();
+        if (!paused && now - prev_render > 1000/FPS) {
+            prev_render = now;
+            for (u32 i = 0; i < speed && !paused; ++i) {
+                // At the end, pause, so that the last frame stays up.
+                paused = !history_next(&hs, &cur, planes);
             }
-        }
-        if (!(jv = json_find_child_of_type(data, "width", JSON_TYPE_INTEGER))) {
-            fprintf(stderr, "Failed to find 'width'.\n");
-            config_valid = false;
-        } else {
-            params->w = clamp_i64_u16(jv->datum.integer);
-        }
-        if (!(jv = json_find_child_of_type(data, "height", JSON_TYPE_INTEGER))) {
-            fprintf(stderr, "Failed to find 'height'.\n");
-            config_valid = false;
-        } else {
-            params->h = clamp_i64_u16(jv->datum.integer);
-        }
-        if (!(jv = json_find_child_of_type(data, "visual", JSON_TYPE_BOOLEAN))) {
-            fprintf(stderr, "Failed to find 'visual'.\n");
-            config_valid = false;
+            replay_mark_changes(&mm, &hs, planes, shown);
+            mipmap_update(&mm, replay_occupied, &src);
+            render_view(&f, &v, &mm, replay_occupied, &src, colors);
+            if (paused) {
+                replay_status(&hs, &cur, last, speed, paused);
+            }
+        } else if (pressed || moved) {
+            replay_mark_changes(&mm, &hs, planes, shown);
+            mipmap_update(&mm, replay_occupied, &src);
+            render_view(&f, &v, &mm, replay_occupied, &src, colors);
         } else {
-            params->visual = jv->datum.boolean;
+            fenster_sleep(1);
         }
-        if (!(jv = json_find_child_of_type(data, "run_forever", JSON_TYPE_BOOLEAN))) {
-            fprintf(stderr, "Failed to find 'run_forever'.\n");
-            config_valid = false;
-        } else {
-            params->run_forever = jv->datum.boolean;
-        }
-        if (!(jv = json_find_child_of_type(data, "num_steps", JSON_TYPE_INTEGER))) {
-            fprintf(stderr, "Failed to find 'num_steps'.\n");
-            config_valid = false;
-        } else {
-            params->num_steps = clamp_i64_u32(jv->datum.integer);
-        }
-
-
-        if ((jv = json_find_child_of_type(data, "populations", JSON_TYPE_ARRAY))) {
-            json_value *json_pop_params = jv->child;
-            size_t popid = 0;
-            while (json_pop_params) {
-                if(json_pop_params->type != JSON_TYPE_OBJECT) {
-                    fprintf(stderr, "Child of 'populations' is not a JSON object.\n");
-                    config_valid = false;
-                } else {
-                    json_value *jvp = {0};
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "name", JSON_TYPE_STRING))) {
-                        fprintf(stderr, "Population has no 'name'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].name = buffer_clone(&jvp->datum.string);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "color", JSON_TYPE_STRING))) {
-                        fprintf(stderr, "Population has no 'color'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].color = parse_color(&jvp->datum.string);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "motile", JSON_TYPE_BOOLEAN))) {
-                        fprintf(stderr, "Population has no 'motile'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].motile = jvp->datum.boolean;
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "trophic_level", JSON_TYPE_INTEGER))) {
-                        fprintf(stderr, "Population has no 'trophic_level'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].trophic_level = clamp_i64_u8(jvp->datum.integer);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "initial_population", JSON_TYPE_FLOATING))) {
-                        fprintf(stderr, "Population has no 'initial_population'.\n");
-                        config_valid = false;
-                    } else {
-                        if (jvp->datum.floating < 0.0 || 1.0 < jvp->datum.floating) {
-                            fprintf(stderr, "Invalid 'initial_population': Must be between 0.0 and 1.0.\n");
-                            config_valid = false;
-                        }
-                        u32 size = (u32)((f64)(params->w * params->h) * jvp->datum.floating);
-                        params->populations[popid].initial_population_size = size;
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_at_birth", JSON_TYPE_INTEGER))) {
-                        fprintf(stderr, "Population has no 'energy_at_birth'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].energy_at_birth = clamp_i64_u16(jvp->datum.integer);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_maximum", JSON_TYPE_INTEGER))) {
-                        fprintf(stderr, "Population has no 'energy_maximum'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].energy_maximum = clamp_i64_u16(jvp->datum.integer);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_threshold_replicate", JSON_TYPE_INTEGER))) {
-                        fprintf(stderr, "Population has no 'energy_threshold_replicate'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].energy_threshold_replicate = clamp_i64_u16(jvp->datum.integer);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_cost_replicate", JSON_TYPE_INTEGER))) {
-                        fprintf(stderr, "Population has no 'energy_cost_replicate'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].energy_cost_replicate = clamp_i64_u16(jvp->datum.integer);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_gain", JSON_TYPE_INTEGER))) {
-                        fprintf(stderr, "Population has no 'energy_gain'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].energy_gain = clamp_i64_u16(jvp->datum.integer);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_cost_move", JSON_TYPE_INTEGER))) {
-                        fprintf(stderr, "Population has no 'energy_cost_move'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].energy_cost_move = clamp_i64_u16(jvp->datum.integer);
-                    }
-                    if (!(jvp = json_find_child_of_type(json_pop_params, "replication_space_needed", JSON_TYPE_INTEGER))) {
-                        fprintf(stderr, "Population has no 'replication_space_needed'.\n");
-                        config_valid = false;
-                    } else {
-                        params->populations[popid].replication_space_needed = clamp_i64_u8(jvp->datum.integer);
-                    }
-
-                }
-                json_pop_params = json_pop_params->next;
-                ++popid;
-            }
+        if (pressed) {
+            replay_status(&hs, &cur, last, speed, paused);
         }
     }
-
-    json_data_destroy(&data);
-    if (!config_valid) {
-        simulation_params_destroy(params);
+    if (!ok) {
+        fprintf(stderr, "[ERROR] %s is corrupt at time %u.\n", filename, cur.step);
     }
-    return config_valid;
-}
 
-bool config_validate(simulation_params const* params) {
-    char const*const error_prefix = "Invalid simulation parameters: ";
-    if (params->w < 1 || params->h < 1) {
-        fprintf(stderr, "%sInvalid world dimensions.\n", error_prefix);
-        return false;
-    }
-    for (u32 popid = 0; popid < params->population_count; ++popid) {
-        population_params const* p_params = &params->populations[popid];
-        if (!(p_params->replication_space_needed <= 8)) {
-            fprintf(stderr, "%sParameter 'replication_space_needed' is out of range (valid range: 0..8).\n", error_prefix);
-            return false;
-        }
-    }
-    return true;
+    fenster_close(&f);
+    mipmap_destroy(&mm);
+    free(colors);
+    free(buf);
+    free(shown);
+    free(planes);
+    history_close(&hs);
+    file_view_close(&file);
+    return ok;
 }
 
 
@@ -672,8 +736,18 @@ int main(int argc, char* argv[]) {
 
     /**** Parse command-line arguments. ****/
 
+    if (argc >= 3 && argc <= 4 && strcmp(argv[1], "--replay") == 0) {
+        char* end = NULL;
+        unsigned long const first_step = argc == 4 ? strtoul(argv[3], &end, 10) : 0;
+        if (argc == 4 && (*end != '\0' || first_step > UINT32_MAX)) {
+            fprintf(stderr, "Invalid step: %s\n", argv[3]);
+            return EXIT_FAILURE;
+        }
+        const u8 zoom = 4;
+        return replay(argv[2], (u32)first_step, zoom) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
     if (argc != 2) {
-        fprintf(stderr, "Usage: ecosystem <config.json>\n");
+        fprintf(stderr, "Usage: ecosystem <config.json>\n       ecosystem --replay <history_file> [<step>]\n");
         return EXIT_FAILURE;
     }
     char const* const filename = argv[1];
@@ -699,8 +773,22 @@ int main(int argc, char* argv[]) {
     if (!world_create(&wld, params)) {
         fprintf(stderr, "Failed to create world.\n");
     } else {
+        evolve_fn step = evolve;
+#ifdef EVOLVE_SPECIALIZED
+        if (params.steady_state.repetition_window > 0) {
+            fprintf(stderr, "[INFO] Detecting repetition needs the world's hash, which only the generic evolve() "
+                    "maintains; using it.\n");
+        } else if (params.processes > 1) {
+            fprintf(stderr, "[INFO] Splitting the world between processes uses the generic evolve().\n");
+        } else if (evolve_specialized_applies(&params)) {
+            step = evolve_specialized;
+        } else {
+            fprintf(stderr, "[WARNING] Configuration differs from the one this binary was specialized for; "
+                    "using the generic evolve().\n");
+        }
+#endif
         const u8 zoom = 4;
-        run(&wld, zoom, true);
+        run(&wld, step, zoom, true, params.watch_config ? filename : NULL);
         world_destroy(&wld);
     }
 
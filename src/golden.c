@@ -0,0 +1,398 @@
+#include "simulation.c"
+
+#ifdef EVOLVE_SPECIALIZED
+// Generated by the specialize tool; see the Makefile.
+#include "evolve_specialized.c"
+#endif
+
+// Golden-trajectory regression tests: Record, for each configuration, the population tallies and a hash of the world
+// (see world_hash()) after every step of the reference evolve(), with a fixed seed. Then check that every engine in
+// evolve_engines still reproduces them exactly; if one doesn't, report the first step, and the first cell, where it
+// diverges.
+//
+// Usage:
+//     golden record [-n <steps>] <golden_dir> <config.json>...
+//     golden check <golden_dir> <config.json>...
+//
+// A golden file is JSON Lines (one JSON value per line), written to <golden_dir>/<config's directory>_<config's
+// name>.jsonl: a header with the configuration's name, seed and number of steps, then a line for each step, from 0
+// (the initial state), of the form {"step": 1, "tally": [...], "hash": "..."}.
+
+#define GOLDEN_STEPS 200  // Default number of steps to record.
+#define GOLDEN_SEED 1  // Seed for configurations that don't give one.
+#define GOLDEN_BLOCK_STEPS 8  // Steps at a time, for engines that take several at once.
+
+typedef struct golden_row {
+    u32* tally;  // One per population.
+    u64 hash;
+} golden_row;
+
+typedef struct golden {
+    u64 seed;
+    u32 steps;
+    u16 population_count;
+    golden_row* rows;  // steps + 1 rows: the initial state, and then after each step.
+} golden;
+
+void golden_destroy(golden* g) {
+    if (g->rows) {
+        for (u32 i = 0; i <= g->steps; ++i) {
+            free(g->rows[i].tally);
+        }
+    }
+    free(g->rows);
+    *g = (golden){0};
+}
+
+// Write into out the golden file's name for config_filename, e.g., golden/config_balance.jsonl for
+// config/balance.json.
+void golden_filename(char const* golden_dir, char const* config_filename, char* out, size_t out_size) {
+    char const* const base = strrchr(config_filename, '/') ? strrchr(config_filename, '/') + 1 : config_filename;
+    // The name of the directory that holds the configuration, if any.
+    char const* dir = config_filename;
+    size_t dir_len = 0;
+    if (base != config_filename) {
+        char const* p = base - 1;
+        while (p > config_filename && p[-1] != '/') {
+            --p;
+        }
+        dir = p;
+        dir_len = (size_t)(base - 1 - p);
+    }
+    size_t base_len = strlen(base);
+    if (base_len > 5 && strcmp(base + base_len - 5, ".json") == 0) {
+        base_len -= 5;
+    }
+    snprintf(out, out_size, "%s/%.*s%s%.*s.jsonl", golden_dir, (int)dir_len, dir, dir_len ? "_" : "", (int)base_len,
+             base);
+}
+
+// Load the configuration for a golden run: the same as a normal run, but not visual, and with a fixed seed.
+bool golden_load_config(char const* config_filename, simulation_params* params) {
+    if (!config_load(config_filename, params) || !config_validate(params)) {
+        fprintf(stderr, "[ERROR] Failed to load simulation parameters from %s.\n", config_filename);
+        return false;
+    }
+    params->visual = false;
+    params->watch_config = false;
+    if (!params->rng_seed_given) {
+        params->rng_seed_given = true;
+        params->rng_seed = GOLDEN_SEED;
+    }
+    return true;
+}
+
+void golden_write_row(json_writer* w, world const* wld) {
+    json_writer_begin_object(w);
+    json_writer_key(w, "step", 4);
+    json_writer_integer(w, wld->step);
+    json_writer_key(w, "tally", 5);
+    json_writer_begin_array(w);
+    for (u16 pop = 0; pop < wld->params.population_count; ++pop) {
+        json_writer_integer(w, wld->pop_tally[pop]);
+    }
+    json_writer_end_array(w);
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)world_hash(wld));
+    json_writer_key(w, "hash", 4);
+    json_writer_string(w, hash, 16);
+    json_writer_end_object(w);
+}
+
+bool golden_record(char const* golden_dir, char const* config_filename, u32 steps) {
+    simulation_params params = {0};
+    if (!golden_load_config(config_filename, &params)) {
+        simulation_params_destroy(&params);
+        return false;
+    }
+    world wld = {0};
+    if (!world_create(&wld, params)) {
+        fprintf(stderr, "[ERROR] Failed to create world for %s.\n", config_filename);
+        world_destroy(&wld);
+        simulation_params_destroy(&params);
+        return false;
+    }
+
+    json_writer w;
+    json_writer_init(&w, 0);
+    json_writer_begin_object(&w);
+    json_writer_key(&w, "config", 6);
+    json_writer_string(&w, config_filename, strlen(config_filename));
+    json_writer_key(&w, "seed", 4);
+    json_writer_integer(&w, (i64)params.rng_seed);
+    json_writer_key(&w, "steps", 5);
+    json_writer_integer(&w, steps);
+    json_writer_key(&w, "populations", 11);
+    json_writer_begin_array(&w);
+    for (u16 pop = 0; pop < params.population_count; ++pop) {
+        json_writer_string(&w, params.populations[pop].name.p, params.populations[pop].name.len);
+    }
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+    golden_write_row(&w, &wld);
+    for (u32 step = 0; step < steps; ++step) {
+        evolve(&wld);
+        golden_write_row(&w, &wld);
+    }
+    json_writer_raw(&w, "\n", 1);
+    world_destroy(&wld);
+    simulation_params_destroy(&params);
+
+    char filename[1024];
+    golden_filename(golden_dir, config_filename, filename, sizeof(filename));
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        fprintf(stderr, "[ERROR] Failed to open file %s: %s\n", filename, strerror(errno));
+        json_writer_destroy(&w);
+        return false;
+    }
+    bool ok = json_writer_flush(&w, f);
+    ok = fclose(f) == 0 && ok;
+    json_writer_destroy(&w);
+    if (ok) {
+        printf("Recorded %u steps of %s in %s.\n", steps, config_filename, filename);
+    }
+    return ok;
+}
+
+// Parse one line of a golden file into data.
+bool golden_parse_line(buffer buf, size_t* offset, json_data* data, arena* ar) {
+    size_t end = *offset;
+    while (end < buf.len && buf.p[end] != '\n') {
+        ++end;
+    }
+    buffer const line = { end - *offset, end - *offset, buf.p + *offset };
+    *offset = end < buf.len ? end + 1 : end;
+    return line.len > 0 && json_read_from_buffer(line, data, ar) && (*data)->type == JSON_TYPE_OBJECT;
+}
+
+bool golden_read(char const* filename, golden* g) {
+    *g = (golden){0};
+    file_view view;
+    if (!file_view_open(filename, &view)) {
+        fprintf(stderr, "[ERROR] Failed to read golden file %s. (Record it with `golden record`.)\n", filename);
+        return false;
+    }
+    arena ar = {0};
+    size_t offset = 0;
+    json_data header = NULL;
+    json_value const* seed = NULL;
+    json_value const* steps = NULL;
+    json_value const* populations = NULL;
+    bool ok = golden_parse_line(view.buf, &offset, &header, &ar)
+        && (seed = json_find_child_of_type(header, "seed", JSON_TYPE_INTEGER))
+        && (steps = json_find_child_of_type(header, "steps", JSON_TYPE_INTEGER))
+        && (populations = json_find_child_of_type(header, "populations", JSON_TYPE_ARRAY));
+    if (ok) {
+        g->seed = (u64)seed->datum.integer;
+        g->steps = clamp_i64_u32(steps->datum.integer);
+        g->population_count = clamp_size_t_u16(json_count_children(populations));
+        g->rows = calloc((size_t)g->steps + 1, sizeof *g->rows);
+        ok = g->rows != NULL;
+    }
+    for (u32 i = 0; ok && i <= g->steps; ++i) {
+        json_data row = NULL;
+        json_value const* step = NULL;
+        json_value const* tally = NULL;
+        json_value const* hash = NULL;
+        ok = golden_parse_line(view.buf, &offset, &row, &ar)
+            && (step = json_find_child_of_type(row, "step", JSON_TYPE_INTEGER)) && step->datum.integer == i
+            && (tally = json_find_child_of_type(row, "tally", JSON_TYPE_ARRAY))
+            && json_count_children(tally) == g->population_count
+            && (hash = json_find_child_of_type(row, "hash", JSON_TYPE_STRING)) && hash->datum.string.len == 16;
+        if (ok) {
+            g->rows[i].tally = calloc(g->population_count, sizeof *g->rows[i].tally);
+            ok = g->rows[i].tally != NULL;
+        }
+        u16 pop = 0;
+        for (json_value const* t = ok ? tally->child : NULL; t; t = t->next, ++pop) {
+            ok = ok && t->type == JSON_TYPE_INTEGER;
+            g->rows[i].tally[pop] = ok ? clamp_i64_u32(t->datum.integer) : 0;
+        }
+        if (ok) {
+            char digits[17];
+            memcpy(digits, hash->datum.string.p, 16);
+            digits[16] = '\0';
+            g->rows[i].hash = strtoull(digits, NULL, 16);
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "[ERROR] Invalid golden file %s.\n", filename);
+        golden_destroy(g);
+    }
+    arena_destroy(&ar);
+    file_view_close(&view);
+    return ok;
+}
+
+// Report the first cell (in map order) where wld differs from the reference world ref.
+void golden_report_cell(world const* wld, world const* ref) {
+    u16 const npops = wld->params.population_count;
+    for (u16 y = 0; y < wld->h; ++y) {
+        for (u16 x = 0; x < wld->w; ++x) {
+            for (u16 pop = 0; pop < npops; ++pop) {
+                organism const* a = world_map_idx(wld, x, y, pop);
+                organism const* b = world_map_idx(ref, x, y, pop);
+                bool const same = a->exists == b->exists && (!a->exists
+                    || (a->birthday == b->birthday && a->energy == b->energy && a->kills == b->kills));
+                if (same) {
+                    continue;
+                }
+                printf("    First differing cell: (%u, %u), population \"", x, y);
+                buffer_printf(wld->params.populations[pop].name, stdout);
+                printf("\":\n");
+                organism const* const orgs[2] = { a, b };
+                char const* const labels[2] = { "engine", "reference" };
+                for (int i = 0; i < 2; ++i) {
+                    if (orgs[i]->exists) {
+                        printf("        %-9s: birthday %u, energy %u, kills %u\n", labels[i],
+                               orgs[i]->birthday, orgs[i]->energy, orgs[i]->kills);
+                    } else {
+                        printf("        %-9s: empty\n", labels[i]);
+                    }
+                }
+                return;
+            }
+        }
+    }
+    printf("    (The maps are identical; only the tallies differ.)\n");
+}
+
+// Check that the tallies of wld's populations at step match the golden row. If not, report how.
+bool golden_check_tally(world const* wld, u32 step, u32 const tally[], golden_row const* row) {
+    bool ok = true;
+    for (u16 pop = 0; pop < wld->params.population_count; ++pop) {
+        if (tally[pop] != row->tally[pop]) {
+            if (ok) {
+                printf("    Diverged at step %u:\n", step);
+            }
+            printf("    Population \"");
+            buffer_printf(wld->params.populations[pop].name, stdout);
+            printf("\" has %u organisms; expected %u.\n", tally[pop], row->tally[pop]);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Check that the world matches the golden row for its step. If not, report how.
+bool golden_check_row(world const* wld, golden_row const* row) {
+    bool ok = golden_check_tally(wld, wld->step, wld->pop_tally, row);
+    u64 const hash = world_hash(wld);
+    if (hash != row->hash) {
+        if (ok) {
+            printf("    Diverged at step %u:\n", wld->step);
+        }
+        printf("    World hash is %016llx; expected %016llx.\n", (unsigned long long)hash,
+               (unsigned long long)row->hash);
+        ok = false;
+    }
+    return ok;
+}
+
+// Run one engine on the configuration, and check it against the golden trajectory. An engine other than the reference
+// runs alongside the reference, so that, if it diverges, the first differing cell can be reported. An engine that takes
+// several steps at once does so GOLDEN_BLOCK_STEPS at a time; within a block, only its tallies can be checked.
+bool golden_check_engine(simulation_params params, golden const* g, evolve_engine const* engine) {
+    bool const is_reference = engine->step == evolve;
+    world wld = {0};
+    world ref = {0};
+    u32* tallies = calloc((size_t)GOLDEN_BLOCK_STEPS * params.population_count, sizeof *tallies);
+    bool ok = tallies && world_create(&wld, params) && (is_reference || world_create(&ref, params));
+    if (!ok) {
+        printf("    Failed to create world.\n");
+    }
+    if (ok && engine->maintains_hash) {
+        world_track_hash(&wld);
+    }
+    u32 block_begin = 0;  // The first step of the current block of steps.
+    for (u32 step = 0; ok && step <= g->steps; ++step) {
+        if (step > 0) {
+            if (!engine->steps) {
+                engine->step(&wld);
+            } else if (step > wld.step) {
+                block_begin = step;
+                engine->steps(&wld, MIN(GOLDEN_BLOCK_STEPS, g->steps - step + 1), tallies);
+            }
+            if (!is_reference) {
+                evolve(&ref);
+            }
+        }
+        if (step < wld.step) {
+            u32 const* const tally = &tallies[(size_t)(step - block_begin) * params.population_count];
+            ok = golden_check_tally(&wld, step, tally, &g->rows[step]);
+            continue;
+        }
+        if (!golden_check_row(&wld, &g->rows[step])) {
+            if (!is_reference) {
+                golden_report_cell(&wld, &ref);
+            }
+            ok = false;
+        }
+        if (ok && wld.hash_tracking && wld.hash != world_hash(&wld)) {
+            printf("    At step %u, the world's hash, as maintained by the engine, is %016llx; hashing the map gives "
+                   "%016llx.\n", wld.step, (unsigned long long)wld.hash, (unsigned long long)world_hash(&wld));
+            ok = false;
+        }
+    }
+    world_destroy(&wld);
+    world_destroy(&ref);
+    free(tallies);
+    return ok;
+}
+
+bool golden_check(char const* golden_dir, char const* config_filename) {
+    char filename[1024];
+    golden_filename(golden_dir, config_filename, filename, sizeof(filename));
+    golden g;
+    if (!golden_read(filename, &g)) {
+        return false;
+    }
+    simulation_params params = {0};
+    bool ok = golden_load_config(config_filename, &params);
+    if (ok && params.population_count != g.population_count) {
+        fprintf(stderr, "[ERROR] %s has %u populations, but %s has %u.\n", config_filename, params.population_count,
+                filename, g.population_count);
+        ok = false;
+    }
+    if (ok) {
+        params.rng_seed = g.seed;
+        for (size_t e = 0; e < EVOLVE_ENGINES_COUNT; ++e) {
+            evolve_engine const* engine = &evolve_engines[e];
+            if (engine->applies && !engine->applies(&params)) {
+                continue;
+            }
+            i64 const start = time_now_ns();
+            bool const engine_ok = golden_check_engine(params, &g, engine);
+            printf("%s %s (%s, %u steps, %.1f s)\n", engine_ok ? "PASS" : "FAIL", config_filename, engine->name,
+                   g.steps, (f64)(time_now_ns() - start) / 1e9);
+            ok = ok && engine_ok;
+        }
+    }
+    simulation_params_destroy(&params);
+    golden_destroy(&g);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    bool const record = argc >= 2 && strcmp(argv[1], "record") == 0;
+    bool const check = argc >= 2 && strcmp(argv[1], "check") == 0;
+    int first_arg = 2;
+    u32 steps = GOLDEN_STEPS;
+    if (record && argc > 3 && strcmp(argv[2], "-n") == 0) {
+        steps = (u32)MAX(0, atoi(argv[3]));
+        first_arg = 4;
+    }
+    if ((!record && !check) || argc < first_arg + 2) {
+        fprintf(stderr, "Usage: golden record [-n <steps>] <golden_dir> <config.json>...\n"
+                        "       golden check <golden_dir> <config.json>...\n");
+        return EXIT_FAILURE;
+    }
+    char const* const golden_dir = argv[first_arg];
+    bool ok = true;
+    for (int i = first_arg + 1; i < argc; ++i) {
+        bool const config_ok = record ? golden_record(golden_dir, argv[i], steps) : golden_check(golden_dir, argv[i]);
+        ok = ok && config_ok;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,301 @@
+#define UTIL_ALLOC_STATS
+#include "util.c"
+
+// Benchmark the JSON parser: parse each file repeatedly, in-process and without printing, and report throughput,
+// allocations and peak memory for each way of parsing it. Generate a corpus with scripts/gen_json_corpus.py (or
+// `make json_corpus`).
+//
+// Throughput is for the fastest repetition. Allocations and peak memory are per parse, and don't count the input,
+// which is memory-mapped.
+//
+// Then, for files with numbers, compare the number parser against the one it replaced (which had no exponents, and
+// wasn't correctly rounded), on just the numbers in the file. Finally, write each file's tree back out (to memory),
+// compactly and indented.
+
+typedef enum bench_mode {
+    BENCH_TREE_HEAP,
+    BENCH_TREE_ARENA,
+    BENCH_STREAMING,
+    BENCH_MODES_COUNT
+} bench_mode;
+
+static const char bench_mode_name[BENCH_MODES_COUNT][12] = {
+    [BENCH_TREE_HEAP] = "tree/heap",
+    [BENCH_TREE_ARENA] = "tree/arena",
+    [BENCH_STREAMING] = "streaming",
+};
+
+bool bench_parse(buffer buf, bench_mode mode) {
+    bool ok = false;
+    switch (mode) {
+    case BENCH_TREE_HEAP: {
+        json_data data = NULL;
+        ok = json_read_from_buffer(buf, &data, NULL);
+        json_data_destroy(&data);
+        break;
+    }
+    case BENCH_TREE_ARENA: {
+        arena ar = {0};
+        json_data data = NULL;
+        ok = json_read_from_buffer(buf, &data, &ar);
+        json_data_destroy(&data);
+        arena_destroy(&ar);
+        break;
+    }
+    case BENCH_STREAMING: {
+        json_sax_parser parser;
+        json_sax_parser_init(&parser, (json_sax_handler){0});
+        ok = json_sax_feed(&parser, buf.p, buf.len) && json_sax_finish(&parser);
+        json_sax_parser_destroy(&parser);
+        break;
+    }
+    default:
+        break;
+    }
+    return ok;
+}
+
+// The number parser before json_parse_number() supported exponents and correct rounding, kept for comparison (without
+// its messages). It stops at an exponent, and rejects or truncates numbers of more than 18 digits.
+bool json_parse_number_legacy(
+    buffer buf,
+    size_t* offset,
+    json_value* value
+    ) {
+    size_t offset_new = *offset;
+    bool negate = false;
+    bool got_digit = false;
+    bool is_floating = false;
+    bool got_digit_after_point = false;
+    i64 integer = 0;
+    u8 fractional_digits = 0;
+
+    while (offset_new < buf.len) {
+        char ch = buf.p[offset_new];
+        if (!got_digit && !negate && '-' == ch) {
+            negate = true;
+        } else if (got_digit && '.' == ch) {
+            if (is_floating == true) {
+                return false;
+            }
+            is_floating = true;
+        } else if ('0' <= ch && ch <= '9') {
+            if (integer > (INT64_MAX - (i64)9) / (i64)10) {
+                if (!is_floating) {
+                    return false;
+                }
+            } else {
+                integer = 10*integer + (ch - '0');
+                got_digit = true;
+                if (is_floating) {
+                    ++fractional_digits;
+                    got_digit_after_point = true;
+                }
+            }
+        } else {
+            break;
+        }
+        ++offset_new;
+    }
+    if (is_floating && !got_digit_after_point) {
+        return false;
+    }
+
+    if (negate) {
+        integer *= -1;
+    }
+    if (is_floating) {
+        f64 floating = (f64)integer;
+        for (int i = 0; i < fractional_digits; ++i) {
+            floating *= (f64)0.1;
+        }
+        value->datum.floating = floating;
+        value->type = JSON_TYPE_FLOATING;
+    } else {
+        value->datum.integer = integer;
+        value->type = JSON_TYPE_INTEGER;
+    }
+
+    *offset = offset_new;
+    return true;
+}
+
+typedef bool (*bench_number_parser)(buffer buf, size_t* offset, json_value* value);
+
+// Parse each number in buf (at the given offsets) and return the time taken in nanoseconds, or -1 on failure.
+i64 bench_numbers(buffer buf, u32 const* offsets, size_t count, bench_number_parser parse) {
+    f64 sink = 0.0;
+    i64 const start = time_now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        size_t offset = offsets[i];
+        json_value number;
+        if (!parse(buf, &offset, &number)) {
+            return -1;
+        }
+        sink += number.type == JSON_TYPE_INTEGER ? (f64)number.datum.integer : number.datum.floating;
+    }
+    i64 const end = time_now_ns();
+    // Keep the compiler from dropping the parsing.
+    volatile f64 sink_volatile = sink;
+    (void)sink_volatile;
+    return end - start;
+}
+
+// Benchmark the legacy and current number parsers on the numbers in buf, printing a row for each.
+bool bench_numbers_print(char const* basename, buffer buf, u32 repeats) {
+    json_tape tape = {0};
+    if (!json_tape_build(buf, json_scanner_selected, &tape)) {
+        return false;
+    }
+    // Numbers begin scalar runs, which the tape marks.
+    size_t count = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < tape.count; ++i) {
+        char const ch = buf.p[tape.offsets[i]];
+        if ('-' == ch || ('0' <= ch && ch <= '9')) {
+            tape.offsets[count++] = tape.offsets[i];
+            size_t end = tape.offsets[i];
+            while (end < buf.len && !json_is_whitespace(buf.p[end]) && !json_is_structural(buf.p[end])) {
+                ++end;
+            }
+            bytes += end - tape.offsets[i];
+        }
+    }
+    if (count > 0) {
+        bench_number_parser const parsers[2] = {json_parse_number_legacy, json_parse_number};
+        char const* const names[2] = {"legacy", "current"};
+        for (int p = 0; p < 2; ++p) {
+            i64 best_ns = INT64_MAX;
+            for (u32 r = 0; r < repeats; ++r) {
+                i64 const ns = bench_numbers(buf, tape.offsets, count, parsers[p]);
+                if (ns < 0) {
+                    best_ns = -1;
+                    break;
+                }
+                best_ns = MIN(best_ns, ns);
+            }
+            if (best_ns < 0) {
+                printf("%-28s %10zu  %-10s %9s %9s\n", basename, count, names[p], "failed", "");
+                continue;
+            }
+            f64 const seconds = (f64)MAX(best_ns, 1) / 1e9;
+            printf("%-28s %10zu  %-10s %9.1f %9.1f\n",
+                   basename, count, names[p], (f64)bytes / 1e6 / seconds, (f64)count / 1e6 / seconds);
+        }
+    }
+    json_tape_destroy(&tape);
+    return true;
+}
+
+// Benchmark writing the tree parsed from buf, compactly and indented, printing a row for each.
+bool bench_write_print(char const* basename, buffer buf, u32 repeats) {
+    arena ar = {0};
+    json_data data = NULL;
+    if (!json_read_from_buffer(buf, &data, &ar)) {
+        arena_destroy(&ar);
+        return false;
+    }
+    bool ok = true;
+    u32 const indents[2] = {0, 4};
+    for (int i = 0; i < 2 && ok; ++i) {
+        i64 best_ns = INT64_MAX;
+        size_t len = 0;
+        for (u32 r = 0; r < repeats && ok; ++r) {
+            json_writer w;
+            json_writer_init(&w, indents[i]);
+            i64 const start = time_now_ns();
+            ok = json_writer_value(&w, data);
+            i64 const end = time_now_ns();
+            best_ns = MIN(best_ns, end - start);
+            len = w.out.len;
+            json_writer_destroy(&w);
+        }
+        if (ok) {
+            printf("%-28s %8.1f  %-10s %9.1f\n", basename, (f64)len / 1e6, indents[i] ? "indented" : "compact",
+                   (f64)len / 1e6 / ((f64)MAX(best_ns, 1) / 1e9));
+        }
+    }
+    json_data_destroy(&data);
+    arena_destroy(&ar);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    int first_file = 1;
+    u32 repeats = 5;
+    if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+        repeats = (u32)MAX(1, atoi(argv[2]));
+        first_file = 3;
+    }
+    if (first_file >= argc) {
+        fprintf(stderr, "Usage: json_bench [-r <repeats>] <file.json>...\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%-28s %8s  %-10s %9s %12s %9s\n", "File", "MB", "Mode", "MB/s", "Allocs", "Peak MB");
+    bool ok = true;
+    for (int i = first_file; i < argc; ++i) {
+        char const* const filename = argv[i];
+        file_view view;
+        if (!file_view_open(filename, &view)) {
+            ok = false;
+            continue;
+        }
+        char const* const basename = strrchr(filename, '/') ? strrchr(filename, '/') + 1 : filename;
+        f64 const mb = (f64)view.buf.len / 1e6;
+        for (bench_mode mode = 0; mode < BENCH_MODES_COUNT; ++mode) {
+            i64 best_ns = INT64_MAX;
+            u64 allocs = 0;
+            size_t peak = 0;
+            bool parsed = true;
+            for (u32 r = 0; r < repeats && parsed; ++r) {
+                alloc_stats_reset();
+                size_t const bytes_before = alloc_stats_global.bytes;
+                i64 const start = time_now_ns();
+                parsed = bench_parse(view.buf, mode);
+                i64 const end = time_now_ns();
+                best_ns = MIN(best_ns, end - start);
+                allocs = alloc_stats_global.count;
+                peak = alloc_stats_global.bytes_peak - bytes_before;
+            }
+            if (!parsed) {
+                fprintf(stderr, "[ERROR] Failed to parse %s (%s).\n", filename, bench_mode_name[mode]);
+                ok = false;
+                continue;
+            }
+            printf("%-28s %8.1f  %-10s %9.1f %12llu %9.1f\n",
+                   basename, mb, bench_mode_name[mode], mb / ((f64)best_ns / 1e9), (unsigned long long)allocs,
+                   (f64)peak / 1e6);
+        }
+        file_view_close(&view);
+    }
+
+    printf("\n%-28s %10s  %-10s %9s %9s\n", "File", "Numbers", "Parser", "MB/s", "M/s");
+    for (int i = first_file; i < argc; ++i) {
+        char const* const filename = argv[i];
+        file_view view;
+        if (!file_view_open(filename, &view)) {
+            continue;
+        }
+        char const* const basename = strrchr(filename, '/') ? strrchr(filename, '/') + 1 : filename;
+        if (!bench_numbers_print(basename, view.buf, repeats)) {
+            ok = false;
+        }
+        file_view_close(&view);
+    }
+
+    printf("\n%-28s %8s  %-10s %9s\n", "File", "MB out", "Writer", "MB/s");
+    for (int i = first_file; i < argc; ++i) {
+        char const* const filename = argv[i];
+        file_view view;
+        if (!file_view_open(filename, &view)) {
+            continue;
+        }
+        char const* const basename = strrchr(filename, '/') ? strrchr(filename, '/') + 1 : filename;
+        if (!bench_write_print(basename, view.buf, repeats)) {
+            ok = false;
+        }
+        file_view_close(&view);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
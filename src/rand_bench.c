@@ -0,0 +1,80 @@
+#include "util.c"
+
+// Benchmark the random number generators: the division-based rand_unif() against Lemire's method, and the
+// counter-based generator used by evolve(), both one draw at a time and in batches.
+//
+// Each benchmark sums its draws, and the sums are printed, so that the compiler can't discard the work.
+
+#define DRAWS (1u << 26)
+#define BATCH 1024
+
+typedef struct bench_result {
+    char const* name;
+    f64 ns_per_draw;
+    u64 checksum;
+} bench_result;
+
+void bench_print(bench_result r) {
+    printf("%-48s %8.3f ns/draw   (checksum %016llx)\n", r.name, r.ns_per_draw, (unsigned long long)r.checksum);
+}
+
+bench_result bench_rand_unif(u32 range) {
+    rand_init_from_seed(&rand_state_global, 1);
+    u64 sum = 0;
+    i64 const start = time_now_ns();
+    for (u32 i = 0; i < DRAWS; ++i) {
+        sum += rand_unif(0, range - 1);
+    }
+    i64 const end = time_now_ns();
+    return (bench_result){ "rand_unif(0, range - 1)", (f64)(end - start) / DRAWS, sum };
+}
+
+bench_result bench_rand_bounded(u32 range) {
+    rand_init_from_seed(&rand_state_global, 1);
+    u64 sum = 0;
+    i64 const start = time_now_ns();
+    for (u32 i = 0; i < DRAWS; ++i) {
+        sum += rand_bounded(range);
+    }
+    i64 const end = time_now_ns();
+    return (bench_result){ "rand_bounded(range)", (f64)(end - start) / DRAWS, sum };
+}
+
+bench_result bench_rand_counter(u32 range) {
+    u64 sum = 0;
+    i64 const start = time_now_ns();
+    for (u32 i = 0; i < DRAWS; ++i) {
+        sum += rand_reduce(rand_counter(1, i), range);
+    }
+    i64 const end = time_now_ns();
+    return (bench_result){ "rand_reduce(rand_counter(key, i), range)", (f64)(end - start) / DRAWS, sum };
+}
+
+bench_result bench_rand_counter_fill_bounded(u32 range) {
+    u32 batch[BATCH];
+    u64 sum = 0;
+    i64 const start = time_now_ns();
+    for (u32 i = 0; i < DRAWS; i += BATCH) {
+        rand_counter_fill_bounded(1, i, range, batch, BATCH);
+        for (u32 j = 0; j < BATCH; ++j) {
+            sum += batch[j];
+        }
+    }
+    i64 const end = time_now_ns();
+    return (bench_result){ "rand_counter_fill_bounded(), in batches", (f64)(end - start) / DRAWS, sum };
+}
+
+int main(void) {
+    // 8 is the number of directions drawn in evolve()'s first pass; 3 and 7 are typical numbers of contenders in its
+    // second pass; the last is a large range which isn't a power of two.
+    u32 const ranges[] = { 8, 3, 7, 1000000007 };
+    for (size_t i = 0; i < sizeof ranges / sizeof ranges[0]; ++i) {
+        printf("Range %u:\n", ranges[i]);
+        bench_print(bench_rand_unif(ranges[i]));
+        bench_print(bench_rand_bounded(ranges[i]));
+        bench_print(bench_rand_counter(ranges[i]));
+        bench_print(bench_rand_counter_fill_bounded(ranges[i]));
+        printf("\n");
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,2989 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util.c"
+
+
+#define BLACK 0x000000
+#define WHITE 0xFFFFFF
+#define YELLOW 0xFFFF00
+#define RED 0xFF0000
+#define GREEN 0x00FF00
+#define BLUE 0x0000FF
+#define CYAN 0x00FFFF
+
+
+// The cells around an organism that it counts, to decide whether there's space to replicate, and to which it moves
+// or replicates; see neighborhood.
+typedef enum neighborhood_shape {
+    NEIGHBORHOOD_MOORE,  // The square of cells up to radius away along both axes.
+    NEIGHBORHOOD_VON_NEUMANN,  // The diamond of cells up to radius steps away along the axes: |dx| + |dy| <= radius.
+    // The cells up to radius steps away on a hexagonal grid, which the map holds in axial coordinates (its rows are
+    // sheared, rather than staggered): |dx|, |dy|, |dx + dy| <= radius.
+    NEIGHBORHOOD_HEXAGONAL,
+} neighborhood_shape;
+
+typedef struct population_params {
+    buffer name;
+    u32 color;
+    bool motile;
+    u8 trophic_level;
+    u32 initial_population_size;
+    u16 energy_at_birth;
+    u16 energy_maximum;
+    u16 energy_threshold_replicate;
+    u16 energy_cost_replicate;
+    u16 energy_gain;
+    u16 energy_cost_move;
+    u8 replication_space_needed;
+    neighborhood_shape neighborhood;
+    u8 neighborhood_radius;  // At least 1. With NEIGHBORHOOD_MOORE, 1 is the 8 cells next to the organism.
+} population_params;
+
+// When to end a run early, because the rest of it is already known, or isn't interesting; see steady_state.
+typedef struct steady_state_params {
+    bool extinction;  // Detect the extinction of every population.
+    u32 repetition_window;  // Detect the world's state repeating within this many steps. 0: Don't.
+    u32 unchanged_tally_steps;  // Detect population sizes not changing for this many steps. 0: Don't.
+    bool fast_forward;  // Skip to the last step when the rest of the run is known, rather than stopping.
+} steady_state_params;
+
+// How run() writes its output, through an async_writer.
+typedef struct output_params {
+    async_writer_policy policy;  // What to do when the ring is full. Default: Drop output, rather than wait.
+    u32 ring_bytes;  // 0: OUTPUT_DEFAULT_RING_BYTES.
+    char* spill_file;  // With ASYNC_WRITER_SPILL. NULL: OUTPUT_DEFAULT_SPILL_FILE.
+} output_params;
+
+#define OUTPUT_DEFAULT_RING_BYTES (1 << 20)
+#define OUTPUT_DEFAULT_SPILL_FILE "ecosystem_output.spill"
+
+// Whether, and how, run() publishes the run for monitors; see telemetry.
+typedef struct telemetry_params {
+    char* name;  // The shared memory segment's name. NULL: Don't publish.
+    u32 ring_records;  // 0: TELEMETRY_DEFAULT_RING_RECORDS.
+    u32 image_width;  // 0: No image.
+    u32 image_interval;  // Steps between images, 1 or more. Optional; 0 when absent: Every step.
+} telemetry_params;
+
+// Whether, and how, run() records the run's history; see recorder.
+typedef struct record_params {
+    char* file;  // NULL: Don't record.
+    u32 keyframe_interval;  // 0: HISTORY_DEFAULT_KEYFRAME_INTERVAL.
+} record_params;
+
+typedef struct simulation_params {
+    bool rng_seed_given;
+    u64 rng_seed;
+    u16 w;
+    u16 h;
+    bool visual;
+    bool run_forever;
+    u32 num_steps;
+    u16 population_count;
+    population_params* populations; // Array
+    bool watch_config;  // Reload population parameters when the configuration file changes; see config_watch.
+    steady_state_params steady_state;
+    u32 block_steps;  // With several processes: Steps between exchanges of halos (see decomposition); otherwise unused.
+    u32 processes;  // If more than 1: Split the world between this many processes; see decomposition.
+    output_params output;
+    record_params record;
+    telemetry_params telemetry;
+} simulation_params;
+
+simulation_params simulation_params_create(u16 population_count) {
+    simulation_params sp = {0};
+    if ((sp.populations = calloc(population_count, sizeof *sp.populations))) {
+        sp.population_count = population_count;
+    } else {
+        fprintf(stderr, "Failed to allocate memory for simulation_params.\n");
+    }
+    return sp;
+}
+
+void simulation_params_destroy(simulation_params *sp) {
+    for (int i = 0; i < sp->population_count; ++i) {
+        buffer_destroy(&(sp->populations[i].name));
+    }
+    sp->population_count = 0;
+    free(sp->populations);
+    sp->populations = NULL;
+    free(sp->output.spill_file);
+    sp->output.spill_file = NULL;
+    free(sp->record.file);
+    sp->record.file = NULL;
+    free(sp->telemetry.name);
+    sp->telemetry.name = NULL;
+}
+
+
+typedef struct point {
+    u16 x;
+    u16 y;
+} point;
+
+bool coincide(point a, point b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+typedef struct organism {
+    u32 birthday;
+    point target;
+    u16 energy;
+    u16 kills;
+    bool exists;
+    bool existed;
+    bool ready_to_replicate;
+    u8 contenders;  // Scratch space for evolve(): The neighbors that want this slot; see evolve_resolve_scatter().
+} organism;
+
+
+/**** Neighborhoods ****/
+
+// The default neighborhood, the Moore neighborhood of radius 1, has its own code in evolve(). Any other is described
+// by a table of its cells:
+//  - Directions: evolve() draws an index i in [0, size), and the organism targets the cell (dx[i], dy[i]) away. The
+//    cells are in order of dx, then dy, as the default's 8 directions are.
+//  - Counting: Each row of the neighborhood is a span of cells. When its center moves one cell to the right, the cells
+//    at the right ends of the spans enter it, and those at the left ends leave it. Each of these two edges is a few
+//    straight segments (vertical or diagonal), so neighborhood_count() keeps a running count along each row of the
+//    map, from prefix sums along those lines, with the same few lookups per cell whatever the radius.
+
+#define NEIGHBORHOOD_MAX_RADIUS 7
+#define NEIGHBORHOOD_MAX_ROWS (2 * NEIGHBORHOOD_MAX_RADIUS + 1)
+#define NEIGHBORHOOD_MAX_SIZE (NEIGHBORHOOD_MAX_ROWS * NEIGHBORHOOD_MAX_ROWS - 1)
+
+// The cells (x + i*slope, y + i), for i in [0, length), relative to a neighborhood's center.
+typedef struct neighborhood_segment {
+    i8 x;
+    i8 y;
+    i8 slope;  // -1, 0 or 1.
+    u8 length;
+} neighborhood_segment;
+
+typedef struct neighborhood {
+    neighborhood_shape shape;
+    u8 radius;
+    u16 size;  // Cells, other than the center.
+    i8 dx[NEIGHBORHOOD_MAX_SIZE];
+    i8 dy[NEIGHBORHOOD_MAX_SIZE];
+    // Row dy (at index dy + radius) is the cells [row_begin, row_end) of the center's row, shifted by dy.
+    i8 row_begin[NEIGHBORHOOD_MAX_ROWS];
+    i8 row_end[NEIGHBORHOOD_MAX_ROWS];
+    // The cells that enter and leave as the center moves one cell to the right, relative to where it was.
+    u8 enter_count;
+    u8 leave_count;
+    neighborhood_segment enter[NEIGHBORHOOD_MAX_ROWS];
+    neighborhood_segment leave[NEIGHBORHOOD_MAX_ROWS];
+} neighborhood;
+
+bool neighborhood_contains(neighborhood_shape shape, i32 radius, i32 dx, i32 dy) {
+    switch (shape) {
+    case NEIGHBORHOOD_VON_NEUMANN:
+        return abs(dx) + abs(dy) <= radius;
+    case NEIGHBORHOOD_HEXAGONAL:
+        return abs(dx) <= radius && abs(dy) <= radius && abs(dx + dy) <= radius;
+    default:
+        return abs(dx) <= radius && abs(dy) <= radius;
+    }
+}
+
+bool neighborhood_is_default(neighborhood const* nb) {
+    return nb->shape == NEIGHBORHOOD_MOORE && nb->radius == 1;
+}
+
+// Split the cells (xs[i], i - radius), for i in [0, 2*radius + 1), into straight segments.
+void neighborhood_segments(i8 const xs[], i32 radius, neighborhood_segment segments[], u8* count) {
+    i32 const rows = 2 * radius + 1;
+    *count = 0;
+    for (i32 i = 0; i < rows; ) {
+        neighborhood_segment s = { .x = xs[i], .y = (i8)(i - radius), .slope = 0, .length = 1 };
+        if (i + 1 < rows && abs(xs[i + 1] - xs[i]) <= 1) {
+            s.slope = (i8)(xs[i + 1] - xs[i]);
+        }
+        while (i + s.length < rows && xs[i + s.length] - xs[i + s.length - 1] == s.slope) {
+            ++s.length;
+        }
+        segments[(*count)++] = s;
+        i += s.length;
+    }
+}
+
+// Parameters:
+//   1 <= radius <= NEIGHBORHOOD_MAX_RADIUS.
+void neighborhood_create(neighborhood* nb, neighborhood_shape shape, u8 radius) {
+    *nb = (neighborhood){ .shape = shape, .radius = radius };
+    i32 const r = radius;
+    for (i32 dx = -r; dx <= r; ++dx) {
+        for (i32 dy = -r; dy <= r; ++dy) {
+            if ((dx != 0 || dy != 0) && neighborhood_contains(shape, r, dx, dy)) {
+                nb->dx[nb->size] = (i8)dx;
+                nb->dy[nb->size] = (i8)dy;
+                ++nb->size;
+            }
+        }
+    }
+    // Each row of these shapes is one span, and includes dx = 0.
+    for (i32 dy = -r; dy <= r; ++dy) {
+        i32 begin = 0;
+        i32 end = 1;
+        while (neighborhood_contains(shape, r, begin - 1, dy)) {
+            --begin;
+        }
+        while (neighborhood_contains(shape, r, end, dy)) {
+            ++end;
+        }
+        nb->row_begin[dy + r] = (i8)begin;
+        nb->row_end[dy + r] = (i8)end;
+    }
+    neighborhood_segments(nb->row_end, r, nb->enter, &nb->enter_count);
+    neighborhood_segments(nb->row_begin, r, nb->leave, &nb->leave_count);
+}
+
+typedef struct world {
+    simulation_params params;
+    u16 w;
+    u16 h;
+    u32 step;
+    u32* pop_tally;
+    organism* map;  // 3D array of dimensions [h][w][num_populations].
+    u64 rng_key;  // Key for evolve()'s random draws.
+    u32* directions;  // Scratch space for evolve(): Direction draws for one row of the map.
+    bool hash_tracking;  // If true, evolve() keeps hash up to date; see world_track_hash().
+    u64 hash;  // world_hash() of the map, if hash_tracking.
+    u32 movers;  // Organisms that set out to move or replicate in the last evolve(). If 0, no random draw mattered.
+    u16 tiles_w;
+    u16 tiles_h;
+    u8* tiles;  // 2D array of dimensions [tiles_h][tiles_w]: TILE_* flags for each tile of the map; see evolve().
+    // For a window onto a larger world (see world_window_create()): The position of this map's (0, 0) in the larger
+    // world, and that world's size, by which random draws are counted. Otherwise: (0, 0) and this world's own size.
+    u16 origin_x;
+    u16 origin_y;
+    u16 full_w;
+    u16 full_h;
+    neighborhood* neighborhoods;  // For each population; see world_neighborhoods_create().
+    u8 reach;  // The largest radius of any population's neighborhood.
+    // Scratch space for evolve(), if reach > 1: 3D array like map, of the neighbors that each organism of a population
+    // whose neighborhood has a radius above 1 counts; see neighborhood_count(). Then, neighborhood_sums is its scratch
+    // space.
+    u16* neighbor_counts;
+    u16* neighborhood_sums;
+    // Scratch space for evolve(), if any population's neighborhood isn't the default: 3D array like map, of the claims
+    // on each slot; see evolve_resolve_claims().
+    u64* claims;
+} world;
+
+// Return a pointer to the organism wld->map[y][x][pop].
+organism* world_map_idx(world const* wld, u16 x, u16 y, u16 pop) {
+    return &wld->map[(wld->params.population_count)*(y*(wld->w) + x) + pop];
+}
+
+// The cell dx, dy cells away from (x, y), where the map wraps around (more than once, if it's smaller than that).
+point world_offset(world const* wld, u16 x, u16 y, i32 dx, i32 dy) {
+    return (point){
+        .x = (u16)((((i32)x + dx) % wld->w + wld->w) % wld->w),
+        .y = (u16)((((i32)y + dy) % wld->h + wld->h) % wld->h),
+    };
+}
+
+// evolve() divides the map into tiles of TILE_SIZE x TILE_SIZE cells (smaller at the right and bottom edges), and
+// skips the tiles that are asleep.
+#define TILE_SIZE 8
+#define TILE_AWAKE 0x1  // If not set, then the tile is asleep: Nothing in it will change, unless an organism moves in.
+#define TILE_NEAR_AWAKE 0x2  // In this step: The tile or a neighboring tile is awake, so organisms may move in.
+#define TILE_ACTIVE 0x4  // In this step: Something in the tile changed.
+#define TILE_BORDER_CHANGED 0x8  // In this step: An organism appeared or disappeared on the tile's outermost cells.
+#define TILE_STAYS_AWAKE 0x10  // After this step: The tile will still be awake.
+
+u8* world_tile(world const* wld, u16 tile_x, u16 tile_y) {
+    return &wld->tiles[(size_t)tile_y * wld->tiles_w + tile_x];
+}
+
+// Like world_tile(), but for a tile position up to one tile off the map, which wraps around like the map.
+u8* world_tile_wrapped(world const* wld, i32 tile_x, i32 tile_y) {
+    return world_tile(wld,
+                      (u16)((tile_x + wld->tiles_w) % wld->tiles_w),
+                      (u16)((tile_y + wld->tiles_h) % wld->tiles_h));
+}
+
+// Wake every tile, e.g., because the population parameters changed.
+void world_wake_tiles(world* wld) {
+    memset(wld->tiles, TILE_AWAKE, (size_t)wld->tiles_w * wld->tiles_h);
+}
+
+// Wake the tiles of rows [y, y + h), which were changed other than by evolve(), and those next to them, whose
+// neighbors changed.
+void world_wake_rows(world* wld, u16 y, u16 h) {
+    if (h == 0) {
+        return;
+    }
+    i32 const first = y / TILE_SIZE - 1;
+    i32 const last = MIN((i32)(y + h - 1) / TILE_SIZE + 1, first + wld->tiles_h - 1);
+    for (i32 tile_y = first; tile_y <= last; ++tile_y) {
+        memset(world_tile_wrapped(wld, 0, tile_y), TILE_AWAKE, wld->tiles_w);
+    }
+}
+
+// The planes of neighborhood_sums, each the map wrapped around by radius cells on each side, with a margin of zeros
+// above and on both sides.
+#define NEIGHBORHOOD_SUM_PLANES 5
+
+// Set up the neighborhoods of wld's populations, and the scratch space that evolve() needs for them.
+// Return: true on success, false on failure.
+bool world_neighborhoods_create(world* wld) {
+    u16 const npops = wld->params.population_count;
+    wld->neighborhoods = calloc(npops, sizeof *wld->neighborhoods);
+    if (!wld->neighborhoods) {
+        return false;
+    }
+    wld->reach = 1;
+    bool all_default = true;
+    for (u16 pop = 0; pop < npops; ++pop) {
+        population_params const* p = &wld->params.populations[pop];
+        neighborhood_create(&wld->neighborhoods[pop], p->neighborhood, p->neighborhood_radius);
+        wld->reach = MAX(wld->reach, p->neighborhood_radius);
+        all_default = all_default && neighborhood_is_default(&wld->neighborhoods[pop]);
+    }
+    size_t const slots = (size_t)wld->w * wld->h * npops;
+    if (wld->reach > 1) {
+        size_t const plane = ((size_t)wld->w + 2 * wld->reach + 2) * ((size_t)wld->h + 2 * wld->reach + 1);
+        wld->neighbor_counts = calloc(slots, sizeof *wld->neighbor_counts);
+        wld->neighborhood_sums = calloc(NEIGHBORHOOD_SUM_PLANES * plane, sizeof *wld->neighborhood_sums);
+        if (!wld->neighbor_counts || !wld->neighborhood_sums) {
+            return false;
+        }
+    }
+    if (!all_default && !(wld->claims = calloc(slots, sizeof *wld->claims))) {
+        return false;
+    }
+    return true;
+}
+
+bool populations_create(world* wld);
+
+bool world_create(world* wld, simulation_params params) {
+    wld->params = params;
+    wld->w = params.w;
+    wld->h = params.h;
+    wld->origin_x = 0;
+    wld->origin_y = 0;
+    wld->full_w = params.w;
+    wld->full_h = params.h;
+    wld->step = 0;
+    wld->pop_tally = (u32*)calloc(
+        (size_t)params.population_count,
+        sizeof *wld->pop_tally);
+    wld->map = (organism*)calloc(
+        (size_t)wld->h * (size_t)wld->w * params.population_count,
+        sizeof *wld->map);
+    wld->directions = (u32*)calloc(
+        (size_t)wld->w * params.population_count,
+        sizeof *wld->directions);
+    wld->tiles_w = (u16)((wld->w + TILE_SIZE - 1) / TILE_SIZE);
+    wld->tiles_h = (u16)((wld->h + TILE_SIZE - 1) / TILE_SIZE);
+    wld->tiles = (u8*)calloc((size_t)wld->tiles_w * wld->tiles_h, sizeof *wld->tiles);
+    world_wake_tiles(wld);
+    if (!world_neighborhoods_create(wld)) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory for the populations' neighborhoods.\n");
+        return false;
+    }
+
+    /**** Seed RNG prior to generating populations. ****/
+    if (wld->params.rng_seed_given) {
+        rand_init_from_seed(&rand_state_global, wld->params.rng_seed);
+    } else {
+        rand_init_from_time(&rand_state_global);
+    }
+    wld->rng_key = rand_raw();
+
+    return populations_create(wld);
+}
+
+void world_destroy(world* wld) {
+    free(wld->pop_tally);
+    wld->pop_tally = NULL;
+    free(wld->map);
+    wld->map = NULL;
+    free(wld->directions);
+    wld->directions = NULL;
+    free(wld->tiles);
+    wld->tiles = NULL;
+    free(wld->neighborhoods);
+    free(wld->neighbor_counts);
+    free(wld->neighborhood_sums);
+    free(wld->claims);
+    *wld = (world){0};
+}
+
+
+// Parameters:
+//     wld: A valid (created) world.
+//     counter: Array of size wld->num_populations.
+void population_count(world* wld, u32 counter[]) {
+    u16 const num_populations = wld->params.population_count;
+    for (int i = 0; i < num_populations; ++i) {
+        counter[i] = 0;
+    }
+    organism const * const end = wld->map + (wld->w * wld->h * num_populations);
+    u16 spc = 0;
+    for (organism const* org = wld->map;
+         org != end;
+         ++org, ++spc
+        ) {
+        spc %= num_populations;
+        counter[spc] += org->exists;
+    }
+}
+
+// Rows per band, for initial population placement. Bands, rather than threads, are the unit of randomness, so that the
+// placement depends only on the seed, and not on the number of threads.
+#define PLACEMENT_BAND_ROWS 16
+
+typedef struct placement_job {
+    world* wld;
+    u64 key;  // Key from which each band's random number generator is seeded.
+    // counts[band*num_populations + pop]: Number of organisms of pop to place in band; each band counts its own down.
+    u32* counts;
+} placement_job;
+
+// Place the initial organisms of all populations within one band of rows, writing directly into the map. Uses selection
+// sampling (Knuth's Algorithm S): visit each cell in turn, and select it with probability (organisms still to be placed)
+// / (cells still to be visited). This places exactly the requested number of organisms, uniformly at random.
+void populations_place_band(void* ctx, u32 band) {
+    placement_job const*const job = ctx;
+    world* const wld = job->wld;
+    u16 const npops = wld->params.population_count;
+    population_params const*const pop_params = wld->params.populations;
+
+    u32* const remaining = &job->counts[(size_t)band * npops];
+    rand_state rs;
+    rand_init_from_seed(&rs, rand_counter(job->key, band));
+
+    u16 const y_begin = (u16)(band * PLACEMENT_BAND_ROWS);
+    u16 const y_end = (u16)MIN((u32)wld->h, (band + 1) * PLACEMENT_BAND_ROWS);
+    u32 cells_remaining = (u32)(y_end - y_begin) * wld->w;
+    organism* org = world_map_idx(wld, 0, y_begin, 0);
+    for (; cells_remaining > 0; --cells_remaining) {
+        for (u16 pop = 0; pop < npops; ++pop, ++org) {
+            if (remaining[pop] > 0 && rand_bounded_s(&rs, cells_remaining) < remaining[pop]) {
+                *org = (organism){
+                    .exists = true,
+                    .birthday = wld->step,
+                    .energy = pop_params[pop].energy_at_birth,
+                    .kills = 0,
+                };
+                --remaining[pop];
+            }
+        }
+    }
+}
+
+// Place the initial organisms of all populations, uniformly at random, in a single pass over the map.
+// Precondition: world_create(wld) has already been called, the map is empty, and the global RNG has been seeded.
+// Returns: true on success, false on failure.
+bool populations_create(world* wld) {
+    u16 const npops = wld->params.population_count;
+    population_params const*const pop_params = wld->params.populations;
+
+    // u32 is big enough for maximum u16 * u16.
+    u32 const map_cells = (u32)wld->w * (u32)wld->h;
+    for (u16 pop = 0; pop < npops; ++pop) {
+        if (map_cells < pop_params[pop].initial_population_size) {
+            fprintf(stderr, "Cannot create population %u: World map is too small.\n", pop);
+            return false;
+        }
+    }
+
+    // Split each population among the bands. The number of organisms in each band has a (multivariate)
+    // hypergeometric distribution, drawn one band at a time.
+    u32 const num_bands = ((u32)wld->h + PLACEMENT_BAND_ROWS - 1) / PLACEMENT_BAND_ROWS;
+    u32* const counts = malloc((sizeof *counts) * num_bands * npops);
+    if (!counts) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory for the initial populations.\n");
+        return false;
+    }
+    for (u16 pop = 0; pop < npops; ++pop) {
+        u32 cells_left = map_cells;
+        u32 organisms_left = pop_params[pop].initial_population_size;
+        for (u32 band = 0; band < num_bands; ++band) {
+            u32 const band_rows = MIN((u32)wld->h - band * PLACEMENT_BAND_ROWS, PLACEMENT_BAND_ROWS);
+            u32 const band_cells = band_rows * wld->w;
+            u32 const k = rand_hypergeometric_s(&rand_state_global, cells_left, organisms_left, band_cells);
+            counts[(size_t)band * npops + pop] = k;
+            cells_left -= band_cells;
+            organisms_left -= k;
+        }
+        wld->pop_tally[pop] = pop_params[pop].initial_population_size;
+    }
+
+    placement_job job = { .wld = wld, .key = rand_raw(), .counts = counts };
+    parallel_for(num_bands, populations_place_band, &job);
+    free(counts);
+    return true;
+}
+
+// Hashing the world's state: The hash is the XOR of a hash of each living organism, so that it's independent of the
+// order of the map, and can be updated as organisms change. An organism's state is its slot in the map, its birthday,
+// energy and kills. The rest of organism is scratch space for evolve(), which differs between engines.
+
+#define WORLD_HASH_KEY 0x5EED0F0E1A5C0DE5ull
+
+u64 world_hash_organism(u64 slot, organism const* org) {
+    u64 const state = ((u64)org->birthday << 32) | ((u64)org->energy << 16) | org->kills;
+    return rand_counter(rand_counter(WORLD_HASH_KEY, slot), state);
+}
+
+u64 world_hash(world const* wld) {
+    u64 hash = 0;
+    size_t const slots = (size_t)wld->w * wld->h * wld->params.population_count;
+    for (size_t slot = 0; slot < slots; ++slot) {
+        if (wld->map[slot].exists) {
+            hash ^= world_hash_organism(slot, &wld->map[slot]);
+        }
+    }
+    return hash;
+}
+
+// Have evolve() maintain wld->hash from now on, updating it as organisms are born, move, die and change, rather than
+// hashing the whole map after each step.
+void world_track_hash(world* wld) {
+    wld->hash = world_hash(wld);
+    wld->hash_tracking = true;
+}
+
+// If wld tracks its hash, toggle org, which must be in wld's map, in or out of it. Call this before changing an
+// organism, and again after.
+void world_hash_toggle(world* wld, organism const* org) {
+    if (wld->hash_tracking && org->exists) {
+        wld->hash ^= world_hash_organism((u64)(org - wld->map), org);
+    }
+}
+
+
+// All of evolve()'s random draws are made with rand_counter(), keyed by the world's rng_key, the step and the pass, and
+// counted by the cell and the population. So the draws don't depend on the order in which cells are visited.
+u64 evolve_rand_key(world const* wld, u8 pass) {
+    return rand_counter(wld->rng_key, 2 * (u64)wld->step + pass);
+}
+
+// The slot (x, y, pop) of wld, counted in the full world, by which evolve()'s draws for it are counted.
+u64 evolve_slot(world const* wld, u16 x, u16 y, u16 pop) {
+    // A window may be larger than the full world, so it may wrap around more than once. (Not %: This is hot.)
+    u32 full_x = (u32)x + wld->origin_x;
+    while (full_x >= wld->full_w) {
+        full_x -= wld->full_w;
+    }
+    u32 full_y = (u32)y + wld->origin_y;
+    while (full_y >= wld->full_h) {
+        full_y -= wld->full_h;
+    }
+    return ((u64)full_y * wld->full_w + full_x) * wld->params.population_count + pop;
+}
+
+// First pass: Draw a direction in [0, 8) for each population at each cell in [x_begin, x_end) of row y, into
+// out[x*num_populations + pop]. Each draw depends only on its slot (in the full world), so drawing part of a row gives
+// the same directions as drawing all of it.
+void evolve_draw_directions_range(world const* wld, u64 key, u16 y, u16 x_begin, u16 x_end, u32 out[]) {
+    u16 const npops = wld->params.population_count;
+    u64 const row = (u64)((y + wld->origin_y) % wld->full_h) * wld->full_w;
+    // A window's row may wrap around the full world.
+    for (u16 x = x_begin; x < x_end; ) {
+        u16 const full_x = (u16)((x + wld->origin_x) % wld->full_w);
+        u16 const run = (u16)MIN((u32)(x_end - x), (u32)(wld->full_w - full_x));
+        rand_counter_fill_bounded(key, (row + full_x) * npops, 8, out + (size_t)x * npops, (size_t)run * npops);
+        x = (u16)(x + run);
+    }
+}
+
+// First pass: Draw a direction in [0, 8) for each population at each cell in row y, into out[x*num_populations + pop].
+// Directions are drawn for empty slots, too: It's cheaper to generate the whole row at once.
+void evolve_draw_directions(world const* wld, u64 key, u16 y, u32 out[]) {
+    evolve_draw_directions_range(wld, key, y, 0, wld->w, out);
+}
+
+// First pass, for a population whose neighborhood isn't the default: Draw the index of a cell of its neighborhood for
+// the organism at (x, y), with the counter of the slot's direction, but in [0, size).
+u32 evolve_draw_neighbor(world const* wld, u64 key, u16 x, u16 y, u16 pop) {
+    return rand_reduce(rand_counter(key, evolve_slot(wld, x, y, pop)), wld->neighborhoods[pop].size);
+}
+
+// Second pass: Decide whether the k-th contender (k >= 2) for cell (x, y) replaces the current winner, which it must do
+// with probability 1/k. (The first contender always wins, without a draw.)
+bool evolve_draw_contender_wins(world const* wld, u64 key, u16 x, u16 y, u16 pop, u8 k) {
+    return rand_reduce(rand_counter(key, 8 * evolve_slot(wld, x, y, pop) + k), k) == 0;
+}
+
+// Claims (see evolve_claim()) are drawn with a key of their own, derived from the second pass's with a counter that no
+// slot reaches: evolve_draw_contender_wins() uses counters 8 * slot + k of the second pass, with k up to 8.
+#define EVOLVE_CLAIM_COUNTER UINT64_MAX
+
+u64 evolve_claim_key(u64 key_second_pass) {
+    return rand_counter(key_second_pass, EVOLVE_CLAIM_COUNTER);
+}
+
+// Second pass, for a population whose neighborhood isn't the default: The claim of the organism at (x, y) on its
+// target, drawn with key_claims (see evolve_claim_key()). Each contender draws one, and the highest wins, so each wins
+// with equal probability, whatever the order in which they're visited. The low 32 bits are the organism's cell in the
+// full world, which breaks ties, and identifies the winner; the top bit is set, so that no claim is 0, which is no
+// claim at all.
+u64 evolve_claim(world const* wld, u64 key_claims, u16 x, u16 y, u16 pop) {
+    u64 const slot = evolve_slot(wld, x, y, pop);
+    u64 const priority = rand_counter(key_claims, slot) >> 33;
+    return (1ull << 63) | (priority << 32) | (slot / wld->params.population_count);
+}
+
+// Note that an organism appeared or disappeared at (x, y) during this step.
+void evolve_tile_changed(world* wld, u16 x, u16 y) {
+    u16 const tx = x % TILE_SIZE;
+    u16 const ty = y % TILE_SIZE;
+    // Without branches, which would be hard to predict.
+    bool const border = (tx == 0) | (tx == TILE_SIZE - 1) | (x == wld->w - 1) |
+        (ty == 0) | (ty == TILE_SIZE - 1) | (y == wld->h - 1);
+    *world_tile(wld, x / TILE_SIZE, y / TILE_SIZE) |= (u8)(TILE_ACTIVE | (border * TILE_BORDER_CHANGED));
+}
+
+// Before a step: Mark the tiles into which organisms may move, because they, or one of their neighbors, are awake.
+void evolve_mark_near_awake_tiles(world* wld) {
+    for (u16 ty = 0; ty < wld->tiles_h; ++ty) {
+        for (u16 tx = 0; tx < wld->tiles_w; ++tx) {
+            bool near_awake = false;
+            for (i32 dy = -1; dy <= 1; ++dy) {
+                for (i32 dx = -1; dx <= 1; ++dx) {
+                    near_awake = near_awake || (*world_tile_wrapped(wld, tx + dx, ty + dy) & TILE_AWAKE);
+                }
+            }
+            u8* const tile = world_tile(wld, tx, ty);
+            *tile = near_awake ? (u8)(*tile | TILE_NEAR_AWAKE) : (u8)(*tile & ~TILE_NEAR_AWAKE);
+        }
+    }
+}
+
+// After a step: A tile falls asleep if nothing in it changed, and no neighboring tile's border changed. Then the next
+// step sees the same tile and the same surroundings, so nothing changes again. It wakes when something moves in, or a
+// neighboring tile's border changes.
+// With a neighborhood that reaches farther than the next cell, the borders would have to be as wide, and change far
+// more often; then every tile stays awake.
+void evolve_update_tiles(world* wld) {
+    if (wld->reach > 1) {
+        world_wake_tiles(wld);
+        return;
+    }
+    for (u16 ty = 0; ty < wld->tiles_h; ++ty) {
+        for (u16 tx = 0; tx < wld->tiles_w; ++tx) {
+            bool border_changed = false;
+            for (i32 dy = -1; dy <= 1; ++dy) {
+                for (i32 dx = -1; dx <= 1; ++dx) {
+                    u8 const neighbor = *world_tile_wrapped(wld, tx + dx, ty + dy);
+                    border_changed = border_changed || (neighbor & TILE_BORDER_CHANGED);
+                }
+            }
+            u8* const tile = world_tile(wld, tx, ty);
+            if ((*tile & TILE_ACTIVE) || border_changed) {
+                *tile |= TILE_STAYS_AWAKE;
+            }
+        }
+    }
+    size_t const tiles = (size_t)wld->tiles_w * wld->tiles_h;
+    for (size_t i = 0; i < tiles; ++i) {
+        wld->tiles[i] = (wld->tiles[i] & TILE_STAYS_AWAKE) ? TILE_AWAKE : 0;
+    }
+}
+
+// Find the next run of consecutive tiles in tile row tile_y, from *tile_x on, that have any of the given flags. Set
+// [*x_begin, *x_end) to the run's columns of cells, and *tile_x to the tile after the run.
+// Return: false if there is no such run.
+bool evolve_next_tile_run(world const* wld, u16 tile_y, u8 flags, u16* tile_x, u16* x_begin, u16* x_end) {
+    u8 const*const row = world_tile(wld, 0, tile_y);
+    u16 tx = *tile_x;
+    while (tx < wld->tiles_w && !(row[tx] & flags)) {
+        ++tx;
+    }
+    if (tx == wld->tiles_w) {
+        return false;
+    }
+    *x_begin = (u16)(tx * TILE_SIZE);
+    while (tx < wld->tiles_w && (row[tx] & flags)) {
+        ++tx;
+    }
+    *x_end = (u16)MIN((u32)wld->w, (u32)tx * TILE_SIZE);
+    *tile_x = tx;
+    return true;
+}
+
+// The sum of the cells of segment s of a neighborhood centered at index center of a plane of neighborhood_sums, from
+// the plane of prefix sums along lines of its slope. (Modulo 2^16, which is exact: No segment has that many cells.)
+u16 neighborhood_segment_sum(u16 const* lines, size_t plane, size_t pw, size_t center, neighborhood_segment s) {
+    u16 const*const line = lines + (ptrdiff_t)s.slope * (ptrdiff_t)plane;
+    ptrdiff_t const step = (ptrdiff_t)pw + s.slope;
+    ptrdiff_t const first = (ptrdiff_t)center + s.y * (ptrdiff_t)pw + s.x;
+    return (u16)(line[first + (s.length - 1) * step] - line[first - step]);
+}
+
+// Count the organisms of population pop in the neighborhood of each cell, other than the cell itself, into
+// wld->neighbor_counts, in time proportional to the area of the map, whatever the neighborhood's radius.
+void neighborhood_count(world* wld, u16 pop) {
+    neighborhood const*const nb = &wld->neighborhoods[pop];
+    u16 const npops = wld->params.population_count;
+    u16 const w = wld->w;
+    u16 const h = wld->h;
+    i32 const r = nb->radius;
+    // Cell (x, y) of the map is at (x + r + 1, y + r + 1) in each plane.
+    size_t const pw = (size_t)w + 2 * (size_t)r + 2;
+    size_t const ph = (size_t)h + 2 * (size_t)r + 1;
+    size_t const plane = pw * ph;
+    u16* const cells = wld->neighborhood_sums;
+    u16* const rows = cells + plane;  // Prefix sums along rows.
+    u16* const lines = cells + 3 * plane;  // lines + slope*plane: Prefix sums along lines of each slope in [-1, 1].
+
+    bool slopes[3] = {0};
+    for (u8 i = 0; i < nb->enter_count; ++i) {
+        slopes[nb->enter[i].slope + 1] = true;
+    }
+    for (u8 i = 0; i < nb->leave_count; ++i) {
+        slopes[nb->leave[i].slope + 1] = true;
+    }
+    memset(cells, 0, (sizeof *cells) * pw);
+    memset(rows, 0, (sizeof *rows) * pw);
+    for (size_t py = 1; py < ph; ++py) {
+        u16 const y = (u16)((((i32)py - r - 1) % h + h) % h);
+        u16 x = (u16)((((i32)-r) % w + w) % w);
+        organism const*const row = world_map_idx(wld, 0, y, pop);
+        size_t const i = py * pw;
+        cells[i] = rows[i] = 0;
+        for (size_t px = 1; px + 1 < pw; ++px) {
+            cells[i + px] = row[(size_t)x * npops].exists;
+            rows[i + px] = (u16)(rows[i + px - 1] + cells[i + px]);
+            x = (u16)(x + 1 == w ? 0 : x + 1);
+        }
+        cells[i + pw - 1] = 0;
+        rows[i + pw - 1] = rows[i + pw - 2];
+    }
+    for (i32 slope = -1; slope <= 1; ++slope) {
+        if (!slopes[slope + 1]) {
+            continue;
+        }
+        u16* const line = lines + (ptrdiff_t)slope * (ptrdiff_t)plane;
+        memset(line, 0, (sizeof *line) * pw);
+        for (size_t py = 1; py < ph; ++py) {
+            size_t const i = py * pw;
+            line[i] = line[i + pw - 1] = 0;
+            for (size_t px = 1; px + 1 < pw; ++px) {
+                line[i + px] = (u16)(cells[i + px] + line[(ptrdiff_t)(i + px - pw) - slope]);
+            }
+        }
+    }
+
+    for (u16 y = 0; y < h; ++y) {
+        size_t center = ((size_t)y + (size_t)r + 1) * pw + (size_t)r + 1;
+        u16 sum = 0;
+        for (i32 dy = -r; dy <= r; ++dy) {
+            ptrdiff_t const row = (ptrdiff_t)center + dy * (ptrdiff_t)pw;
+            sum = (u16)(sum + rows[row + nb->row_end[dy + r] - 1] - rows[row + nb->row_begin[dy + r] - 1]);
+        }
+        u16* count = &wld->neighbor_counts[(size_t)y * w * npops + pop];
+        for (u16 x = 0; ; ++x, ++center, count += npops) {
+            *count = (u16)(sum - cells[center]);
+            if (x + 1 == w) {
+                break;
+            }
+            for (u8 i = 0; i < nb->enter_count; ++i) {
+                sum = (u16)(sum + neighborhood_segment_sum(lines, plane, pw, center, nb->enter[i]));
+            }
+            for (u8 i = 0; i < nb->leave_count; ++i) {
+                sum = (u16)(sum - neighborhood_segment_sum(lines, plane, pw, center, nb->leave[i]));
+            }
+        }
+    }
+}
+
+// Second pass: winner, a neighbor of slot (x, y) for population pop, has won it. Replicate into it, or move to it.
+void evolve_settle(world* wld, u16 x, u16 y, u16 pop, organism* winner) {
+    population_params const*const pop_params = wld->params.populations;
+    organism* const org = world_map_idx(wld, x, y, pop);
+    evolve_tile_changed(wld, x, y);
+    if (winner->ready_to_replicate) {
+        // Replicate.
+        *org = (organism){
+            .birthday = wld->step,
+            .energy = pop_params[pop].energy_at_birth,
+            .kills = 0,
+            .exists = true,
+        };
+        world_hash_toggle(wld, org);
+        ++wld->pop_tally[pop];
+        world_hash_toggle(wld, winner);
+        if (winner->energy > pop_params[pop].energy_cost_replicate) {
+            winner->energy -= pop_params[pop].energy_cost_replicate;
+        } else {
+            winner->energy = 0;
+            // Don't die yet, because there's still a chance to survive by predating.
+        }
+        world_hash_toggle(wld, winner);
+    } else {
+        // Move. (The first pass noted the change where the organism was.)
+        world_hash_toggle(wld, winner);
+        *org = *winner;
+        *winner = (organism){ .existed = true };
+        if (org->energy > pop_params[pop].energy_cost_move) {
+            org->energy -= pop_params[pop].energy_cost_move;
+        } else {
+            org->energy = 0;
+            // Don't die yet, because there's still a chance to survive by predating.
+        }
+        world_hash_toggle(wld, org);
+    }
+}
+
+// Second pass, by gathering: Each empty slot looks for the neighbors that want it, in a fixed order, and picks one
+// with reservoir sampling. Only tiles near an awake tile can have contenders.
+void evolve_resolve_gather(world* wld, u64 key_second_pass) {
+    u16 const npops = wld->params.population_count;
+    bool const all_default = wld->claims == NULL;  // Otherwise, skip the populations that claim their targets.
+    for (u16 y = 0; y < wld->h; ++y) {
+        u16 const tile_y = y / TILE_SIZE;
+        u16 x_begin, x_end;
+        for (u16 tile_x = 0; evolve_next_tile_run(wld, tile_y, TILE_NEAR_AWAKE, &tile_x, &x_begin, &x_end); ) {
+            for (u16 x = x_begin; x < x_end; ++x) {
+                for (u16 pop = 0; pop < npops; ++pop ) {
+                    organism* org = world_map_idx(wld, x, y, pop);
+                    if (org->existed || (!all_default && !neighborhood_is_default(&wld->neighborhoods[pop]))) {
+                        // This site is occupied, sorry -- nobody from this population gets to move here.
+                        continue;
+                    }
+
+                    // Algorithm: Reservoir sampling: Each condending neighbor is selected with equal probability.
+                    u8 k = 0;  // Neighbors that want to move here.
+                    organism* winner = {0};
+                    u16 xs[3] = { (x == 0 ? wld->w - 1 : x - 1), x, (u16)(x + 1) % wld->w };
+                    u16 ys[3] = { (y == 0 ? wld->h - 1 : y - 1), y, (u16)(y + 1) % wld->h };
+                    for (size_t i = 0; i < 3; ++i) {
+                        for (size_t j = 0; j < 3; ++j) {
+                            if (i == 1 && j == 1) continue;
+                            point maybe = { .x = xs[j], .y = ys[i] };
+                            organism* contender = world_map_idx(wld, maybe.x, maybe.y, pop);
+                            if (contender->exists &&
+                                coincide(contender->target, (point){x, y})) {
+                                ++k;
+                                if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, x, y, pop, k)) {
+                                    winner = contender;
+                                }
+                            }
+                        }
+                    }
+
+                    if (winner) {
+                        evolve_settle(wld, x, y, pop, winner);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// The bit of a target's contenders for the neighbor dx, dy cells from it (each in [-1, 1], not both 0). The bits are
+// in the order in which evolve_resolve_gather() visits the neighbors, so a contender's rank among them is the number of
+// bits below its own.
+u8 evolve_contender_bit(i32 dx, i32 dy) {
+    i32 const n = (dy + 1) * 3 + (dx + 1);
+    return (u8)(1u << (n < 4 ? n : n - 1));
+}
+
+// Second pass, by scattering, with the same results as evolve_resolve_gather(), in time proportional to the number of
+// movers rather than to the area near awake tiles: In the first pass, each mover set its bit in its target's
+// contenders (see evolve_contender_bit()). Here, the first contender to look at a target draws the winner from the
+// contenders, as evolve_resolve_gather() would (the k-th in order replaces the winner so far with probability 1/k),
+// and leaves only the winner's bit; the winner then moves or replicates, and clears it. Each target's draw depends
+// only on the target, and each organism is a contender for one target, so the order in which movers are visited
+// doesn't matter. Every bit set in the first pass is cleared by the end of this one.
+// Notes: The world must be at least 3 cells wide and high, so that a target's neighbors are distinct.
+void evolve_resolve_scatter(world* wld, u64 key_second_pass) {
+    u16 const npops = wld->params.population_count;
+    bool const all_default = wld->claims == NULL;  // Otherwise, skip the populations that claim their targets.
+    for (u16 y = 0; y < wld->h; ++y) {
+        u16 const tile_y = y / TILE_SIZE;
+        u16 x_begin, x_end;
+        for (u16 tile_x = 0; evolve_next_tile_run(wld, tile_y, TILE_AWAKE, &tile_x, &x_begin, &x_end); ) {
+            for (u16 x = x_begin; x < x_end; ++x) {
+                for (u16 pop = 0; pop < npops; ++pop) {
+                    organism const* const mover = world_map_idx(wld, x, y, pop);
+                    point const to = mover->target;
+                    if (!mover->exists || coincide(to, (point){x, y}) ||
+                        (!all_default && !neighborhood_is_default(&wld->neighborhoods[pop]))) {
+                        continue;
+                    }
+                    i32 const dx = to.x == x ? 0 : (to.x == (x + 1) % wld->w ? 1 : -1);
+                    i32 const dy = to.y == y ? 0 : (to.y == (y + 1) % wld->h ? 1 : -1);
+                    u8 const mine = evolve_contender_bit(-dx, -dy);
+                    organism* const target = world_map_idx(wld, to.x, to.y, pop);
+                    if (!(target->contenders & mine)) {
+                        // Another contender won.
+                        continue;
+                    }
+                    if (target->existed) {
+                        // This site is occupied, sorry -- nobody from this population gets to move here.
+                        target->contenders = 0;
+                        continue;
+                    }
+                    if (target->contenders != mine) {
+                        // Reservoir sampling, as evolve_resolve_gather() does it.
+                        u8 k = 0;
+                        u8 winner = 0;
+                        for (u8 bits = target->contenders; bits; bits &= (u8)(bits - 1)) {
+                            ++k;
+                            if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, to.x, to.y, pop, k)) {
+                                winner = bits & (u8)-bits;
+                            }
+                        }
+                        target->contenders = winner;
+                        if (winner != mine) {
+                            continue;
+                        }
+                    }
+                    target->contenders = 0;
+                    evolve_settle(wld, to.x, to.y, pop, world_map_idx(wld, x, y, pop));
+                    // The mover's slot was reset if it moved, so don't look at it again.
+                }
+            }
+        }
+    }
+}
+
+// First pass, for a population whose neighborhood isn't the default: Count its organisms in the neighborhood of (x, y).
+u16 evolve_count_neighbors(world const* wld, u16 x, u16 y, u16 pop) {
+    neighborhood const*const nb = &wld->neighborhoods[pop];
+    if (nb->radius > 1) {
+        return wld->neighbor_counts[world_map_idx(wld, x, y, pop) - wld->map];
+    }
+    u16 living_neighbors = 0;
+    for (u16 i = 0; i < nb->size; ++i) {
+        point const maybe = world_offset(wld, x, y, nb->dx[i], nb->dy[i]);
+        living_neighbors = (u16)(living_neighbors + world_map_idx(wld, maybe.x, maybe.y, pop)->exists);
+    }
+    return living_neighbors;
+}
+
+// First pass, for a population whose neighborhood isn't the default: The organism at (x, y) moves or replicates. Draw
+// its target, and raise the target's claim to its own.
+void evolve_claim_target(world* wld, u64 key_first_pass, u64 key_claims, u16 x, u16 y, u16 pop) {
+    neighborhood const*const nb = &wld->neighborhoods[pop];
+    organism* const org = world_map_idx(wld, x, y, pop);
+    u32 const i = evolve_draw_neighbor(wld, key_first_pass, x, y, pop);
+    org->target = world_offset(wld, x, y, nb->dx[i], nb->dy[i]);
+    u64* const claim = &wld->claims[world_map_idx(wld, org->target.x, org->target.y, pop) - wld->map];
+    *claim = MAX(*claim, evolve_claim(wld, key_claims, x, y, pop));
+}
+
+// Second pass, for the populations whose neighborhoods aren't the default: In the first pass, each mover raised its
+// target's claim to its own (see evolve_claim()). Here, the mover whose claim is the target's clears it, and moves or
+// replicates into the target, unless it was occupied. So every claim is cleared by the end of this pass.
+void evolve_resolve_claims(world* wld, u64 key_claims) {
+    u16 const npops = wld->params.population_count;
+    for (u16 y = 0; y < wld->h; ++y) {
+        u16 const tile_y = y / TILE_SIZE;
+        u16 x_begin, x_end;
+        for (u16 tile_x = 0; evolve_next_tile_run(wld, tile_y, TILE_AWAKE, &tile_x, &x_begin, &x_end); ) {
+            for (u16 x = x_begin; x < x_end; ++x) {
+                for (u16 pop = 0; pop < npops; ++pop) {
+                    organism* const mover = world_map_idx(wld, x, y, pop);
+                    point const to = mover->target;
+                    if (!mover->exists || coincide(to, (point){x, y}) ||
+                        neighborhood_is_default(&wld->neighborhoods[pop])) {
+                        continue;
+                    }
+                    organism* const target = world_map_idx(wld, to.x, to.y, pop);
+                    u64* const claim = &wld->claims[target - wld->map];
+                    if (*claim != evolve_claim(wld, key_claims, x, y, pop)) {
+                        // Another contender won.
+                        continue;
+                    }
+                    *claim = 0;
+                    if (!target->existed) {
+                        evolve_settle(wld, to.x, to.y, pop, mover);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Take one time step.
+//
+// Organisms only interact with their neighbors, so evolve() skips the tiles of the map that are asleep (see
+// evolve_update_tiles()). In a mature world, only the tiles where something happens are visited.
+void evolve(world* wld) {
+    population_params const*const pop_params = wld->params.populations;
+    u16 const npops = wld->params.population_count;
+    u64 const key_first_pass = evolve_rand_key(wld, 0);
+    u64 const key_second_pass = evolve_rand_key(wld, 1);
+    u64 const key_claims = evolve_claim_key(key_second_pass);
+    u32 movers = 0;
+    // Contention for targets is resolved by scattering (see evolve_resolve_scatter()), unless the world is so small
+    // that a cell's neighbors aren't distinct.
+    bool const scatter = wld->w >= 3 && wld->h >= 3;
+    // Only populations whose neighborhoods aren't the default claim their targets.
+    bool const all_default = wld->claims == NULL;
+    evolve_mark_near_awake_tiles(wld);
+    for (u16 pop = 0; pop < npops; ++pop) {
+        if (wld->neighborhoods[pop].radius > 1) {
+            neighborhood_count(wld, pop);
+        }
+    }
+
+    // First pass: Each organism decides which direction to move.
+    for (u16 y = 0; y < wld->h; ++y) {
+        u16 const tile_y = y / TILE_SIZE;
+        u16 x_begin, x_end;
+        for (u16 tile_x = 0; evolve_next_tile_run(wld, tile_y, TILE_AWAKE, &tile_x, &x_begin, &x_end); ) {
+            evolve_draw_directions_range(wld, key_first_pass, y, x_begin, x_end, wld->directions);
+            for (u16 x = x_begin; x < x_end; ++x) {
+                for (u16 pop = 0; pop < npops; ++pop ) {
+                    organism* org = world_map_idx(wld, x, y, pop);
+                    org->existed = org->exists;
+                    if (!org->exists) {
+                        continue;
+                    }
+                    // Passive energy gain.
+                    u16 const energy = org->energy;
+                    world_hash_toggle(wld, org);
+                    org->energy += pop_params[pop].energy_gain;
+                    world_hash_toggle(wld, org);
+
+                    bool org_can_move = pop_params[pop].motile;
+
+                    u16 living_neighbors = 0;
+                    u16 xs[3] = { (x == 0 ? wld->w - 1 : x - 1), x, (u16)(x + 1) % wld->w };
+                    u16 ys[3] = { (y == 0 ? wld->h - 1 : y - 1), y, (u16)(y + 1) % wld->h };
+                    for (size_t i = 0; i < 3; ++i) {
+                        for (size_t j = 0; j < 3; ++j) {
+                            if (i == 1 && j == 1) continue;
+                            point maybe = { .x = xs[j], .y = ys[i] };
+                            organism* neighbor = world_map_idx(wld, maybe.x, maybe.y, pop);
+                            if (neighbor->exists) {
+                                ++living_neighbors;
+                            }
+                        }
+                    }
+                    bool const default_neighborhood = all_default || neighborhood_is_default(&wld->neighborhoods[pop]);
+                    u16 neighborhood_size = 8;
+                    if (!default_neighborhood) {
+                        // Count its own neighborhood instead. (The count above is unconditional, since it's hot.)
+                        neighborhood_size = wld->neighborhoods[pop].size;
+                        living_neighbors = evolve_count_neighbors(wld, x, y, pop);
+                    }
+
+                    bool org_can_replicate =
+                        (org->energy >= pop_params[pop].energy_threshold_replicate) &&
+                        (living_neighbors + pop_params[pop].replication_space_needed <= neighborhood_size);
+                    org->ready_to_replicate = org_can_replicate;
+
+                    // Unless it moves, replicates or predates, the organism ends the step as it began if its energy,
+                    // once capped, is unchanged and not 0.
+                    if (org_can_move) {
+                        // It may leave.
+                        evolve_tile_changed(wld, x, y);
+                    } else if (org_can_replicate || org->energy == 0 ||
+                               MIN(pop_params[pop].energy_maximum, org->energy) != energy) {
+                        *world_tile(wld, x / TILE_SIZE, tile_y) |= TILE_ACTIVE;
+                    }
+
+                    if ((org_can_move || org_can_replicate) && !default_neighborhood) {
+                        ++movers;
+                        evolve_claim_target(wld, key_first_pass, key_claims, x, y, pop);
+                    } else if (org_can_move || org_can_replicate) {
+                        ++movers;
+                        u16 xs[3] = { (x == 0 ? wld->w - 1 : x - 1), x, (u16)(x + 1) % wld->w };
+                        u16 ys[3] = { (y == 0 ? wld->h - 1 : y - 1), y, (u16)(y + 1) % wld->h };
+                        u32 ru = wld->directions[x*npops + pop];
+                        if (ru >= 4)
+                            ++ru;
+                        org->target = (point){
+                            .x = xs[ru / 3],
+                            .y = ys[ru % 3],
+                        };
+                        if (scatter) {
+                            world_map_idx(wld, org->target.x, org->target.y, pop)->contenders |=
+                                evolve_contender_bit(1 - (i32)(ru / 3), 1 - (i32)(ru % 3));
+                        }
+                    } else {
+                        // This one shall remain where it is.
+                        org->target = (point){.x = x, .y = y};
+                    }
+                }
+            }
+        }
+    }
+
+    // Second pass: Organisms move or replicate to targets, with uniformly random choice when there is contention for
+    // the same cell.
+    if (scatter) {
+        evolve_resolve_scatter(wld, key_second_pass);
+    } else {
+        evolve_resolve_gather(wld, key_second_pass);
+    }
+    if (wld->claims) {
+        evolve_resolve_claims(wld, key_claims);
+    }
+
+    // Third pass: Predation and death, in awake tiles, and in sleeping tiles into which organisms moved.
+    for (u16 y = 0; y < wld->h; ++y) {
+        u16 const tile_y = y / TILE_SIZE;
+        u16 x_begin, x_end;
+        for (u16 tile_x = 0; evolve_next_tile_run(wld, tile_y, TILE_AWAKE | TILE_ACTIVE, &tile_x, &x_begin, &x_end); ) {
+            for (u16 x = x_begin; x < x_end; ++x) {
+                for (u16 pop = 0; pop < npops; ++pop ) {
+                    organism* org = world_map_idx(wld, x, y, pop);
+                    if (!org->exists) {
+                        continue;
+                    }
+                    world_hash_toggle(wld, org);
+
+                    // Predate.
+                    for (u16 other_pop = 0; other_pop < npops; ++other_pop) {
+                        if (pop_params[pop].trophic_level == 0 ||
+                            pop_params[pop].trophic_level - 1 != pop_params[other_pop].trophic_level) {
+                            // This is not a prey population.
+                            continue;
+                        }
+                        organism* prey = world_map_idx(wld, x, y, other_pop);
+                        if (prey->exists) {
+                            world_hash_toggle(wld, prey);
+                            evolve_tile_changed(wld, x, y);
+                            org->energy += prey->energy;
+                            *prey = (organism){0};
+                            --wld->pop_tally[other_pop];
+                            ++org->kills;
+                        }
+                    }
+
+                    // Die.
+                    if (org->energy == 0) {
+                        evolve_tile_changed(wld, x, y);
+                        *org = (organism){0};
+                        --wld->pop_tally[pop];
+                    }
+
+                    org->energy = MIN(pop_params[pop].energy_maximum, org->energy);
+                    world_hash_toggle(wld, org);
+                }
+            }
+        }
+    }
+
+    evolve_update_tiles(wld);
+    wld->movers = movers;
+    ++wld->step;
+}
+
+/**** Windows ****/
+
+// A window is a world that holds a part of a larger one, which it advances with evolve() on its own; the decomposition
+// below advances each process's band of the world as a window.
+//
+// A cell's state after a step depends on the cells up to evolve_dependency_radius() away: An organism's move depends on
+// the other contenders for its target, and theirs on their neighbors. So, to advance a part of the world by k steps, a
+// window of that part plus a halo of k * evolve_dependency_radius() cells on each side is copied out and advanced; the
+// window's edges come out wrong, but the error spreads by at most evolve_dependency_radius() cells a step, and so never
+// reaches the part. A window's random draws are counted by its cells' positions in the full world, so the results are
+// the same as those of k calls of evolve() on the whole world.
+
+#define EVOLVE_DEPENDENCY_RADIUS 3  // In units of the neighborhoods' reach: target, contenders, their neighbors.
+#define EVOLVE_WINDOW_MAX_STEPS 64  // Most steps between loads of a window, so that windows' sizes fit in u16.
+
+u32 evolve_dependency_radius(world const* wld) {
+    return EVOLVE_DEPENDENCY_RADIUS * (u32)wld->reach;
+}
+
+// Allocate a window of up to w x h cells onto wld. Load it with world_window_load().
+// Return: true on success, false on failure.
+// Notes: The caller is responsible for calling world_destroy(win), whether or not this call was successful.
+bool world_window_create(world* win, world const* wld, u16 w, u16 h) {
+    u16 const npops = wld->params.population_count;
+    *win = (world){
+        .params = wld->params,
+        .w = w,
+        .h = h,
+        .rng_key = wld->rng_key,
+        .full_w = wld->full_w,
+        .full_h = wld->full_h,
+        .pop_tally = calloc(npops, sizeof *win->pop_tally),
+        .map = calloc((size_t)w * h * npops, sizeof *win->map),
+        .directions = calloc((size_t)w * npops, sizeof *win->directions),
+        .tiles_w = (u16)((w + TILE_SIZE - 1) / TILE_SIZE),
+        .tiles_h = (u16)((h + TILE_SIZE - 1) / TILE_SIZE),
+    };
+    win->tiles = calloc((size_t)win->tiles_w * win->tiles_h, sizeof *win->tiles);
+    return win->pop_tally && win->map && win->directions && win->tiles && world_neighborhoods_create(win);
+}
+
+// Copy the w x h cells of wld whose top left corner is at (x, y) (which may be off the map, since the map wraps around)
+// into win, and match its step. w and h must be at most the sizes given to world_window_create().
+void world_window_load(world* win, world const* wld, i32 x, i32 y, u16 w, u16 h) {
+    u16 const npops = wld->params.population_count;
+    win->w = w;
+    win->h = h;
+    win->origin_x = (u16)((x % wld->w + wld->w) % wld->w);
+    win->origin_y = (u16)((y % wld->h + wld->h) % wld->h);
+    win->step = wld->step;
+    win->tiles_w = (u16)((w + TILE_SIZE - 1) / TILE_SIZE);
+    win->tiles_h = (u16)((h + TILE_SIZE - 1) / TILE_SIZE);
+    world_wake_tiles(win);
+    for (u16 row = 0; row < h; ++row) {
+        u16 const full_y = (u16)((win->origin_y + row) % wld->h);
+        // A row may wrap around the map, more than once if the window is wider than the map.
+        for (u16 col = 0; col < w; ) {
+            u16 const full_x = (u16)((win->origin_x + col) % wld->w);
+            u16 const run = (u16)MIN((u32)(w - col), (u32)(wld->w - full_x));
+            memcpy(world_map_idx(win, col, row, 0), world_map_idx(wld, full_x, full_y, 0),
+                   sizeof(organism) * run * npops);
+            col = (u16)(col + run);
+        }
+    }
+}
+
+// Add the number of organisms of each population within the w x h cells of win at (x, y) to tally[pop].
+void world_window_count(world const* win, u16 x, u16 y, u16 w, u16 h, u32 tally[]) {
+    u16 const npops = win->params.population_count;
+    for (u16 row = y; row < y + h; ++row) {
+        organism const* org = world_map_idx(win, x, row, 0);
+        for (u16 col = 0; col < w; ++col) {
+            for (u16 pop = 0; pop < npops; ++pop, ++org) {
+                tally[pop] += org->exists;
+            }
+        }
+    }
+}
+
+// Advance wld by steps calls of evolve(). If tallies isn't NULL, then it receives the population tallies after each
+// step: tallies[i*population_count + pop] after step i + 1.
+void evolve_steps(world* wld, u32 steps, u32 tallies[]) {
+    for (u32 i = 0; i < steps; ++i) {
+        evolve(wld);
+        if (tallies) {
+            memcpy(&tallies[(size_t)i * wld->params.population_count], wld->pop_tally,
+                   (sizeof *tallies) * wld->params.population_count);
+        }
+    }
+}
+
+
+/**** Domain decomposition ****/
+
+// A decomposition splits the world between the processes of a transport, for worlds too large for one. Each process
+// (rank) owns a band of rows, and advances it with evolve(), as a window (see Windows, above) with a halo of rows
+// above and below. Every halo_steps steps, neighboring ranks send each other the rows of their bands that lie in each
+// other's halos. The halo holds every cell that the band's next halo_steps steps depend on (including the moves into
+// the band, which depend on their contenders), so the bands advance exactly as the whole world would, and nothing else
+// needs to be exchanged. Rank 0 also holds the whole world: It drives the other ranks, sums their tallies, and gathers
+// their bands into the world's map on request.
+
+#define DECOMPOSITION_CHECK_RANKS 3  // Ranks for the engine that the golden tool checks.
+
+typedef enum decomposition_op {
+    DECOMPOSITION_STEP,  // Take some steps, and send the tallies of the band after each one to rank 0.
+    DECOMPOSITION_GATHER,  // Send the band to rank 0.
+    DECOMPOSITION_PARAMS,  // Receive new population parameters from rank 0.
+    DECOMPOSITION_STOP,
+} decomposition_op;
+
+typedef struct decomposition_command {
+    u32 op;  // A decomposition_op.
+    u32 steps;
+} decomposition_command;
+
+typedef struct decomposition {
+    transport net;
+    world band;  // This rank's band, with its halo above and below, as a window onto the world.
+    u16 band_y;  // The band's first row in the world.
+    u16 band_h;
+    u16 halo;  // Rows in each halo: evolve_dependency_radius() * halo_steps, or 0 with just one rank.
+    u32 halo_steps;
+    u32 stale_steps;  // Steps since the halos were last exchanged.
+} decomposition;
+
+// The rows of the world in rank's band: [*y, *y + *h).
+void decomposition_band_rows(world const* wld, u32 ranks, u32 rank, u16* y, u16* h) {
+    *y = (u16)((u32)wld->h * rank / ranks);
+    *h = (u16)((u32)wld->h * (rank + 1) / ranks - *y);
+}
+
+// Send each band's edge rows to the neighboring ranks, for their halos, and receive its halos from them.
+bool decomposition_exchange(decomposition* dec) {
+    world* const band = &dec->band;
+    u32 const up = (dec->net.rank + dec->net.ranks - 1) % dec->net.ranks;
+    u32 const down = (dec->net.rank + 1) % dec->net.ranks;
+    size_t const size = sizeof(organism) * band->w * dec->halo * band->params.population_count;
+    // With two ranks, up and down are the same rank, so the order of the messages matters: Each rank sends its bottom
+    // rows first, and receives its top halo first.
+    transport_message const sends[2] = {
+        { down, world_map_idx(band, 0, dec->band_h, 0), size },
+        { up, world_map_idx(band, 0, dec->halo, 0), size },
+    };
+    transport_message const recvs[2] = {
+        { up, world_map_idx(band, 0, 0, 0), size },
+        { down, world_map_idx(band, 0, (u16)(dec->halo + dec->band_h), 0), size },
+    };
+    if (!dec->net.exchange(&dec->net, sends, 2, recvs, 2)) {
+        return false;
+    }
+    world_wake_rows(band, 0, dec->halo);
+    world_wake_rows(band, (u16)(dec->halo + dec->band_h), dec->halo);
+    dec->stale_steps = 0;
+    return true;
+}
+
+// Advance this rank's band by steps steps, exchanging halos as needed, and set tallies[i*population_count + pop] to
+// the band's tally after step i + 1.
+bool decomposition_advance(decomposition* dec, u32 steps, u32 tallies[]) {
+    u16 const npops = dec->band.params.population_count;
+    memset(tallies, 0, (sizeof *tallies) * steps * npops);
+    for (u32 i = 0; i < steps; ++i) {
+        if (dec->net.ranks > 1 && dec->stale_steps == dec->halo_steps && !decomposition_exchange(dec)) {
+            return false;
+        }
+        evolve(&dec->band);
+        ++dec->stale_steps;
+        world_window_count(&dec->band, 0, dec->halo, dec->band.w, dec->band_h, &tallies[(size_t)i * npops]);
+    }
+    return true;
+}
+
+// Give the band new population parameters, keeping its own names.
+void decomposition_set_params(decomposition* dec, population_params const populations[]) {
+    for (u16 pop = 0; pop < dec->band.params.population_count; ++pop) {
+        buffer const name = dec->band.params.populations[pop].name;
+        dec->band.params.populations[pop] = populations[pop];
+        dec->band.params.populations[pop].name = name;
+    }
+    world_wake_tiles(&dec->band);
+}
+
+// The loop of ranks other than 0: Carry out rank 0's commands, until it stops, or fails.
+// Return: true if rank 0 stopped it; false on failure, including rank 0's.
+bool decomposition_serve(decomposition* dec) {
+    u16 const npops = dec->band.params.population_count;
+    u32* tallies = NULL;
+    population_params* populations = calloc(npops, sizeof *populations);
+    decomposition_command command;
+    bool ok = populations != NULL;
+    while (ok && (ok = transport_recv(&dec->net, 0, &command, sizeof command)) && command.op != DECOMPOSITION_STOP) {
+        switch (command.op) {
+        case DECOMPOSITION_STEP: {
+            u32* const more = realloc(tallies, (sizeof *tallies) * MAX(command.steps, 1) * npops);
+            ok = more && decomposition_advance(dec, command.steps, (tallies = more)) &&
+                transport_send(&dec->net, 0, tallies, (sizeof *tallies) * command.steps * npops);
+            break;
+        }
+        case DECOMPOSITION_GATHER:
+            ok = transport_send(&dec->net, 0, world_map_idx(&dec->band, 0, dec->halo, 0),
+                                sizeof(organism) * dec->band.w * dec->band_h * npops);
+            break;
+        case DECOMPOSITION_PARAMS:
+            ok = transport_recv(&dec->net, 0, populations, (sizeof *populations) * npops);
+            if (ok) {
+                decomposition_set_params(dec, populations);
+            }
+            break;
+        default:
+            ok = false;
+        }
+    }
+    free(tallies);
+    free(populations);
+    return ok;
+}
+
+// Send a command to every other rank.
+bool decomposition_command_all(decomposition* dec, decomposition_command command) {
+    transport_message sends[TRANSPORT_LOCAL_MAX_RANKS];
+    for (u32 rank = 1; rank < dec->net.ranks; ++rank) {
+        sends[rank - 1] = (transport_message){ rank, &command, sizeof command };
+    }
+    return dec->net.exchange(&dec->net, sends, dec->net.ranks - 1, NULL, 0);
+}
+
+// Split wld between ranks processes (fewer if its bands would be thinner than their halos), which exchange halos every
+// halo_steps steps. This returns only in rank 0, the calling process; the others serve it until it stops them.
+// Return: true on success, false on failure.
+// Notes: Call this before starting any threads; see transport_local_spawn().
+bool decomposition_start(decomposition* dec, world const* wld, u32 ranks, u32 halo_steps) {
+    halo_steps = MIN(MAX(halo_steps, 1), (u32)EVOLVE_WINDOW_MAX_STEPS);
+    u32 const max_ranks = MAX(wld->h / (evolve_dependency_radius(wld) * halo_steps), 1);
+    if (ranks > max_ranks) {
+        fprintf(stderr, "[WARNING] The world is too small to split between %u processes; using %u.\n", ranks,
+                max_ranks);
+        ranks = max_ranks;
+    }
+    *dec = (decomposition){ .halo_steps = halo_steps };
+    if (!transport_local_spawn(&dec->net, ranks)) {
+        return false;
+    }
+    dec->halo = (u16)(ranks > 1 ? evolve_dependency_radius(wld) * halo_steps : 0);
+    decomposition_band_rows(wld, ranks, dec->net.rank, &dec->band_y, &dec->band_h);
+    u16 const h = (u16)(dec->band_h + 2 * dec->halo);
+    bool const ok = world_window_create(&dec->band, wld, wld->w, h);
+    if (ok) {
+        world_window_load(&dec->band, wld, 0, (i32)dec->band_y - dec->halo, wld->w, h);
+    }
+    if (dec->net.rank != 0) {
+        // The band's parameters are this process's copy of wld's, which it may change.
+        if (!ok) {
+            fprintf(stderr, "[ERROR] Process %u failed to allocate memory for its band.\n", dec->net.rank);
+        }
+        // Rank 0 learns of a failure from the exit status; see transport_local_close().
+        _exit(ok && decomposition_serve(dec) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (!ok) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory for the band of process 0.\n");
+        decomposition_command_all(dec, (decomposition_command){ DECOMPOSITION_STOP, 0 });
+        dec->net.close(&dec->net);
+        world_destroy(&dec->band);
+    }
+    return ok;
+}
+
+// In rank 0: Advance the world by steps steps, and set its tallies. If tallies isn't NULL, then it receives the tallies
+// after each step, as with evolve_steps(). The world's map isn't updated; see decomposition_gather().
+// Return: true on success; false if any rank failed.
+bool decomposition_step(decomposition* dec, world* wld, u32 steps, u32 tallies[]) {
+    u16 const npops = wld->params.population_count;
+    if (steps == 0) {
+        return true;
+    }
+    size_t const count = (size_t)steps * npops;
+    u32* const sum = malloc((sizeof *sum) * count);
+    u32* const part = malloc((sizeof *part) * count);
+    bool ok = sum && part && decomposition_command_all(dec, (decomposition_command){ DECOMPOSITION_STEP, steps }) &&
+        decomposition_advance(dec, steps, sum);
+    for (u32 rank = 1; ok && rank < dec->net.ranks; ++rank) {
+        ok = transport_recv(&dec->net, rank, part, (sizeof *part) * count);
+        for (size_t i = 0; ok && i < count; ++i) {
+            sum[i] += part[i];
+        }
+    }
+    if (ok) {
+        wld->step += steps;
+        memcpy(wld->pop_tally, &sum[count - npops], (sizeof *sum) * npops);
+        if (tallies) {
+            memcpy(tallies, sum, (sizeof *sum) * count);
+        }
+    }
+    free(sum);
+    free(part);
+    return ok;
+}
+
+// In rank 0: Copy every rank's band into the world's map.
+bool decomposition_gather(decomposition* dec, world* wld) {
+    u16 const npops = wld->params.population_count;
+    transport_message recvs[TRANSPORT_LOCAL_MAX_RANKS];
+    for (u32 rank = 1; rank < dec->net.ranks; ++rank) {
+        u16 y, h;
+        decomposition_band_rows(wld, dec->net.ranks, rank, &y, &h);
+        recvs[rank - 1] = (transport_message){
+            rank, world_map_idx(wld, 0, y, 0), sizeof(organism) * wld->w * h * npops
+        };
+    }
+    if (!decomposition_command_all(dec, (decomposition_command){ DECOMPOSITION_GATHER, 0 }) ||
+        !dec->net.exchange(&dec->net, NULL, 0, recvs, dec->net.ranks - 1)) {
+        return false;
+    }
+    memcpy(world_map_idx(wld, 0, dec->band_y, 0), world_map_idx(&dec->band, 0, dec->halo, 0),
+           sizeof(organism) * wld->w * dec->band_h * npops);
+    world_wake_tiles(wld);
+    if (wld->hash_tracking) {
+        wld->hash = world_hash(wld);
+    }
+    return true;
+}
+
+// In rank 0: Send the world's population parameters, which have changed, to every rank.
+bool decomposition_update_params(decomposition* dec, world const* wld) {
+    // Rank 0's band shares the world's parameters.
+    world_wake_tiles(&dec->band);
+    transport_message sends[TRANSPORT_LOCAL_MAX_RANKS];
+    for (u32 rank = 1; rank < dec->net.ranks; ++rank) {
+        sends[rank - 1] = (transport_message){
+            rank, wld->params.populations, (sizeof *wld->params.populations) * wld->params.population_count
+        };
+    }
+    return decomposition_command_all(dec, (decomposition_command){ DECOMPOSITION_PARAMS, 0 }) &&
+        dec->net.exchange(&dec->net, sends, dec->net.ranks - 1, NULL, 0);
+}
+
+// In rank 0: Stop the other ranks, and wait for them to finish.
+// Return: true if they all succeeded; false if any failed, which is reported.
+bool decomposition_stop(decomposition* dec) {
+    bool const ok = decomposition_command_all(dec, (decomposition_command){ DECOMPOSITION_STOP, 0 });
+    bool const closed = dec->net.close(&dec->net);
+    world_destroy(&dec->band);
+    return ok && closed;
+}
+
+// Advance wld by steps steps, as evolve_steps() does, but split between DECOMPOSITION_CHECK_RANKS processes, for the
+// golden tool to check.
+void evolve_decomposed(world* wld, u32 steps, u32 tallies[]) {
+    u32 const step = wld->step;
+    decomposition dec;
+    if (decomposition_start(&dec, wld, DECOMPOSITION_CHECK_RANKS, 1)) {
+        bool const ok = decomposition_step(&dec, wld, steps, tallies) && decomposition_gather(&dec, wld);
+        decomposition_stop(&dec);
+        if (ok) {
+            return;
+        }
+        if (wld->step != step) {
+            fprintf(stderr, "[ERROR] Failed to gather the bands of the world after step %u.\n", wld->step);
+            return;
+        }
+    }
+    fprintf(stderr, "[WARNING] evolve_decomposed() failed; using evolve().\n");
+    evolve_steps(wld, steps, tallies);
+}
+
+// Take one time step with evolve_decomposed(), for the list of engines below.
+void evolve_decomposed_one(world* wld) {
+    evolve_decomposed(wld, 1, NULL);
+}
+
+
+// A function that advances the world by one time step, with the same result as evolve().
+typedef void (*evolve_fn)(world* wld);
+
+// A function that advances the world by several time steps, like evolve_steps().
+typedef void (*evolve_steps_fn)(world* wld, u32 steps, u32 tallies[]);
+
+#ifdef EVOLVE_SPECIALIZED
+// Generated by the specialize tool, and included after this file; see the Makefile.
+void evolve_specialized(world* wld);
+bool evolve_specialized_applies(simulation_params const* params);
+#endif
+
+// The ways to advance the world, all of which must give the same results as evolve(), the reference. The golden tool
+// checks each of them against recorded trajectories.
+typedef struct evolve_engine {
+    char const* name;
+    evolve_fn step;
+    bool (*applies)(simulation_params const* params);  // NULL if the engine works for every configuration.
+    bool maintains_hash;  // Whether the engine keeps wld->hash up to date when wld->hash_tracking is set.
+    evolve_steps_fn steps;  // If not NULL, then the engine is best used to take several steps at once.
+} evolve_engine;
+
+evolve_engine const evolve_engines[] = {
+    { "reference", evolve, NULL, true, NULL },
+    { "decomposed", evolve_decomposed_one, NULL, true, evolve_decomposed },
+#ifdef EVOLVE_SPECIALIZED
+    { "specialized", evolve_specialized, evolve_specialized_applies, false, NULL },
+#endif
+};
+
+#define EVOLVE_ENGINES_COUNT (sizeof evolve_engines / sizeof evolve_engines[0])
+
+
+u32 parse_color(buffer *buf) {
+    u32 result = 0;
+    for (size_t i = 0; i < buf->len; ++i) {
+        if ('0' <= buf->p[i] && buf->p[i] <= '9') {
+            result <<= 4;
+            result += (u32)(buf->p[i] - '0');
+        } else if ('A' <= buf->p[i] && buf->p[i] <= 'F') {
+            result <<= 4;
+            result += 10 + (u32)(buf->p[i] - 'A');
+        } else if ('\'' == buf->p[i]) {
+            continue;
+        } else {
+            fprintf(stderr, "Error: Invalid character in color string.\n");
+            return WHITE;
+        }
+    }
+    return result;
+}
+
+// Load the optional settings of the "steady_state" object; see steady_state_params.
+bool steady_state_params_load(json_value const* jv, steady_state_params* params) {
+    *params = (steady_state_params){0};
+    json_value const* jvs = NULL;
+    if ((jvs = json_find_child(jv, "extinction"))) {
+        if (jvs->type != JSON_TYPE_BOOLEAN) {
+            return false;
+        }
+        params->extinction = jvs->datum.boolean;
+    }
+    if ((jvs = json_find_child(jv, "repetition_window"))) {
+        if (jvs->type != JSON_TYPE_INTEGER || jvs->datum.integer < 0) {
+            return false;
+        }
+        params->repetition_window = clamp_i64_u32(jvs->datum.integer);
+    }
+    if ((jvs = json_find_child(jv, "unchanged_tally_steps"))) {
+        if (jvs->type != JSON_TYPE_INTEGER || jvs->datum.integer < 0) {
+            return false;
+        }
+        params->unchanged_tally_steps = clamp_i64_u32(jvs->datum.integer);
+    }
+    if ((jvs = json_find_child(jv, "action"))) {
+        if (jvs->type != JSON_TYPE_STRING) {
+            return false;
+        }
+        // buffer_eq() matches prefixes, so compare lengths, too.
+        buffer const* action = &jvs->datum.string;
+        if (action->len == strlen("fast_forward") && buffer_eq(action, "fast_forward")) {
+            params->fast_forward = true;
+        } else if (!(action->len == strlen("stop") && buffer_eq(action, "stop"))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copy the non-empty string jv into a new null-terminated string, *str, which the caller must free.
+// Return: true on success; false if jv isn't a non-empty string, or memory couldn't be allocated.
+bool config_string(json_value const* jv, char** str) {
+    if (jv->type != JSON_TYPE_STRING || jv->datum.string.len == 0 || !(*str = malloc(jv->datum.string.len + 1))) {
+        return false;
+    }
+    memcpy(*str, jv->datum.string.p, jv->datum.string.len);
+    (*str)[jv->datum.string.len] = '\0';
+    return true;
+}
+
+bool output_params_load(json_value const* jv, output_params* params) {
+    *params = (output_params){0};
+    json_value const* jvs = NULL;
+    if ((jvs = json_find_child(jv, "policy"))) {
+        if (jvs->type != JSON_TYPE_STRING) {
+            return false;
+        }
+        // buffer_eq() matches prefixes, so compare lengths, too.
+        buffer const* policy = &jvs->datum.string;
+        if (policy->len == strlen("block") && buffer_eq(policy, "block")) {
+            params->policy = ASYNC_WRITER_BLOCK;
+        } else if (policy->len == strlen("spill") && buffer_eq(policy, "spill")) {
+            params->policy = ASYNC_WRITER_SPILL;
+        } else if (!(policy->len == strlen("drop") && buffer_eq(policy, "drop"))) {
+            return false;
+        }
+    }
+    if ((jvs = json_find_child(jv, "ring_bytes"))) {
+        if (jvs->type != JSON_TYPE_INTEGER || jvs->datum.integer < 1 || jvs->datum.integer > (1 << 30)) {
+            return false;
+        }
+        params->ring_bytes = clamp_i64_u32(jvs->datum.integer);
+    }
+    if ((jvs = json_find_child(jv, "spill_file")) && !config_string(jvs, &params->spill_file)) {
+        return false;
+    }
+    return true;
+}
+
+// Load a population's optional "neighborhood" object into its shape and radius.
+bool neighborhood_params_load(json_value const* jv, population_params* params) {
+    params->neighborhood = NEIGHBORHOOD_MOORE;
+    params->neighborhood_radius = 1;
+    json_value const* jvs = NULL;
+    if ((jvs = json_find_child(jv, "shape"))) {
+        if (jvs->type != JSON_TYPE_STRING) {
+            return false;
+        }
+        // buffer_eq() matches prefixes, so compare lengths, too.
+        buffer const* shape = &jvs->datum.string;
+        if (shape->len == strlen("von_neumann") && buffer_eq(shape, "von_neumann")) {
+            params->neighborhood = NEIGHBORHOOD_VON_NEUMANN;
+        } else if (shape->len == strlen("hexagonal") && buffer_eq(shape, "hexagonal")) {
+            params->neighborhood = NEIGHBORHOOD_HEXAGONAL;
+        } else if (!(shape->len == strlen("moore") && buffer_eq(shape, "moore"))) {
+            return false;
+        }
+    }
+    if ((jvs = json_find_child(jv, "radius"))) {
+        if (jvs->type != JSON_TYPE_INTEGER || jvs->datum.integer < 1 || jvs->datum.integer > NEIGHBORHOOD_MAX_RADIUS) {
+            return false;
+        }
+        params->neighborhood_radius = clamp_i64_u8(jvs->datum.integer);
+    }
+    return true;
+}
+
+bool record_params_load(json_value const* jv, record_params* params) {
+    *params = (record_params){0};
+    json_value const* jvs = NULL;
+    if (!(jvs = json_find_child(jv, "file")) || !config_string(jvs, &params->file)) {
+        return false;
+    }
+    if ((jvs = json_find_child(jv, "keyframe_interval"))) {
+        if (jvs->type != JSON_TYPE_INTEGER || jvs->datum.integer < 1) {
+            return false;
+        }
+        params->keyframe_interval = clamp_i64_u32(jvs->datum.integer);
+    }
+    return true;
+}
+
+bool telemetry_params_load(json_value const* jv, telemetry_params* params) {
+    *params = (telemetry_params){0};
+    json_value const* jvs = NULL;
+    if (!(jvs = json_find_child(jv, "name")) || !config_string(jvs, &params->name)) {
+        return false;
+    }
+    char const* const keys[] = { "ring_records", "image_width", "image_interval" };
+    u32* const values[] = { &params->ring_records, &params->image_width, &params->image_interval };
+    for (size_t i = 0; i < sizeof keys / sizeof *keys; ++i) {
+        if ((jvs = json_find_child(jv, keys[i]))) {
+            if (jvs->type != JSON_TYPE_INTEGER || jvs->datum.integer < 1 || jvs->datum.integer > (1 << 24)) {
+                return false;
+            }
+            *values[i] = clamp_i64_u32(jvs->datum.integer);
+        }
+    }
+    return true;
+}
+
+bool config_load(char const* filename, simulation_params* params) {
+    bool config_valid = true;
+
+    // Everything needed is copied out of the JSON data, so it can all be freed at once, at the end.
+    arena ar = {0};
+    json_data data = {0};
+    if (!json_read_from_file(filename, &data, &ar)) {
+        fprintf(stderr, "Failed to parse file %s: Invalid JSON format.\n", filename);
+        config_valid = false;
+    }
+    if (config_valid && data->type != JSON_TYPE_OBJECT) {
+        fprintf(stderr, "[ERROR] Did not find JSON object at top level.\n");
+        json_data_destroy(&data);
+        config_valid = false;
+    }
+
+    if (config_valid) {
+        json_value *jv = {0};
+
+        if (!(jv = json_find_child_of_type(data, "populations", JSON_TYPE_ARRAY))) {
+            fprintf(stderr, "No 'populations' found.\n");
+            config_valid = false;
+        } else {
+            *params = simulation_params_create(clamp_size_t_u16(json_count_children(jv)));
+        }
+
+
+        if (!(jv = json_find_child(data, "random_seed")) ||
+            !(jv->type == JSON_TYPE_NULL || jv->type == JSON_TYPE_INTEGER)) {
+            fprintf(stderr, "Failed to find 'random_seed'.\n");
+            config_valid = false;
+        } else {
+            if (jv->type == JSON_TYPE_NULL) {
+                params->rng_seed_given = false;
+            } else {
+                params->rng_seed_given = true;
+                params->rng_seed = (u64)(jv->datum.integer);
+            }
+        }
+        if (!(jv = json_find_child_of_type(data, "width", JSON_TYPE_INTEGER))) {
+            fprintf(stderr, "Failed to find 'width'.\n");
+            config_valid = false;
+        } else {
+            params->w = clamp_i64_u16(jv->datum.integer);
+        }
+        if (!(jv = json_find_child_of_type(data, "height", JSON_TYPE_INTEGER))) {
+            fprintf(stderr, "Failed to find 'height'.\n");
+            config_valid = false;
+        } else {
+            params->h = clamp_i64_u16(jv->datum.integer);
+        }
+        if (!(jv = json_find_child_of_type(data, "visual", JSON_TYPE_BOOLEAN))) {
+            fprintf(stderr, "Failed to find 'visual'.\n");
+            config_valid = false;
+        } else {
+            params->visual = jv->datum.boolean;
+        }
+        if (!(jv = json_find_child_of_type(data, "run_forever", JSON_TYPE_BOOLEAN))) {
+            fprintf(stderr, "Failed to find 'run_forever'.\n");
+            config_valid = false;
+        } else {
+            params->run_forever = jv->datum.boolean;
+        }
+        if (!(jv = json_find_child_of_type(data, "num_steps", JSON_TYPE_INTEGER))) {
+            fprintf(stderr, "Failed to find 'num_steps'.\n");
+            config_valid = false;
+        } else {
+            params->num_steps = clamp_i64_u32(jv->datum.integer);
+        }
+        // Optional.
+        if ((jv = json_find_child(data, "watch_config"))) {
+            if (jv->type != JSON_TYPE_BOOLEAN) {
+                fprintf(stderr, "Invalid 'watch_config': Must be true or false.\n");
+                config_valid = false;
+            } else {
+                params->watch_config = jv->datum.boolean;
+            }
+        }
+        if ((jv = json_find_child(data, "block_steps"))) {
+            if (jv->type != JSON_TYPE_INTEGER || jv->datum.integer < 0) {
+                fprintf(stderr, "Invalid 'block_steps': Must be a non-negative integer.\n");
+                config_valid = false;
+            } else {
+                params->block_steps = clamp_i64_u32(jv->datum.integer);
+            }
+        }
+        if ((jv = json_find_child(data, "processes"))) {
+            if (jv->type != JSON_TYPE_INTEGER || jv->datum.integer < 1 ||
+                jv->datum.integer > TRANSPORT_LOCAL_MAX_RANKS) {
+                fprintf(stderr, "Invalid 'processes': Must be an integer from 1 to %u.\n", TRANSPORT_LOCAL_MAX_RANKS);
+                config_valid = false;
+            } else {
+                params->processes = clamp_i64_u32(jv->datum.integer);
+            }
+        }
+        if (params->block_steps > 1 && params->processes <= 1) {
+            fprintf(stderr, "[WARNING] 'block_steps' has no effect without 'processes' of 2 or more.\n");
+        }
+        if ((jv = json_find_child(data, "output"))) {
+            if (jv->type != JSON_TYPE_OBJECT || !output_params_load(jv, &params->output)) {
+                fprintf(stderr, "Invalid 'output': Must be an object with optional 'policy' (\"drop\", \"block\" or "
+                        "\"spill\"), 'ring_bytes' (an integer from 1 to 2^30) and 'spill_file' (a file name).\n");
+                config_valid = false;
+            }
+        }
+        if ((jv = json_find_child(data, "record"))) {
+            if (jv->type != JSON_TYPE_OBJECT || !record_params_load(jv, &params->record)) {
+                fprintf(stderr, "Invalid 'record': Must be an object with 'file' (a file name) and optional "
+                        "'keyframe_interval' (a positive integer).\n");
+                config_valid = false;
+            }
+        }
+        if ((jv = json_find_child(data, "telemetry"))) {
+            if (jv->type != JSON_TYPE_OBJECT || !telemetry_params_load(jv, &params->telemetry)) {
+                fprintf(stderr, "Invalid 'telemetry': Must be an object with 'name' (a shared memory name) and "
+                        "optional 'ring_records', 'image_width' and 'image_interval' (integers from 1 to 2^24).\n");
+                config_valid = false;
+            }
+        }
+        if ((jv = json_find_child(data, "steady_state"))) {
+            if (jv->type != JSON_TYPE_OBJECT || !steady_state_params_load(jv, &params->steady_state)) {
+                fprintf(stderr, "Invalid 'steady_state': Must be an object with optional 'extinction' (true or "
+                        "false), 'repetition_window' and 'unchanged_tally_steps' (non-negative integers), and "
+                        "'action' (\"stop\" or \"fast_forward\").\n");
+                config_valid = false;
+            }
+        }
+
+
+        if ((jv = json_find_child_of_type(data, "populations", JSON_TYPE_ARRAY))) {
+            json_value *json_pop_params = jv->child;
+            size_t popid = 0;
+            while (json_pop_params) {
+                if(json_pop_params->type != JSON_TYPE_OBJECT) {
+                    fprintf(stderr, "Child of 'populations' is not a JSON object.\n");
+                    config_valid = false;
+                } else {
+                    json_value *jvp = {0};
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "name", JSON_TYPE_STRING))) {
+                        fprintf(stderr, "Population has no 'name'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].name = buffer_clone(&jvp->datum.string);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "color", JSON_TYPE_STRING))) {
+                        fprintf(stderr, "Population has no 'color'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].color = parse_color(&jvp->datum.string);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "motile", JSON_TYPE_BOOLEAN))) {
+                        fprintf(stderr, "Population has no 'motile'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].motile = jvp->datum.boolean;
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "trophic_level", JSON_TYPE_INTEGER))) {
+                        fprintf(stderr, "Population has no 'trophic_level'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].trophic_level = clamp_i64_u8(jvp->datum.integer);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "initial_population", JSON_TYPE_FLOATING))) {
+                        fprintf(stderr, "Population has no 'initial_population'.\n");
+                        config_valid = false;
+                    } else {
+                        if (jvp->datum.floating < 0.0 || 1.0 < jvp->datum.floating) {
+                            fprintf(stderr, "Invalid 'initial_population': Must be between 0.0 and 1.0.\n");
+                            config_valid = false;
+                        }
+                        u32 size = (u32)((f64)(params->w * params->h) * jvp->datum.floating);
+                        params->populations[popid].initial_population_size = size;
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_at_birth", JSON_TYPE_INTEGER))) {
+                        fprintf(stderr, "Population has no 'energy_at_birth'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].energy_at_birth = clamp_i64_u16(jvp->datum.integer);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_maximum", JSON_TYPE_INTEGER))) {
+                        fprintf(stderr, "Population has no 'energy_maximum'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].energy_maximum = clamp_i64_u16(jvp->datum.integer);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_threshold_replicate", JSON_TYPE_INTEGER))) {
+                        fprintf(stderr, "Population has no 'energy_threshold_replicate'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].energy_threshold_replicate = clamp_i64_u16(jvp->datum.integer);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_cost_replicate", JSON_TYPE_INTEGER))) {
+                        fprintf(stderr, "Population has no 'energy_cost_replicate'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].energy_cost_replicate = clamp_i64_u16(jvp->datum.integer);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_gain", JSON_TYPE_INTEGER))) {
+                        fprintf(stderr, "Population has no 'energy_gain'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].energy_gain = clamp_i64_u16(jvp->datum.integer);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "energy_cost_move", JSON_TYPE_INTEGER))) {
+                        fprintf(stderr, "Population has no 'energy_cost_move'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].energy_cost_move = clamp_i64_u16(jvp->datum.integer);
+                    }
+                    if (!(jvp = json_find_child_of_type(json_pop_params, "replication_space_needed", JSON_TYPE_INTEGER))) {
+                        fprintf(stderr, "Population has no 'replication_space_needed'.\n");
+                        config_valid = false;
+                    } else {
+                        params->populations[popid].replication_space_needed = clamp_i64_u8(jvp->datum.integer);
+                    }
+                    // Optional.
+                    params->populations[popid].neighborhood_radius = 1;
+                    if ((jvp = json_find_child(json_pop_params, "neighborhood")) && (jvp->type != JSON_TYPE_OBJECT ||
+                        !neighborhood_params_load(jvp, &params->populations[popid]))) {
+                        fprintf(stderr, "Invalid 'neighborhood': Must be an object with optional 'shape' (\"moore\", "
+                                "\"von_neumann\" or \"hexagonal\") and 'radius' (an integer from 1 to %u).\n",
+                                NEIGHBORHOOD_MAX_RADIUS);
+                        config_valid = false;
+                    }
+
+                }
+                json_pop_params = json_pop_params->next;
+                ++popid;
+            }
+        }
+    }
+
+    json_data_destroy(&data);
+    arena_destroy(&ar);
+    if (!config_valid) {
+        simulation_params_destroy(params);
+    }
+    return config_valid;
+}
+
+bool config_validate(simulation_params const* params) {
+    char const*const error_prefix = "Invalid simulation parameters: ";
+    if (params->w < 1 || params->h < 1) {
+        fprintf(stderr, "%sInvalid world dimensions.\n", error_prefix);
+        return false;
+    }
+    for (u32 popid = 0; popid < params->population_count; ++popid) {
+        population_params const* p_params = &params->populations[popid];
+        if (p_params->neighborhood_radius < 1 || p_params->neighborhood_radius > NEIGHBORHOOD_MAX_RADIUS) {
+            fprintf(stderr, "%sParameter 'neighborhood' has an invalid radius.\n", error_prefix);
+            return false;
+        }
+        neighborhood nb;
+        neighborhood_create(&nb, p_params->neighborhood, p_params->neighborhood_radius);
+        if (!(p_params->replication_space_needed <= nb.size)) {
+            fprintf(stderr, "%sParameter 'replication_space_needed' is out of range (valid range: 0..%u, the size of "
+                    "the neighborhood).\n", error_prefix, nb.size);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+/**** Reloading the configuration ****/
+
+// Watch the configuration file while the simulation runs, so that population parameters (e.g., energy_gain) can be
+// tuned without rebuilding the world. A background thread polls the file's modification time, and, when it changes,
+// loads and validates the file again. The new parameters are then applied by config_watch_apply(), between steps.
+//
+// Only population parameters are reloaded. The world's layout (width, height and number of populations) and the
+// populations' neighborhoods can't change, so files that change them are rejected; other settings (e.g., num_steps)
+// take effect on the next run.
+
+#define CONFIG_WATCH_POLL_MS 250
+
+typedef struct config_watch {
+    char const* filename;
+    u16 w;  // The world's layout, which reloaded parameters must match.
+    u16 h;
+    u16 population_count;
+    i64 mtime_ns;  // When the file was last loaded. Only used by the watching thread.
+    thread watcher;
+    mutex lock;
+    // Guarded by lock:
+    bool stop;  // Set to stop the watching thread.
+    bool has_pending;  // True if pending holds parameters not yet applied.
+    simulation_params pending;
+} config_watch;
+
+void config_watch_poll(void* arg) {
+    config_watch* cw = arg;
+    while (true) {
+        // Sleep in short slices, so that config_watch_stop() doesn't wait long.
+        for (u32 slept_ms = 0; slept_ms < CONFIG_WATCH_POLL_MS; slept_ms += 50) {
+            mutex_lock(&cw->lock);
+            bool const stop = cw->stop;
+            mutex_unlock(&cw->lock);
+            if (stop) {
+                return;
+            }
+            time_sleep_ms(50);
+        }
+
+        i64 mtime_ns;
+        if (!file_modification_time(cw->filename, &mtime_ns) || mtime_ns == cw->mtime_ns) {
+            continue;
+        }
+        cw->mtime_ns = mtime_ns;
+        simulation_params params = {0};
+        if (!config_load(cw->filename, &params) || !config_validate(&params)) {
+            fprintf(stderr, "[WARNING] Failed to reload %s; keeping the current parameters.\n", cw->filename);
+            simulation_params_destroy(&params);
+            continue;
+        }
+        if (params.w != cw->w || params.h != cw->h || params.population_count != cw->population_count) {
+            fprintf(stderr, "[WARNING] Ignoring changes to %s: The width, height and number of populations can't "
+                    "change while running.\n", cw->filename);
+            simulation_params_destroy(&params);
+            continue;
+        }
+        mutex_lock(&cw->lock);
+        if (cw->has_pending) {
+            // Superseded before it was applied.
+            simulation_params_destroy(&cw->pending);
+        }
+        cw->pending = params;
+        cw->has_pending = true;
+        mutex_unlock(&cw->lock);
+    }
+}
+
+// Start watching filename, from which params (the running world's parameters) were loaded.
+// Return: true on success; false if the file can't be watched.
+// Notes: If this call is successful, then the caller is responsible for calling config_watch_stop(cw).
+bool config_watch_start(config_watch* cw, char const* filename, simulation_params const* params) {
+    *cw = (config_watch){
+        .filename = filename,
+        .w = params->w,
+        .h = params->h,
+        .population_count = params->population_count,
+    };
+    if (!file_modification_time(filename, &cw->mtime_ns)) {
+        fprintf(stderr, "[ERROR] Cannot watch %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    mutex_init(&cw->lock);
+    if (!thread_start(&cw->watcher, config_watch_poll, cw)) {
+        fprintf(stderr, "[ERROR] Failed to start a thread to watch %s.\n", filename);
+        mutex_destroy(&cw->lock);
+        return false;
+    }
+    return true;
+}
+
+void config_watch_stop(config_watch* cw) {
+    mutex_lock(&cw->lock);
+    cw->stop = true;
+    mutex_unlock(&cw->lock);
+    thread_join(&cw->watcher);
+    mutex_destroy(&cw->lock);
+    if (cw->has_pending) {
+        simulation_params_destroy(&cw->pending);
+    }
+    *cw = (config_watch){0};
+}
+
+// Apply reloaded population parameters to wld, if there are any. Call this between steps.
+// Return: true if wld's parameters changed.
+bool config_watch_apply(config_watch* cw, world* wld) {
+    mutex_lock(&cw->lock);
+    bool const has_pending = cw->has_pending;
+    simulation_params pending = cw->pending;
+    cw->has_pending = false;
+    cw->pending = (simulation_params){0};
+    mutex_unlock(&cw->lock);
+    if (!has_pending) {
+        return false;
+    }
+    // The world's neighborhoods, and evolve()'s scratch space for them, were set up for the current ones.
+    for (u16 pop = 0; pop < wld->params.population_count; ++pop) {
+        if (pending.populations[pop].neighborhood != wld->params.populations[pop].neighborhood ||
+            pending.populations[pop].neighborhood_radius != wld->params.populations[pop].neighborhood_radius) {
+            fprintf(stderr, "[WARNING] Ignoring changes to %s: The populations' neighborhoods can't change while "
+                    "running.\n", cw->filename);
+            simulation_params_destroy(&pending);
+            return false;
+        }
+    }
+    // Swap the parameters into wld's array in place, since the array is shared with the caller of world_create().
+    // The old ones are destroyed with pending.
+    for (u16 pop = 0; pop < wld->params.population_count; ++pop) {
+        population_params const old = wld->params.populations[pop];
+        wld->params.populations[pop] = pending.populations[pop];
+        pending.populations[pop] = old;
+    }
+    simulation_params_destroy(&pending);
+    return true;
+}
+
+
+
+/**** Detecting a steady state ****/
+
+// Many runs reach a state early on from which nothing interesting happens, e.g., every population is extinct, or only
+// sessile organisms at their maximum energy are left. steady_state watches the world after each step for:
+//  - Extinction of every population.
+//  - Repetition: The world's state (its hash and tallies) is the same as it was within the last repetition_window
+//    steps. The world must track its hash; see world_track_hash().
+//  - Unchanged tallies: No population's size has changed for unchanged_tally_steps steps.
+//
+// Some of these determine the rest of the run exactly: An extinct world stays so, and if the state repeats with
+// period p, and none of the last p steps made use of a random draw (see world.movers), then each step is a function of
+// the state alone, so the state repeats with period p forever. Only then can the run be fast-forwarded. A repetition
+// after random draws may not repeat again, and unchanged tallies are only a heuristic.
+
+typedef enum steady_state_reason {
+    STEADY_STATE_NONE,
+    STEADY_STATE_EXTINCTION,
+    STEADY_STATE_REPETITION,
+    STEADY_STATE_UNCHANGED_TALLIES,
+} steady_state_reason;
+
+typedef struct steady_state {
+    steady_state_params params;
+    u16 population_count;
+    u32 history_size;  // The last history_size states are kept, indexed by step % history_size.
+    u32 recorded;  // States recorded since the last reset, up to history_size.
+    u64* hashes;  // Array of size history_size.
+    u32* tallies;  // 2D array of dimensions [history_size][population_count].
+    u32 deterministic_steps;  // Consecutive steps, up to the last, that made no use of a random draw.
+    u32 unchanged_steps;  // Consecutive steps, up to the last, that didn't change the tallies.
+    // Once detected:
+    steady_state_reason reason;
+    u32 step;  // When the condition was detected.
+    u32 period;  // For a repetition: The state at step equals the state at step - period.
+    bool exact;  // True if the state repeats with period forever, from step - period.
+} steady_state;
+
+// Return: true on success, false on failure.
+// Notes: The caller is responsible for calling steady_state_destroy(ss), whether or not this call was successful.
+bool steady_state_create(steady_state* ss, steady_state_params params, u16 population_count) {
+    // Keep at least two states, to compare each with the last.
+    u32 const history_size = MAX(params.repetition_window, 1) + 1;
+    *ss = (steady_state){
+        .params = params,
+        .population_count = population_count,
+        .history_size = history_size,
+        .hashes = calloc(history_size, sizeof *ss->hashes),
+        .tallies = calloc((size_t)history_size * population_count, sizeof *ss->tallies),
+    };
+    if (!ss->hashes || !ss->tallies) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory for steady state detection.\n");
+        return false;
+    }
+    return true;
+}
+
+void steady_state_destroy(steady_state* ss) {
+    free(ss->hashes);
+    free(ss->tallies);
+    *ss = (steady_state){0};
+}
+
+// Forget the recorded states, e.g., because the population parameters changed, so that the past no longer predicts
+// the future.
+void steady_state_reset(steady_state* ss) {
+    ss->recorded = 0;
+    ss->deterministic_steps = 0;
+    ss->unchanged_steps = 0;
+    ss->reason = STEADY_STATE_NONE;
+}
+
+// The tallies recorded at step, which must be one of the last history_size recorded steps.
+u32 const* steady_state_tally(steady_state const* ss, u32 step) {
+    return &ss->tallies[(size_t)(step % ss->history_size) * ss->population_count];
+}
+
+// For a detected, exact steady state: The tallies at a later step, which are those of a step within the last period.
+u32 const* steady_state_future_tally(steady_state const* ss, u32 step) {
+    assert(ss->exact && step > ss->step);
+    return steady_state_tally(ss, ss->step - ss->period + 1 + (step - ss->step - 1) % ss->period);
+}
+
+// Record wld's state after a step (or initially). Call this after every step, in order.
+// Return: true if a steady state was detected; see ss->reason.
+bool steady_state_update(steady_state* ss, world const* wld) {
+    u16 const npops = ss->population_count;
+    u32 const step = wld->step;
+    u32 const* const previous = steady_state_tally(ss, step - 1);
+    u32* const tally = &ss->tallies[(size_t)(step % ss->history_size) * npops];
+    bool const first = ss->recorded == 0;
+
+    bool unchanged = true;
+    bool extinct = true;
+    for (u16 pop = 0; pop < npops; ++pop) {
+        unchanged = unchanged && previous[pop] == wld->pop_tally[pop];
+        extinct = extinct && wld->pop_tally[pop] == 0;
+    }
+    ss->deterministic_steps = first || wld->movers > 0 ? 0 : ss->deterministic_steps + 1;
+    ss->unchanged_steps = first || !unchanged ? 0 : ss->unchanged_steps + 1;
+    memcpy(tally, wld->pop_tally, (sizeof *tally) * npops);
+    ss->hashes[step % ss->history_size] = wld->hash;
+    ss->recorded = MIN(ss->recorded + 1, ss->history_size);
+    ss->step = step;
+
+    if (ss->params.extinction && extinct) {
+        ss->reason = STEADY_STATE_EXTINCTION;
+        ss->period = 1;
+        ss->exact = true;
+        return true;
+    }
+    if (ss->params.repetition_window > 0) {
+        for (u32 period = 1; period < ss->recorded; ++period) {
+            if (ss->hashes[(step - period) % ss->history_size] == wld->hash &&
+                memcmp(steady_state_tally(ss, step - period), tally, (sizeof *tally) * npops) == 0) {
+                ss->reason = STEADY_STATE_REPETITION;
+                ss->period = period;
+                ss->exact = ss->deterministic_steps >= period;
+                return true;
+            }
+        }
+    }
+    if (ss->params.unchanged_tally_steps > 0 && ss->unchanged_steps >= ss->params.unchanged_tally_steps) {
+        ss->reason = STEADY_STATE_UNCHANGED_TALLIES;
+        ss->period = 0;
+        ss->exact = false;
+        return true;
+    }
+    return false;
+}
+
+// Describe the detected steady state to stream, as a sentence.
+void steady_state_print(steady_state const* ss, FILE* stream) {
+    switch (ss->reason) {
+    case STEADY_STATE_NONE:
+        fprintf(stream, "No steady state.");
+        break;
+    case STEADY_STATE_EXTINCTION:
+        fprintf(stream, "Every population is extinct at time %u.", ss->step);
+        break;
+    case STEADY_STATE_REPETITION:
+        fprintf(stream, "The world's state at time %u repeats the one at time %u%s.", ss->step, ss->step - ss->period,
+                ss->exact ? ", without random draws in between, so it repeats forever" : "");
+        break;
+    case STEADY_STATE_UNCHANGED_TALLIES:
+        fprintf(stream, "Population sizes haven't changed for %u steps, at time %u.", ss->unchanged_steps, ss->step);
+        break;
+    }
+}
+
+
+
+/**** Recording history ****/
+
+// A recorder writes the world's state after every step to a history file, for studying spatial patterns afterwards.
+// (Raw maps would take sizeof(organism) bytes per cell and population, per step.) It records which cells each
+// population occupies, as a bitplane: a bit per cell, with each row padded to whole bytes. Each frame holds the
+// bitplanes XORed with those of the frame before, which are mostly zeros, in a run-length code. Every
+// keyframe_interval frames, a keyframe holds the bitplanes themselves, so that any frame can be decoded from the
+// keyframe before it, rather than from the start; see history_seek(). The file is written by an async_writer's thread,
+// which waits rather than drop anything.
+//
+// A history file, with integers in little-endian order:
+//  - A header: HISTORY_MAGIC; u16 width, height, population_count, 0; u32 keyframe_interval; and, for each population,
+//    u32 color, u16 length of its name, and the name.
+//  - The frames, each: u32 step; u32 flags (HISTORY_KEYFRAME); u32 size of the payload; u32 tally of each population;
+//    and the payload: the bitplanes of each population in turn, in the run-length code.
+//  - An index of the keyframes, for random access: for each, u64 step and u64 offset of its frame in the file.
+//  - A footer: u64 offset of the index; u64 number of keyframes; HISTORY_INDEX_MAGIC.
+// The run-length code is pairs of a run of zero bytes, and a run of literal bytes, each given as its length in a
+// varint (7 bits per byte, least significant first, with the top bit set on every byte but the last), with the
+// literal bytes after the second.
+
+#define HISTORY_MAGIC "ECOHIST1"
+#define HISTORY_INDEX_MAGIC "ECOHIDX1"
+#define HISTORY_MAGIC_LEN 8
+#define HISTORY_KEYFRAME 0x1
+#define HISTORY_FRAME_HEADER 12  // Bytes in a frame before its tallies.
+#define HISTORY_FOOTER (16 + HISTORY_MAGIC_LEN)
+#define HISTORY_INDEX_ENTRY 16
+#define HISTORY_DEFAULT_KEYFRAME_INTERVAL 100
+#define HISTORY_RING_BYTES (8 << 20)
+
+void history_set_u32(u8* p, u32 value) {
+    for (u32 i = 0; i < sizeof value; ++i) {
+        p[i] = (u8)(value >> (8 * i));
+    }
+}
+
+bool history_put_u16(buffer* buf, u16 value) {
+    char const bytes[2] = { (char)(value & 0xFF), (char)(value >> 8) };
+    return buffer_append(buf, bytes, sizeof bytes);
+}
+
+bool history_put_u32(buffer* buf, u32 value) {
+    return history_put_u16(buf, (u16)(value & 0xFFFF)) && history_put_u16(buf, (u16)(value >> 16));
+}
+
+bool history_put_u64(buffer* buf, u64 value) {
+    return history_put_u32(buf, (u32)(value & 0xFFFFFFFF)) && history_put_u32(buf, (u32)(value >> 32));
+}
+
+bool history_put_varint(buffer* buf, u64 value) {
+    char bytes[10];
+    size_t len = 0;
+    do {
+        bytes[len++] = (char)((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+        value >>= 7;
+    } while (value > 0);
+    return buffer_append(buf, bytes, len);
+}
+
+u16 history_get_u16(u8 const* p) {
+    return (u16)(p[0] | (p[1] << 8));
+}
+
+u32 history_get_u32(u8 const* p) {
+    return history_get_u16(p) | ((u32)history_get_u16(p + 2) << 16);
+}
+
+u64 history_get_u64(u8 const* p) {
+    return history_get_u32(p) | ((u64)history_get_u32(p + 4) << 32);
+}
+
+// Decode a varint at *p, which mustn't go past end, and advance *p past it.
+// Return: true on success; false if it's malformed.
+bool history_get_varint(u8 const** p, u8 const* end, u64* value) {
+    *value = 0;
+    for (u32 shift = 0; *p < end && shift < 64; shift += 7) {
+        u8 const byte = *(*p)++;
+        *value |= (u64)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct recorder {
+    FILE* file;
+    async_writer out;
+    u16 population_count;
+    u16 h;
+    u32 row_bytes;  // Bytes in a row of a bitplane.
+    size_t planes_size;  // Bytes in the bitplanes of every population.
+    u8* planes;  // The bitplanes of every population, [population_count][h][row_bytes], as of the last frame.
+    u8* previous;  // The bitplanes as of the frame before.
+    u32 keyframe_interval;
+    u64 frames;
+    u32 step;  // The step of the last frame.
+    u64 offset;  // Bytes written to the file so far.
+    buffer frame;  // The frame being encoded.
+    buffer index;  // The index of keyframes so far.
+} recorder;
+
+// Start recording the history of wld, from its current state, to filename, with a keyframe every keyframe_interval
+// frames.
+// Return: true on success; false on failure.
+// Notes: If this call is successful, then the caller is responsible for calling recorder_close(rec).
+bool recorder_open(recorder* rec, world const* wld, char const* filename, u32 keyframe_interval) {
+    u16 const npops = wld->params.population_count;
+    *rec = (recorder){
+        .population_count = npops,
+        .h = wld->h,
+        .row_bytes = (u32)(wld->w + 7) / 8,
+        .keyframe_interval = MAX(keyframe_interval, 1),
+    };
+    rec->planes_size = (size_t)rec->row_bytes * wld->h * npops;
+    rec->planes = calloc(rec->planes_size, 1);
+    rec->previous = calloc(rec->planes_size, 1);
+    if (!rec->planes || !rec->previous) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory for recording.\n");
+        free(rec->planes);
+        free(rec->previous);
+        return false;
+    }
+    if (!(rec->file = fopen(filename, "wb"))) {
+        fprintf(stderr, "[ERROR] Cannot record to %s: %s\n", filename, strerror(errno));
+        free(rec->planes);
+        free(rec->previous);
+        return false;
+    }
+    if (!async_writer_open(&rec->out, rec->file, HISTORY_RING_BYTES, ASYNC_WRITER_BLOCK, NULL)) {
+        fclose(rec->file);
+        free(rec->planes);
+        free(rec->previous);
+        return false;
+    }
+
+    buffer header = {0};
+    bool ok = buffer_append(&header, HISTORY_MAGIC, HISTORY_MAGIC_LEN) && history_put_u16(&header, wld->w) &&
+        history_put_u16(&header, wld->h) && history_put_u16(&header, npops) && history_put_u16(&header, 0) &&
+        history_put_u32(&header, rec->keyframe_interval);
+    for (u16 pop = 0; ok && pop < npops; ++pop) {
+        population_params const* p = &wld->params.populations[pop];
+        ok = history_put_u32(&header, p->color) && history_put_u16(&header, clamp_size_t_u16(p->name.len)) &&
+            buffer_append(&header, p->name.p, clamp_size_t_u16(p->name.len));
+    }
+    if (ok) {
+        async_writer_write(&rec->out, header.p, header.len);
+        rec->offset = header.len;
+    }
+    buffer_destroy(&header);
+    return ok;
+}
+
+// Update the bitplanes from the cells of wld in columns [x_begin, x_end) of row y.
+void recorder_scan(recorder* rec, world const* wld, u16 y, u16 x_begin, u16 x_end) {
+    for (u16 x = x_begin; x < x_end; ++x) {
+        organism const* org = world_map_idx(wld, x, y, 0);
+        u8 const bit = (u8)(1u << (x % 8));
+        u8* byte = &rec->planes[(size_t)y * rec->row_bytes + x / 8];
+        for (u16 pop = 0; pop < rec->population_count; ++pop, byte += (size_t)rec->h * rec->row_bytes) {
+            *byte = org[pop].exists ? (u8)(*byte | bit) : (u8)(*byte & ~bit);
+        }
+    }
+}
+
+// Append data, of len bytes, to the frame in the run-length code, XORed with mask unless it's NULL.
+bool recorder_encode(buffer* frame, u8 const* data, u8 const* mask, size_t len) {
+    bool ok = true;
+    for (size_t i = 0; ok && i < len; ) {
+        size_t const zeros_begin = i;
+        while (i < len && (data[i] ^ (mask ? mask[i] : 0)) == 0) {
+            ++i;
+        }
+        size_t const literals_begin = i;
+        while (i < len && (data[i] ^ (mask ? mask[i] : 0)) != 0) {
+            ++i;
+        }
+        ok = history_put_varint(frame, literals_begin - zeros_begin) && history_put_varint(frame, i - literals_begin) &&
+            buffer_reserve(frame, i - literals_begin);
+        for (size_t j = literals_begin; ok && j < i; ++j) {
+            frame->p[frame->len++] = (char)(data[j] ^ (mask ? mask[j] : 0));
+        }
+    }
+    return ok;
+}
+
+// Record wld's current state as the next frame.
+// Return: true on success; false on failure.
+bool recorder_add(recorder* rec, world const* wld) {
+    // After a step, only the tiles that are awake can have changed in it; see evolve_update_tiles(). If steps were
+    // taken since the last frame, or this is the first, then every cell is looked at.
+    bool const incremental = rec->frames > 0 && wld->step == rec->step + 1;
+    for (u16 y = 0; y < wld->h; ++y) {
+        u16 x_begin = 0, x_end = wld->w;
+        if (!incremental) {
+            recorder_scan(rec, wld, y, x_begin, x_end);
+            continue;
+        }
+        for (u16 tile_x = 0; evolve_next_tile_run(wld, y / TILE_SIZE, TILE_AWAKE, &tile_x, &x_begin, &x_end); ) {
+            recorder_scan(rec, wld, y, x_begin, x_end);
+        }
+    }
+
+    bool const keyframe = rec->frames % rec->keyframe_interval == 0;
+    size_t const tallies_end = HISTORY_FRAME_HEADER + sizeof(u32) * rec->population_count;
+    rec->frame.len = 0;
+    bool ok = history_put_u32(&rec->frame, wld->step) &&
+        history_put_u32(&rec->frame, keyframe ? HISTORY_KEYFRAME : 0) && history_put_u32(&rec->frame, 0);
+    for (u16 pop = 0; ok && pop < rec->population_count; ++pop) {
+        ok = history_put_u32(&rec->frame, wld->pop_tally[pop]);
+    }
+    ok = ok && recorder_encode(&rec->frame, rec->planes, keyframe ? NULL : rec->previous, rec->planes_size);
+    if (ok && keyframe) {
+        ok = history_put_u64(&rec->index, wld->step) && history_put_u64(&rec->index, rec->offset);
+    }
+    if (!ok) {
+        return false;
+    }
+    history_set_u32((u8*)rec->frame.p + 8, (u32)(rec->frame.len - tallies_end));  // The payload's size, now it's known.
+
+    async_writer_write(&rec->out, rec->frame.p, rec->frame.len);
+    rec->offset += rec->frame.len;
+    memcpy(rec->previous, rec->planes, rec->planes_size);
+    rec->step = wld->step;
+    ++rec->frames;
+    return true;
+}
+
+// Write the index of keyframes, and wait for the whole history to be written.
+// Return: true if the whole history was written; false otherwise.
+bool recorder_close(recorder* rec) {
+    buffer footer = {0};
+    bool ok = history_put_u64(&footer, rec->offset) && history_put_u64(&footer, rec->index.len / HISTORY_INDEX_ENTRY) &&
+        buffer_append(&footer, HISTORY_INDEX_MAGIC, HISTORY_MAGIC_LEN);
+    if (ok) {
+        async_writer_write(&rec->out, rec->index.p, rec->index.len);
+        async_writer_write(&rec->out, footer.p, footer.len);
+    }
+    ok = async_writer_close(&rec->out) && ok;
+    ok = fclose(rec->file) == 0 && ok;
+    buffer_destroy(&footer);
+    buffer_destroy(&rec->frame);
+    buffer_destroy(&rec->index);
+    free(rec->planes);
+    free(rec->previous);
+    *rec = (recorder){0};
+    return ok;
+}
+
+
+// Reading a history file, from memory.
+
+typedef struct history_population {
+    u32 color;
+    u16 name_len;
+    char const* name;  // Not null-terminated.
+} history_population;
+
+typedef struct history {
+    u8 const* data;
+    size_t size;
+    u16 w;
+    u16 h;
+    u16 population_count;
+    u32 keyframe_interval;
+    u32 row_bytes;  // Bytes in a row of a bitplane.
+    size_t planes_size;  // Bytes in the bitplanes of every population, as for recorder.
+    history_population* populations;
+    size_t frames_offset;  // Where the first frame is.
+    size_t frames_end;  // Where the last frame ends.
+    u8 const* index;  // The index of keyframes; see recorder.
+    u64 keyframes;
+    u8* own_index;  // If the file has no index (e.g., the run was stopped), then the index rebuilt by history_open().
+} history;
+
+// Where each frame is.
+typedef struct history_cursor {
+    size_t offset;  // The frame after the current one.
+    u32 step;  // The current frame's step.
+    u8 const* tallies;  // The current frame's tallies, as u32s; see history_tally().
+} history_cursor;
+
+// The frame at offset: its step, flags, payload and next frame.
+typedef struct history_frame {
+    u32 step;
+    u32 flags;
+    u8 const* tallies;
+    u8 const* payload;
+    size_t payload_size;
+    size_t next;
+} history_frame;
+
+// Read the header of the frame at offset.
+// Return: true on success; false if there's no whole frame there.
+bool history_frame_at(history const* hs, size_t offset, history_frame* frame) {
+    size_t const tallies_size = sizeof(u32) * hs->population_count;
+    if (offset > hs->frames_end || hs->frames_end - offset < HISTORY_FRAME_HEADER + tallies_size) {
+        return false;
+    }
+    u8 const* const p = hs->data + offset;
+    *frame = (history_frame){
+        .step = history_get_u32(p),
+        .flags = history_get_u32(p + 4),
+        .payload_size = history_get_u32(p + 8),
+        .tallies = p + HISTORY_FRAME_HEADER,
+        .payload = p + HISTORY_FRAME_HEADER + tallies_size,
+    };
+    if (hs->frames_end - offset - HISTORY_FRAME_HEADER - tallies_size < frame->payload_size) {
+        return false;
+    }
+    frame->next = offset + HISTORY_FRAME_HEADER + tallies_size + frame->payload_size;
+    return true;
+}
+
+void history_close(history* hs) {
+    free(hs->populations);
+    free(hs->own_index);
+    *hs = (history){0};
+}
+
+// Open the history file of size bytes at data, which must remain valid until history_close(hs).
+// Return: true on success; false if it isn't a history file.
+bool history_open(history* hs, u8 const* data, size_t size) {
+    *hs = (history){ .data = data, .size = size };
+    size_t const fixed = HISTORY_MAGIC_LEN + 4 * sizeof(u16) + sizeof(u32);
+    if (size < fixed || memcmp(data, HISTORY_MAGIC, HISTORY_MAGIC_LEN) != 0) {
+        fprintf(stderr, "[ERROR] Not a history file.\n");
+        return false;
+    }
+    hs->w = history_get_u16(data + HISTORY_MAGIC_LEN);
+    hs->h = history_get_u16(data + HISTORY_MAGIC_LEN + 2);
+    hs->population_count = history_get_u16(data + HISTORY_MAGIC_LEN + 4);
+    hs->keyframe_interval = history_get_u32(data + HISTORY_MAGIC_LEN + 8);
+    hs->row_bytes = (u32)(hs->w + 7) / 8;
+    hs->planes_size = (size_t)hs->row_bytes * hs->h * hs->population_count;
+    hs->populations = calloc(MAX(hs->population_count, 1), sizeof *hs->populations);
+    size_t offset = fixed;
+    for (u16 pop = 0; hs->populations && pop < hs->population_count; ++pop) {
+        if (size - offset < sizeof(u32) + sizeof(u16)) {
+            offset = size + 1;
+            break;
+        }
+        history_population* p = &hs->populations[pop];
+        p->color = history_get_u32(data + offset);
+        p->name_len = history_get_u16(data + offset + 4);
+        p->name = (char const*)data + offset + 6;
+        offset += 6 + (size_t)p->name_len;
+        if (offset > size) {
+            break;
+        }
+    }
+    if (!hs->populations || offset > size) {
+        fprintf(stderr, "[ERROR] The history file's header is incomplete.\n");
+        history_close(hs);
+        return false;
+    }
+    hs->frames_offset = offset;
+
+    // The index, if the footer is there, and consistent.
+    if (size - offset >= HISTORY_FOOTER &&
+        memcmp(data + size - HISTORY_MAGIC_LEN, HISTORY_INDEX_MAGIC, HISTORY_MAGIC_LEN) == 0) {
+        u64 const index_offset = history_get_u64(data + size - HISTORY_FOOTER);
+        u64 const keyframes = history_get_u64(data + size - HISTORY_FOOTER + 8);
+        if (index_offset >= offset && index_offset <= size - HISTORY_FOOTER &&
+            (size - HISTORY_FOOTER - index_offset) / HISTORY_INDEX_ENTRY == keyframes &&
+            (size - HISTORY_FOOTER - index_offset) % HISTORY_INDEX_ENTRY == 0) {
+            hs->frames_end = (size_t)index_offset;
+            hs->index = data + index_offset;
+            hs->keyframes = keyframes;
+            return true;
+        }
+    }
+
+    // Otherwise, rebuild the index from the frames, up to the last whole one.
+    fprintf(stderr, "[WARNING] The history file has no index (the recording may have been stopped early); rebuilding "
+            "it.\n");
+    hs->frames_end = size;
+    buffer index = {0};
+    history_frame frame;
+    size_t end = offset;
+    for (size_t at = offset; history_frame_at(hs, at, &frame); at = frame.next) {
+        if ((frame.flags & HISTORY_KEYFRAME) &&
+            !(history_put_u64(&index, frame.step) && history_put_u64(&index, at))) {
+            break;
+        }
+        end = frame.next;
+    }
+    hs->frames_end = end;
+    hs->own_index = (u8*)index.p;
+    hs->index = hs->own_index;
+    hs->keyframes = index.len / HISTORY_INDEX_ENTRY;
+    return true;
+}
+
+// Apply the payload of a frame to planes: Replace them, for a keyframe, or XOR them, otherwise.
+// Return: true on success; false if the payload is malformed.
+bool history_apply(history const* hs, history_frame const* frame, u8 planes[]) {
+    u8 const* p = frame->payload;
+    u8 const* const end = p + frame->payload_size;
+    bool const keyframe = frame->flags & HISTORY_KEYFRAME;
+    size_t i = 0;
+    while (p < end) {
+        u64 zeros, literals;
+        if (!history_get_varint(&p, end, &zeros) || !history_get_varint(&p, end, &literals) ||
+            zeros > hs->planes_size - i || literals > hs->planes_size - i - zeros || literals > (u64)(end - p)) {
+            return false;
+        }
+        if (keyframe) {
+            memset(planes + i, 0, (size_t)zeros);
+        }
+        i += (size_t)zeros;
+        for (u64 j = 0; j < literals; ++j, ++i) {
+            planes[i] = keyframe ? *p++ : (u8)(planes[i] ^ *p++);
+        }
+    }
+    return i == hs->planes_size;
+}
+
+// Decode the last frame at or before step into planes (of hs->planes_size bytes), starting from the keyframe before
+// it, and point cur at it.
+// Return: true on success; false if there's no such frame, or the file is malformed.
+bool history_seek(history const* hs, u32 step, history_cursor* cur, u8 planes[]) {
+    // The last keyframe at or before step.
+    u64 lo = 0, hi = hs->keyframes;
+    while (lo < hi) {
+        u64 const mid = lo + (hi - lo) / 2;
+        if (history_get_u64(hs->index + mid * HISTORY_INDEX_ENTRY) <= step) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return false;
+    }
+    size_t offset = (size_t)history_get_u64(hs->index + (lo - 1) * HISTORY_INDEX_ENTRY + 8);
+    history_frame frame;
+    if (!history_frame_at(hs, offset, &frame) || !history_apply(hs, &frame, planes)) {
+        return false;
+    }
+    *cur = (history_cursor){ .offset = frame.next, .step = frame.step, .tallies = frame.tallies };
+    history_frame next;
+    while (history_frame_at(hs, cur->offset, &next) && next.step <= step) {
+        if (!history_apply(hs, &next, planes)) {
+            return false;
+        }
+        *cur = (history_cursor){ .offset = next.next, .step = next.step, .tallies = next.tallies };
+    }
+    return true;
+}
+
+// The step of the first frame, if there are any frames.
+u32 history_first_step(history const* hs) {
+    return hs->keyframes > 0 ? (u32)history_get_u64(hs->index) : 0;
+}
+
+// Decode the frame after cur's into planes, which hold cur's, and advance cur to it.
+// Return: true on success; false at the end of the history, or if the file is malformed.
+bool history_next(history const* hs, history_cursor* cur, u8 planes[]) {
+    history_frame frame;
+    if (!history_frame_at(hs, cur->offset, &frame) || !history_apply(hs, &frame, planes)) {
+        return false;
+    }
+    *cur = (history_cursor){ .offset = frame.next, .step = frame.step, .tallies = frame.tallies };
+    return true;
+}
+
+// The tally of population pop in cur's frame.
+u32 history_tally(history const* hs, history_cursor const* cur, u16 pop) {
+    (void)hs;
+    return history_get_u32(cur->tallies + sizeof(u32) * pop);
+}
+
+// Whether population pop occupies cell (x, y) in planes.
+bool history_occupied(history const* hs, u8 const planes[], u16 pop, u16 x, u16 y) {
+    return (planes[((size_t)pop * hs->h + y) * hs->row_bytes + x / 8] >> (x % 8)) & 1;
+}
+
+
+
+/**** Telemetry ****/
+
+// A telemetry segment publishes a run, as it goes, in shared memory (see shared_memory), for any number of monitors
+// on this machine (e.g., scripts/monitor.py) to attach to, and detach from, at any time, without holding it up: The
+// simulation never waits for them, nor knows they're there. It holds, at fixed offsets (see telemetry_header):
+//  - The layout, and each population's color and name, which don't change.
+//  - The state of the run (step, params hash, status), under a seqlock: The writer makes seq odd, writes the state,
+//    then makes seq even again. A reader copies the state between two loads of seq, and retries unless they're equal
+//    and even.
+//  - A ring of the last ring_capacity records (one per step: its step, the time, and the population tallies). Record
+//    i is at (i % ring_capacity), and is valid only while its stamp is i + 1: The writer zeroes the stamp, writes the
+//    record, then stamps it. A reader copies a record between two loads of its stamp; if either isn't i + 1, then the
+//    record was overwritten, and the reader has fallen behind.
+//  - Optionally, every image_interval steps, an image of the world, shrunk to image_w x image_h, with a byte for each
+//    population and pixel: how densely it occupies the cells there (0 to 255), as [population][y][x]. It has its own
+//    seqlock, image_seq.
+// Integers are in this machine's byte order.
+
+#define TELEMETRY_MAGIC "ECOTELE1"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_DEFAULT_RING_RECORDS 4096
+#define TELEMETRY_NAME_BYTES 60  // For each population's name, padded with zeros. (With its color, 64 bytes.)
+
+typedef enum telemetry_status {
+    TELEMETRY_RUNNING = 1,
+    TELEMETRY_FINISHED = 2,
+} telemetry_status;
+
+typedef struct telemetry_header {
+    // The layout, which doesn't change.
+    char magic[8];  // TELEMETRY_MAGIC.
+    u32 version;  // TELEMETRY_VERSION.
+    u32 population_count;
+    u32 w;
+    u32 h;
+    u32 num_steps;  // 0 if the run goes on forever.
+    u32 ring_capacity;  // Records in the ring.
+    u32 record_size;  // Bytes per record: u64 stamp, u64 step, i64 time in nanoseconds, u32 tally per population.
+    u32 image_w;  // 0 if there's no image.
+    u32 image_h;
+    u32 image_interval;
+    u32 pid;  // The simulation's process; see shared_memory_create().
+    u64 populations_offset;  // For each population: u32 color, and its name in TELEMETRY_NAME_BYTES bytes.
+    u64 ring_offset;
+    u64 image_offset;
+    u64 reserved[6];
+    // The state of the run, under seq, on a cache line of its own.
+    atomic_u64 seq;
+    u64 step;  // The step that the world is at.
+    u64 records;  // Records written, ever. The last is records - 1.
+    u64 params_hash;  // Changes when the population parameters are reloaded; see simulation_params_hash().
+    u64 status;  // telemetry_status.
+    u64 reserved_state[3];
+    // The image's step, under image_seq.
+    atomic_u64 image_seq;
+    u64 image_step;
+} telemetry_header;
+
+typedef struct telemetry {
+    shared_memory shm;
+    telemetry_header* header;
+    u8* ring;
+    u8* image;
+    u16 population_count;
+    u32 shrink;  // Cells per pixel of the image, in each direction.
+    bool imaged;  // Whether an image has been published, as of image_step.
+    u32 image_step;
+} telemetry;
+
+// A hash of the population parameters, which changes when they're reloaded.
+u64 simulation_params_hash(simulation_params const* params) {
+    u64 hash = params->population_count;
+    for (u16 pop = 0; pop < params->population_count; ++pop) {
+        population_params const* p = &params->populations[pop];
+        u64 const fields[] = { p->color, p->motile, p->trophic_level, p->initial_population_size, p->energy_at_birth,
+            p->energy_maximum, p->energy_threshold_replicate, p->energy_cost_replicate, p->energy_gain,
+            p->energy_cost_move, p->replication_space_needed, p->neighborhood, p->neighborhood_radius };
+        for (size_t i = 0; i < sizeof fields / sizeof *fields; ++i) {
+            hash = rand_counter(hash, fields[i]);
+        }
+    }
+    return hash;
+}
+
+// Publish the state of the run, under the seqlock.
+void telemetry_set_state(telemetry* tm, u64 step, u64 params_hash, telemetry_status status) {
+    telemetry_header* const h = tm->header;
+    u64 const seq = atomic_u64_load(&h->seq);
+    atomic_u64_store(&h->seq, seq + 1);
+    atomic_fence();
+    h->step = step;
+    h->params_hash = params_hash;
+    h->status = status;
+    atomic_u64_store(&h->seq, seq + 2);
+}
+
+// Create the shared memory segment called name, to publish wld's run, with a ring of ring_records records and, if
+// image_width isn't 0, an image at most that wide, every image_interval steps.
+// Return: true on success; false on failure.
+// Notes: If this call is successful, then the caller is responsible for calling telemetry_close(tm).
+bool telemetry_open(telemetry* tm, world const* wld, char const* name, u32 ring_records, u32 image_width,
+                    u32 image_interval) {
+    u16 const npops = wld->params.population_count;
+    *tm = (telemetry){ .population_count = npops };
+    u32 const record_size = (u32)(3 * sizeof(u64) + ((sizeof(u32) * npops + 7) & ~(size_t)7));
+    u32 image_w = 0, image_h = 0;
+    if (image_width > 0 && image_interval > 0) {
+        tm->shrink = (MIN(image_width, wld->w) + wld->w - 1) / MIN(image_width, wld->w);
+        image_w = (wld->w + tm->shrink - 1) / tm->shrink;
+        image_h = (wld->h + tm->shrink - 1) / tm->shrink;
+    }
+    size_t const populations_offset = sizeof(telemetry_header);
+    size_t const ring_offset = populations_offset + (sizeof(u32) + TELEMETRY_NAME_BYTES) * npops;
+    size_t const image_offset = ring_offset + (size_t)record_size * ring_records;
+    size_t const size = image_offset + (size_t)image_w * image_h * npops;
+    if (!shared_memory_create(&tm->shm, name, size, offsetof(telemetry_header, pid))) {
+        return false;
+    }
+    u8* const base = tm->shm.p;
+    tm->header = (telemetry_header*)base;
+    tm->ring = base + ring_offset;
+    tm->image = image_w > 0 ? base + image_offset : NULL;
+    for (u16 pop = 0; pop < npops; ++pop) {
+        population_params const* p = &wld->params.populations[pop];
+        u8* const entry = base + populations_offset + (sizeof(u32) + TELEMETRY_NAME_BYTES) * pop;
+        memcpy(entry, &p->color, sizeof(u32));
+        memcpy(entry + sizeof(u32), p->name.p, MIN(p->name.len, TELEMETRY_NAME_BYTES - 1));
+    }
+    telemetry_header* const h = tm->header;
+    h->version = TELEMETRY_VERSION;
+    h->population_count = npops;
+    h->w = wld->w;
+    h->h = wld->h;
+    h->num_steps = wld->params.run_forever ? 0 : wld->params.num_steps;
+    h->ring_capacity = ring_records;
+    h->record_size = record_size;
+    h->image_w = image_w;
+    h->image_h = image_h;
+    h->image_interval = image_w > 0 ? image_interval : 0;
+    h->populations_offset = populations_offset;
+    h->ring_offset = ring_offset;
+    h->image_offset = image_w > 0 ? image_offset : 0;
+    telemetry_set_state(tm, wld->step, simulation_params_hash(&wld->params), TELEMETRY_RUNNING);
+    // Last, so that a monitor that sees the magic sees the rest of the layout.
+    atomic_fence();
+    memcpy(h->magic, TELEMETRY_MAGIC, sizeof h->magic);
+    return true;
+}
+
+// Publish the tallies after step, and that the world is at wld's step. (Steps taken several at a time are each
+// published, with their own tallies, before the world's step moves past them.)
+void telemetry_publish(telemetry* tm, world const* wld, u32 step, u32 const tally[]) {
+    telemetry_header* const h = tm->header;
+    u64 const i = h->records;
+    u8* const record = tm->ring + (size_t)(i % h->ring_capacity) * h->record_size;
+    atomic_u64* const stamp = (atomic_u64*)record;
+    atomic_u64_store(stamp, 0);
+    atomic_fence();
+    u64 const record_step = step;
+    i64 const time = time_now_ns();
+    memcpy(record + sizeof(u64), &record_step, sizeof record_step);
+    memcpy(record + 2 * sizeof(u64), &time, sizeof time);
+    memcpy(record + 3 * sizeof(u64), tally, sizeof(u32) * tm->population_count);
+    atomic_u64_store(stamp, i + 1);
+
+    u64 const seq = atomic_u64_load(&h->seq);
+    atomic_u64_store(&h->seq, seq + 1);
+    atomic_fence();
+    h->records = i + 1;
+    h->step = wld->step;
+    h->params_hash = simulation_params_hash(&wld->params);
+    atomic_u64_store(&h->seq, seq + 2);
+}
+
+// Whether an image of wld is due, at its current step. (Steps may be taken several at a time, so it's due once
+// image_interval steps have been taken since the last, rather than at multiples of image_interval.)
+bool telemetry_image_due(telemetry const* tm, world const* wld) {
+    return tm->image && (!tm->imaged || wld->step - tm->image_step >= tm->header->image_interval);
+}
+
+// Publish an image of wld, as it is.
+void telemetry_publish_image(telemetry* tm, world const* wld) {
+    telemetry_header* const h = tm->header;
+    u32 const image_w = h->image_w, image_h = h->image_h;
+    u64 const seq = atomic_u64_load(&h->image_seq);
+    atomic_u64_store(&h->image_seq, seq + 1);
+    atomic_fence();
+    for (u32 iy = 0; iy < image_h; ++iy) {
+        u32 const y_begin = iy * tm->shrink, y_end = MIN(y_begin + tm->shrink, (u32)wld->h);
+        for (u32 ix = 0; ix < image_w; ++ix) {
+            u32 const x_begin = ix * tm->shrink, x_end = MIN(x_begin + tm->shrink, (u32)wld->w);
+            u32 const cells = (y_end - y_begin) * (x_end - x_begin);
+            for (u16 pop = 0; pop < tm->population_count; ++pop) {
+                u32 count = 0;
+                for (u32 y = y_begin; y < y_end; ++y) {
+                    for (u32 x = x_begin; x < x_end; ++x) {
+                        count += world_map_idx(wld, (u16)x, (u16)y, pop)->exists;
+                    }
+                }
+                tm->image[((size_t)pop * image_h + iy) * image_w + ix] = (u8)((u64)count * 255 / cells);
+            }
+        }
+    }
+    h->image_step = wld->step;
+    atomic_u64_store(&h->image_seq, seq + 2);
+    tm->imaged = true;
+    tm->image_step = wld->step;
+}
+
+// Publish that the run has finished, and remove the segment. Monitors that are attached keep what they have.
+void telemetry_close(telemetry* tm) {
+    telemetry_header const* const h = tm->header;
+    telemetry_set_state(tm, h->step, h->params_hash, TELEMETRY_FINISHED);
+    shared_memory_destroy(&tm->shm);
+    *tm = (telemetry){0};
+}
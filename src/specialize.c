@@ -0,0 +1,405 @@
+#include "simulation.c"
+
+// Generate a C translation unit containing evolve_specialized(), an evolve() kernel specialized for one configuration
+// file: population loops are unrolled, population parameters are folded into constants, and branches that cannot be
+// taken for this configuration are omitted. The generated kernel must make exactly the same state changes, and the
+// same random draws, as evolve() -- so that results are bit-for-bit equal.
+//
+// The generated file is meant to be compiled into ecosystem.c with -DEVOLVE_SPECIALIZED (see the Makefile).
+
+
+// Can a population ever choose a target other than its own cell?
+// Sessile organisms only do so when ready to replicate. An organism's energy at the start of the first pass is at most
+// max(energy_maximum, energy_at_birth), since it is capped at the end of every step (newborns are born with
+// energy_at_birth, and are capped at the end of the same step).
+bool population_can_target(population_params const* p) {
+    if (p->motile) {
+        return true;
+    }
+    u32 const energy_bound = (u32)MAX(p->energy_maximum, p->energy_at_birth) + p->energy_gain;
+    if (energy_bound > 0xFFFF) {
+        // Energy may wrap around; make no assumptions.
+        return true;
+    }
+    return p->energy_threshold_replicate <= energy_bound;
+}
+
+bool is_prey(population_params const* predator, population_params const* prey) {
+    return predator->trophic_level != 0 && predator->trophic_level - 1 == prey->trophic_level;
+}
+
+// Whether the kernel resolves contention by scattering, as evolve() does unless a cell's neighbors aren't distinct.
+bool resolves_by_scattering(simulation_params const* sp) {
+    return sp->w >= 3 && sp->h >= 3;
+}
+
+void emit_header(FILE* out, char const* config_filename, simulation_params const* sp) {
+    fprintf(out, "// Generated by specialize from %s. Do not edit.\n", config_filename);
+    fprintf(out, "//\n");
+    fprintf(out, "// evolve_specialized() is equivalent to evolve() for a %ux%u world with these populations:\n",
+            sp->w, sp->h);
+    for (u16 pop = 0; pop < sp->population_count; ++pop) {
+        fprintf(out, "//     %u: \"", pop);
+        buffer_printf(sp->populations[pop].name, out);
+        fprintf(out, "\"\n");
+    }
+    fprintf(out, "\n");
+}
+
+void emit_applies(FILE* out, simulation_params const* sp) {
+    fprintf(out, "// Return true if evolve_specialized() may be used in place of evolve() for the given parameters.\n");
+    fprintf(out, "bool evolve_specialized_applies(simulation_params const* params) {\n");
+    fprintf(out, "    if (params->w != %u || params->h != %u || params->population_count != %u) {\n",
+            sp->w, sp->h, sp->population_count);
+    fprintf(out, "        return false;\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    population_params const*const p = params->populations;\n");
+    fprintf(out, "    return true");
+    for (u16 pop = 0; pop < sp->population_count; ++pop) {
+        population_params const* p = &sp->populations[pop];
+        fprintf(out, "\n        && p[%u].motile == %s", pop, p->motile ? "true" : "false");
+        fprintf(out, "\n        && p[%u].trophic_level == %u", pop, p->trophic_level);
+        fprintf(out, "\n        && p[%u].energy_at_birth == %u", pop, p->energy_at_birth);
+        fprintf(out, "\n        && p[%u].energy_maximum == %u", pop, p->energy_maximum);
+        fprintf(out, "\n        && p[%u].energy_threshold_replicate == %u", pop, p->energy_threshold_replicate);
+        fprintf(out, "\n        && p[%u].energy_cost_replicate == %u", pop, p->energy_cost_replicate);
+        fprintf(out, "\n        && p[%u].energy_gain == %u", pop, p->energy_gain);
+        fprintf(out, "\n        && p[%u].energy_cost_move == %u", pop, p->energy_cost_move);
+        fprintf(out, "\n        && p[%u].replication_space_needed == %u", pop, p->replication_space_needed);
+        // The kernel only implements the default neighborhood.
+        fprintf(out, "\n        && p[%u].neighborhood == NEIGHBORHOOD_MOORE", pop);
+        fprintf(out, "\n        && p[%u].neighborhood_radius == 1", pop);
+    }
+    fprintf(out, ";\n");
+    fprintf(out, "}\n\n");
+}
+
+// Emit the start of a loop over all cells. Inside the loop, the following are defined:
+//   x, y: Coordinates of the cell.
+//   xs, ys: Coordinates of the neighboring columns and rows, as in evolve().
+//   c: Map index of the cell's first population.
+//   n[8]: Map indices of the neighbors' first populations, in the order in which evolve() scans them.
+void emit_cell_loop_begin(FILE* out, simulation_params const* sp, bool neighbors) {
+    u16 const w = sp->w;
+    u16 const h = sp->h;
+    u16 const np = sp->population_count;
+    fprintf(out, "    for (u16 y = 0; y < %u; ++y) {\n", h);
+    if (neighbors) {
+        fprintf(out, "        u16 const ys[3] = { (u16)(y == 0 ? %u : y - 1), y, (u16)(y == %u ? 0 : y + 1) };\n",
+                h - 1, h - 1);
+    }
+    fprintf(out, "        for (u16 x = 0; x < %u; ++x) {\n", w);
+    fprintf(out, "            size_t const c = %uu * ((size_t)y * %uu + x);\n", np, w);
+    if (neighbors) {
+        fprintf(out, "            u16 const xs[3] = { (u16)(x == 0 ? %u : x - 1), x, (u16)(x == %u ? 0 : x + 1) };\n",
+                w - 1, w - 1);
+        fprintf(out, "            size_t const n[8] = {\n");
+        for (int i = 0; i < 3; ++i) {
+            fprintf(out, "                ");
+            for (int j = 0; j < 3; ++j) {
+                if (i == 1 && j == 1) continue;
+                fprintf(out, "%uu * ((size_t)ys[%d] * %uu + xs[%d]),%s", np, i, w, j, j == 2 ? "\n" : " ");
+            }
+        }
+        fprintf(out, "            };\n");
+    }
+}
+
+void emit_cell_loop_end(FILE* out) {
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n");
+}
+
+void emit_first_pass(FILE* out, simulation_params const* sp) {
+    bool any_can_target = false;
+    for (u16 pop = 0; pop < sp->population_count; ++pop) {
+        any_can_target |= population_can_target(&sp->populations[pop]);
+    }
+    fprintf(out, "    // First pass: Each organism decides which direction to move.\n");
+    emit_cell_loop_begin(out, sp, true);
+    if (any_can_target) {
+        // This is in the x loop, but only needs to be done once per row.
+        fprintf(out, "            if (x == 0) {\n");
+        fprintf(out, "                evolve_draw_directions(wld, key_first_pass, y, directions);\n");
+        fprintf(out, "            }\n");
+    }
+    for (u16 pop = 0; pop < sp->population_count; ++pop) {
+        population_params const* p = &sp->populations[pop];
+        bool const threshold_trivial = p->energy_threshold_replicate == 0;
+        bool const space_trivial = p->replication_space_needed == 0;
+        fprintf(out, "            {\n");
+        fprintf(out, "                organism* const org = &map[c + %u];\n", pop);
+        fprintf(out, "                org->existed = org->exists;\n");
+        fprintf(out, "                if (org->exists) {\n");
+        if (p->energy_gain) {
+            fprintf(out, "                    org->energy += %u;\n", p->energy_gain);
+        }
+        if (threshold_trivial && space_trivial) {
+            fprintf(out, "                    bool const org_can_replicate = true;\n");
+        } else if (space_trivial) {
+            fprintf(out, "                    bool const org_can_replicate = org->energy >= %u;\n",
+                    p->energy_threshold_replicate);
+        } else {
+            fprintf(out, "                    int const living_neighbors =\n");
+            for (int i = 0; i < 8; ++i) {
+                fprintf(out, "                        %s map[n[%d] + %u].exists%s\n",
+                        i ? "+" : " ", i, pop, i == 7 ? ";" : "");
+            }
+            if (threshold_trivial) {
+                fprintf(out, "                    bool const org_can_replicate = living_neighbors <= %u;\n",
+                        8 - p->replication_space_needed);
+            } else {
+                fprintf(out, "                    bool const org_can_replicate =\n");
+                fprintf(out, "                        org->energy >= %u && living_neighbors <= %u;\n",
+                        p->energy_threshold_replicate, 8 - p->replication_space_needed);
+            }
+        }
+        fprintf(out, "                    org->ready_to_replicate = org_can_replicate;\n");
+        if (!p->motile) {
+            fprintf(out, "                    if (org_can_replicate) {\n");
+        } else {
+            fprintf(out, "                    {\n");
+        }
+        fprintf(out, "                        u32 ru = directions[%uu * x + %u];\n", sp->population_count, pop);
+        fprintf(out, "                        if (ru >= 4)\n");
+        fprintf(out, "                            ++ru;\n");
+        fprintf(out, "                        org->target = (point){ .x = xs[ru / 3], .y = ys[ru %% 3] };\n");
+        if (resolves_by_scattering(sp)) {
+            fprintf(out, "                        map[%uu * ((size_t)org->target.y * %uu + org->target.x) + %u]"
+                    ".contenders |=\n", sp->population_count, sp->w, pop);
+            fprintf(out, "                            evolve_contender_bit(1 - (i32)(ru / 3), 1 - (i32)(ru %% 3));\n");
+        }
+        if (!p->motile) {
+            fprintf(out, "                    } else {\n");
+            fprintf(out, "                        org->target = (point){ .x = x, .y = y };\n");
+        }
+        fprintf(out, "                    }\n");
+        fprintf(out, "                }\n");
+        fprintf(out, "            }\n");
+    }
+    emit_cell_loop_end(out);
+    fprintf(out, "\n");
+}
+
+// Emit the second pass's move or replication of winner, of population pop, into org, as evolve_settle() does it. The
+// code is indented by indent.
+void emit_settle(FILE* out, simulation_params const* sp, u16 pop, char const* indent) {
+    population_params const* p = &sp->populations[pop];
+    if (p->motile) {
+        fprintf(out, "%sif (winner->ready_to_replicate) {\n", indent);
+    } else {
+        // Sessile organisms only leave their cell to replicate.
+        fprintf(out, "%s{\n", indent);
+    }
+    fprintf(out, "%s    *org = (organism){\n", indent);
+    fprintf(out, "%s        .birthday = wld->step,\n", indent);
+    fprintf(out, "%s        .energy = %u,\n", indent, p->energy_at_birth);
+    fprintf(out, "%s        .kills = 0,\n", indent);
+    fprintf(out, "%s        .exists = true,\n", indent);
+    fprintf(out, "%s    };\n", indent);
+    fprintf(out, "%s    ++tally[%u];\n", indent, pop);
+    if (p->energy_cost_replicate) {
+        fprintf(out, "%s    if (winner->energy > %u) {\n", indent, p->energy_cost_replicate);
+        fprintf(out, "%s        winner->energy -= %u;\n", indent, p->energy_cost_replicate);
+        fprintf(out, "%s    } else {\n", indent);
+        fprintf(out, "%s        winner->energy = 0;\n", indent);
+        fprintf(out, "%s    }\n", indent);
+    }
+    if (p->motile) {
+        fprintf(out, "%s} else {\n", indent);
+        fprintf(out, "%s    *org = *winner;\n", indent);
+        fprintf(out, "%s    *winner = (organism){ .existed = true };\n", indent);
+        if (p->energy_cost_move) {
+            fprintf(out, "%s    if (org->energy > %u) {\n", indent, p->energy_cost_move);
+            fprintf(out, "%s        org->energy -= %u;\n", indent, p->energy_cost_move);
+            fprintf(out, "%s    } else {\n", indent);
+            fprintf(out, "%s        org->energy = 0;\n", indent);
+            fprintf(out, "%s    }\n", indent);
+        }
+    }
+    fprintf(out, "%s}\n", indent);
+}
+
+// Second pass, by gathering, as evolve_resolve_gather() does it.
+void emit_second_pass_gather(FILE* out, simulation_params const* sp) {
+    emit_cell_loop_begin(out, sp, true);
+    for (u16 pop = 0; pop < sp->population_count; ++pop) {
+        if (!population_can_target(&sp->populations[pop])) {
+            fprintf(out, "            // Population %u never leaves its cell.\n", pop);
+            continue;
+        }
+        fprintf(out, "            {\n");
+        fprintf(out, "                organism* const org = &map[c + %u];\n", pop);
+        fprintf(out, "                if (!org->existed) {\n");
+        fprintf(out, "                    u8 k = 0;\n");
+        fprintf(out, "                    organism* winner = NULL;\n");
+        fprintf(out, "                    for (int i = 0; i < 8; ++i) {\n");
+        fprintf(out, "                        organism* const contender = &map[n[i] + %u];\n", pop);
+        fprintf(out, "                        if (contender->exists && contender->target.x == x && contender->target.y == y) {\n");
+        fprintf(out, "                            ++k;\n");
+        fprintf(out, "                            if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, x, y, %u, k)) {\n", pop);
+        fprintf(out, "                                winner = contender;\n");
+        fprintf(out, "                            }\n");
+        fprintf(out, "                        }\n");
+        fprintf(out, "                    }\n");
+        fprintf(out, "                    if (winner) {\n");
+        emit_settle(out, sp, pop, "                        ");
+        fprintf(out, "                    }\n");
+        fprintf(out, "                }\n");
+        fprintf(out, "            }\n");
+    }
+    emit_cell_loop_end(out);
+}
+
+// Second pass, by scattering from the movers, as evolve_resolve_scatter() does it: The first pass set each mover's bit
+// in its target's contenders.
+void emit_second_pass_scatter(FILE* out, simulation_params const* sp) {
+    u16 const w = sp->w;
+    u16 const h = sp->h;
+    emit_cell_loop_begin(out, sp, false);
+    for (u16 pop = 0; pop < sp->population_count; ++pop) {
+        if (!population_can_target(&sp->populations[pop])) {
+            fprintf(out, "            // Population %u never leaves its cell.\n", pop);
+            continue;
+        }
+        fprintf(out, "            {\n");
+        fprintf(out, "                organism* const winner = &map[c + %u];\n", pop);
+        fprintf(out, "                point const to = winner->target;\n");
+        fprintf(out, "                if (winner->exists && (to.x != x || to.y != y)) {\n");
+        fprintf(out, "                    i32 const dx = to.x == x ? 0 : (to.x == (x == %u ? 0 : x + 1) ? 1 : -1);\n",
+                w - 1);
+        fprintf(out, "                    i32 const dy = to.y == y ? 0 : (to.y == (y == %u ? 0 : y + 1) ? 1 : -1);\n",
+                h - 1);
+        fprintf(out, "                    u8 const mine = evolve_contender_bit(-dx, -dy);\n");
+        fprintf(out, "                    organism* const org = &map[%uu * ((size_t)to.y * %uu + to.x) + %u];\n",
+                sp->population_count, w, pop);
+        fprintf(out, "                    if ((org->contenders & mine) && org->existed) {\n");
+        fprintf(out, "                        org->contenders = 0;\n");
+        fprintf(out, "                    } else if (org->contenders & mine) {\n");
+        fprintf(out, "                        if (org->contenders != mine) {\n");
+        fprintf(out, "                            u8 k = 0;\n");
+        fprintf(out, "                            u8 drawn = 0;\n");
+        fprintf(out, "                            for (u8 bits = org->contenders; bits; bits &= (u8)(bits - 1)) {\n");
+        fprintf(out, "                                ++k;\n");
+        fprintf(out, "                                if (k == 1 || evolve_draw_contender_wins(wld, key_second_pass, "
+                "to.x, to.y, %u, k)) {\n", pop);
+        fprintf(out, "                                    drawn = bits & (u8)-bits;\n");
+        fprintf(out, "                                }\n");
+        fprintf(out, "                            }\n");
+        fprintf(out, "                            org->contenders = drawn;\n");
+        fprintf(out, "                        }\n");
+        fprintf(out, "                        if (org->contenders == mine) {\n");
+        fprintf(out, "                            org->contenders = 0;\n");
+        emit_settle(out, sp, pop, "                            ");
+        fprintf(out, "                        }\n");
+        fprintf(out, "                    }\n");
+        fprintf(out, "                }\n");
+        fprintf(out, "            }\n");
+    }
+    emit_cell_loop_end(out);
+}
+
+void emit_second_pass(FILE* out, simulation_params const* sp) {
+    fprintf(out, "    // Second pass: Organisms move or replicate to targets, with uniformly random choice when there is\n");
+    fprintf(out, "    // contention for the same cell.\n");
+    if (resolves_by_scattering(sp)) {
+        emit_second_pass_scatter(out, sp);
+    } else {
+        emit_second_pass_gather(out, sp);
+    }
+    fprintf(out, "\n");
+}
+
+void emit_third_pass(FILE* out, simulation_params const* sp) {
+    fprintf(out, "    // Third pass: Predation and death.\n");
+    emit_cell_loop_begin(out, sp, false);
+    for (u16 pop = 0; pop < sp->population_count; ++pop) {
+        population_params const* p = &sp->populations[pop];
+        fprintf(out, "            {\n");
+        fprintf(out, "                organism* const org = &map[c + %u];\n", pop);
+        fprintf(out, "                if (org->exists) {\n");
+        for (u16 other_pop = 0; other_pop < sp->population_count; ++other_pop) {
+            if (!is_prey(p, &sp->populations[other_pop])) {
+                continue;
+            }
+            fprintf(out, "                    organism* const prey_%u = &map[c + %u];\n", other_pop, other_pop);
+            fprintf(out, "                    if (prey_%u->exists) {\n", other_pop);
+            fprintf(out, "                        org->energy += prey_%u->energy;\n", other_pop);
+            fprintf(out, "                        *prey_%u = (organism){0};\n", other_pop);
+            fprintf(out, "                        --tally[%u];\n", other_pop);
+            fprintf(out, "                        ++org->kills;\n");
+            fprintf(out, "                    }\n");
+        }
+        fprintf(out, "                    if (org->energy == 0) {\n");
+        fprintf(out, "                        *org = (organism){0};\n");
+        fprintf(out, "                        --tally[%u];\n", pop);
+        fprintf(out, "                    }\n");
+        fprintf(out, "                    org->energy = MIN(%u, org->energy);\n", p->energy_maximum);
+        fprintf(out, "                }\n");
+        fprintf(out, "            }\n");
+    }
+    emit_cell_loop_end(out);
+    fprintf(out, "\n");
+}
+
+void emit_evolve(FILE* out, simulation_params const* sp) {
+    fprintf(out, "// Take one time step.\n");
+    fprintf(out, "void evolve_specialized(world* wld) {\n");
+    fprintf(out, "    organism* const map = wld->map;\n");
+    fprintf(out, "    u32* const tally = wld->pop_tally;\n");
+    fprintf(out, "    u32* const directions = wld->directions;\n");
+    fprintf(out, "    u64 const key_first_pass = evolve_rand_key(wld, 0);\n");
+    fprintf(out, "    u64 const key_second_pass = evolve_rand_key(wld, 1);\n");
+    fprintf(out, "\n");
+    emit_first_pass(out, sp);
+    emit_second_pass(out, sp);
+    emit_third_pass(out, sp);
+    fprintf(out, "    ++wld->step;\n");
+    fprintf(out, "}\n");
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: specialize <config.json> <output.c>\n");
+        return EXIT_FAILURE;
+    }
+    char const* const config_filename = argv[1];
+    char const* const output_filename = argv[2];
+
+    simulation_params params = {0};
+    if (!config_load(config_filename, &params) || !config_validate(&params)) {
+        fprintf(stderr, "Failed to load simulation parameters.\n");
+        simulation_params_destroy(&params);
+        return EXIT_FAILURE;
+    }
+
+    for (u16 pop = 0; pop < params.population_count; ++pop) {
+        population_params const* p = &params.populations[pop];
+        if (p->neighborhood != NEIGHBORHOOD_MOORE || p->neighborhood_radius != 1) {
+            fprintf(stderr, "[ERROR] Population %u doesn't have the default neighborhood, which is the only one that "
+                    "the specialized kernel implements.\n", pop);
+            simulation_params_destroy(&params);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE* out = fopen(output_filename, "w");
+    if (!out) {
+        fprintf(stderr, "[ERROR] Failed to open file %s: %s\n", output_filename, strerror(errno));
+        simulation_params_destroy(&params);
+        return EXIT_FAILURE;
+    }
+    emit_header(out, config_filename, &params);
+    emit_applies(out, &params);
+    emit_evolve(out, &params);
+    bool const write_failed = ferror(out);
+    if (fclose(out) != 0 || write_failed) {
+        fprintf(stderr, "[ERROR] Failed to write file %s.\n", output_filename);
+        simulation_params_destroy(&params);
+        return EXIT_FAILURE;
+    }
+
+    simulation_params_destroy(&params);
+    return EXIT_SUCCESS;
+}
@@ -1,19 +1,49 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #else
 #define WIN32_LEAN_AND_MEAN    // Exclude rarely-used definitions.
 #include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#define UTIL_X86_64
+#include <emmintrin.h>  // SSE2, which every x86-64 processor has.
+#if defined(__GNUC__) || defined(__clang__)
+#define UTIL_AVX2  // AVX2 must be detected at runtime; see json_scanner_best().
+#include <immintrin.h>
+#endif
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <stdatomic.h>
 #endif
 
+#include "pow5_table.h"  // Generated by scripts/gen_pow5_table.py.
+
 
 /**** Typedefs ****/
 
@@ -29,6 +59,81 @@ typedef float f32;
 typedef double f64;
 
 
+/**** Allocation statistics ****/
+
+// If UTIL_ALLOC_STATS is defined before this file is included, then malloc(), calloc(), realloc() and free() are
+// replaced (in this file, and in any code after it) by versions which count allocations and bytes, for benchmarking.
+// Only memory allocated by these can be freed by them.
+#ifdef UTIL_ALLOC_STATS
+typedef struct alloc_stats {
+    u64 count;  // Calls to malloc(), calloc() and realloc().
+    size_t bytes;  // Currently allocated.
+    size_t bytes_peak;  // Maximum of bytes, since the last reset.
+} alloc_stats;
+
+alloc_stats alloc_stats_global = {0};
+
+// Start counting afresh from the memory that's currently allocated.
+void alloc_stats_reset(void) {
+    alloc_stats_global.count = 0;
+    alloc_stats_global.bytes_peak = alloc_stats_global.bytes;
+}
+
+// Each allocation is preceded by a header recording its size.
+typedef union alloc_header {
+    size_t size;
+    max_align_t align;
+} alloc_header;
+
+void* alloc_stats_realloc(void* p, size_t size) {
+    alloc_header* header = p ? (alloc_header*)p - 1 : NULL;
+    size_t const size_old = header ? header->size : 0;
+    if (size > SIZE_MAX - sizeof(alloc_header)) {
+        return NULL;
+    }
+    header = (alloc_header*)realloc(header, sizeof(alloc_header) + size);
+    if (!header) {
+        return NULL;
+    }
+    header->size = size;
+    ++alloc_stats_global.count;
+    alloc_stats_global.bytes = alloc_stats_global.bytes - size_old + size;
+    if (alloc_stats_global.bytes > alloc_stats_global.bytes_peak) {
+        alloc_stats_global.bytes_peak = alloc_stats_global.bytes;
+    }
+    return header + 1;
+}
+
+void* alloc_stats_malloc(size_t size) {
+    return alloc_stats_realloc(NULL, size);
+}
+
+void* alloc_stats_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void* p = alloc_stats_realloc(NULL, count * size);
+    if (p) {
+        memset(p, 0, count * size);
+    }
+    return p;
+}
+
+void alloc_stats_free(void* p) {
+    if (p) {
+        alloc_header* header = (alloc_header*)p - 1;
+        alloc_stats_global.bytes -= header->size;
+        free(header);
+    }
+}
+
+#define malloc(size) alloc_stats_malloc(size)
+#define calloc(count, size) alloc_stats_calloc(count, size)
+#define realloc(p, size) alloc_stats_realloc(p, size)
+#define free(p) alloc_stats_free(p)
+#endif
+
+
 /**** Clamping ****/
 
 #ifndef MIN
@@ -59,6 +164,28 @@ u32 clamp_i64_u32(i64 x) {
 }
 
 
+/**** Time ****/
+
+// Wall-clock time, in nanoseconds. Suitable for timing benchmarks.
+i64 time_now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (i64)ts.tv_sec * 1000000000 + (i64)ts.tv_nsec;
+}
+
+// Sleep for at least ms milliseconds.
+void time_sleep_ms(u32 ms) {
+#ifndef _WIN32
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        // Interrupted by a signal: Sleep for the rest.
+    }
+#else
+    Sleep(ms);
+#endif
+}
+
+
 /**** I/O ****/
 
 bool file_exists_and_readable(char const*const filename) {
@@ -69,6 +196,565 @@ bool file_exists_and_readable(char const*const filename) {
 #endif
 }
 
+// Find when the file was last modified, in nanoseconds since an unspecified epoch (or coarser, depending on the file
+// system). This changes whenever the file is written, or replaced (as editors often do when saving).
+// Return: true on success; false if the file doesn't exist, or can't be examined.
+bool file_modification_time(char const* filename, i64* mtime_ns) {
+#ifndef _WIN32
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        return false;
+    }
+#ifdef __APPLE__
+    *mtime_ns = (i64)st.st_mtimespec.tv_sec * 1000000000 + (i64)st.st_mtimespec.tv_nsec;
+#else
+    *mtime_ns = (i64)st.st_mtim.tv_sec * 1000000000 + (i64)st.st_mtim.tv_nsec;
+#endif
+#else
+    struct _stat64 st;
+    if (_stat64(filename, &st) != 0) {
+        return false;
+    }
+    *mtime_ns = (i64)st.st_mtime * 1000000000;
+#endif
+    return true;
+}
+
+
+/**** Threads ****/
+
+typedef struct thread {
+    void (*fn)(void* arg);
+    void* arg;
+#ifndef _WIN32
+    pthread_t handle;
+#else
+    HANDLE handle;
+#endif
+} thread;
+
+#ifndef _WIN32
+void* thread_trampoline(void* t) {
+    ((thread*)t)->fn(((thread*)t)->arg);
+    return NULL;
+}
+#else
+DWORD WINAPI thread_trampoline(LPVOID t) {
+    ((thread*)t)->fn(((thread*)t)->arg);
+    return 0;
+}
+#endif
+
+// Start running fn(arg) on a new thread. The thread object must remain valid until thread_join() returns.
+// Return: true on success; false on failure.
+bool thread_start(thread* t, void (*fn)(void* arg), void* arg) {
+    t->fn = fn;
+    t->arg = arg;
+#ifndef _WIN32
+    return pthread_create(&t->handle, NULL, thread_trampoline, t) == 0;
+#else
+    t->handle = CreateThread(NULL, 0, thread_trampoline, t, 0, NULL);
+    return t->handle != NULL;
+#endif
+}
+
+void thread_join(thread* t) {
+#ifndef _WIN32
+    pthread_join(t->handle, NULL);
+#else
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#endif
+}
+
+// A lock for mutual exclusion between threads. Must be initialized with mutex_init() before use.
+typedef struct mutex {
+#ifndef _WIN32
+    pthread_mutex_t handle;
+#else
+    CRITICAL_SECTION handle;
+#endif
+} mutex;
+
+void mutex_init(mutex* m) {
+#ifndef _WIN32
+    pthread_mutex_init(&m->handle, NULL);
+#else
+    InitializeCriticalSection(&m->handle);
+#endif
+}
+
+void mutex_destroy(mutex* m) {
+#ifndef _WIN32
+    pthread_mutex_destroy(&m->handle);
+#else
+    DeleteCriticalSection(&m->handle);
+#endif
+}
+
+void mutex_lock(mutex* m) {
+#ifndef _WIN32
+    pthread_mutex_lock(&m->handle);
+#else
+    EnterCriticalSection(&m->handle);
+#endif
+}
+
+void mutex_unlock(mutex* m) {
+#ifndef _WIN32
+    pthread_mutex_unlock(&m->handle);
+#else
+    LeaveCriticalSection(&m->handle);
+#endif
+}
+
+// A u64 shared between threads, without a lock. What one thread writes before storing a value with atomic_u64_store()
+// is seen by another thread once it loads that value with atomic_u64_load().
+#ifndef _MSC_VER
+typedef _Atomic u64 atomic_u64;
+
+u64 atomic_u64_load(atomic_u64* a) {
+    return atomic_load_explicit(a, memory_order_acquire);
+}
+
+void atomic_u64_store(atomic_u64* a, u64 value) {
+    atomic_store_explicit(a, value, memory_order_release);
+}
+#else
+typedef u64 volatile atomic_u64;
+
+u64 atomic_u64_load(atomic_u64* a) {
+    return (u64)InterlockedCompareExchange64((LONG64 volatile*)a, 0, 0);
+}
+
+void atomic_u64_store(atomic_u64* a, u64 value) {
+    InterlockedExchange64((LONG64 volatile*)a, (LONG64)value);
+}
+#endif
+
+// Order every load and store before this against every one after it, e.g., for a seqlock: See telemetry.
+void atomic_fence(void) {
+#ifndef _MSC_VER
+    atomic_thread_fence(memory_order_seq_cst);
+#else
+    MemoryBarrier();
+#endif
+}
+
+// Number of processors available to run threads (at least 1).
+u32 thread_count_hardware(void) {
+#ifndef _WIN32
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (u32)n;
+#else
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors < 1 ? 1 : (u32)info.dwNumberOfProcessors;
+#endif
+}
+
+#define PARALLEL_FOR_MAX_THREADS 64
+
+typedef struct parallel_for_job {
+    void (*fn)(void* ctx, u32 index);
+    void* ctx;
+    u32 count;
+    u32 first;
+    u32 stride;
+} parallel_for_job;
+
+void parallel_for_worker(void* arg) {
+    parallel_for_job const* job = arg;
+    for (u32 i = job->first; i < job->count; i += job->stride) {
+        job->fn(job->ctx, i);
+    }
+}
+
+// Call fn(ctx, i) for each 0 <= i < count, spread over the available processors. Calls for different i may run
+// concurrently, in any order, so they must not depend on one another. Returns once all calls are complete.
+void parallel_for(u32 count, void (*fn)(void* ctx, u32 index), void* ctx) {
+    u32 const num_threads = MIN(MIN(count, thread_count_hardware()), PARALLEL_FOR_MAX_THREADS);
+    thread threads[PARALLEL_FOR_MAX_THREADS];
+    parallel_for_job jobs[PARALLEL_FOR_MAX_THREADS];
+    bool started[PARALLEL_FOR_MAX_THREADS] = {0};
+    for (u32 t = 0; t < num_threads; ++t) {
+        jobs[t] = (parallel_for_job){ .fn = fn, .ctx = ctx, .count = count, .first = t, .stride = num_threads };
+        // The calling thread takes the first share of the work itself.
+        if (t > 0) {
+            started[t] = thread_start(&threads[t], parallel_for_worker, &jobs[t]);
+        }
+    }
+    for (u32 t = 0; t < num_threads; ++t) {
+        if (t == 0 || !started[t]) {
+            parallel_for_worker(&jobs[t]);
+        }
+    }
+    for (u32 t = 1; t < num_threads; ++t) {
+        if (started[t]) {
+            thread_join(&threads[t]);
+        }
+    }
+}
+
+
+/**** Message transport ****/
+
+// A transport carries messages between the processes of a job, which are numbered (ranked) from 0 to ranks - 1. It's
+// a table of functions, so that the job doesn't depend on how the processes are connected: transport_local_spawn()
+// runs them on this machine, over Unix sockets. Messages between two processes arrive in the order in which they were
+// sent, and the receiver must know the size of each.
+
+typedef struct transport_message {
+    u32 peer;  // The rank to send to, or to receive from.
+    void* data;
+    size_t size;
+} transport_message;
+
+typedef struct transport {
+    u32 rank;
+    u32 ranks;
+    // Send sends[i].data to each sends[i].peer, and receive into each recvs[i].data from recvs[i].peer, all at once,
+    // so that two processes can exchange messages larger than the transport can hold. Blocks until all are complete.
+    // Return: true on success; false if a peer has gone, or on another error.
+    bool (*exchange)(struct transport* t, transport_message const sends[], u32 send_count,
+                     transport_message const recvs[], u32 recv_count);
+    // Disconnect from the other processes. In rank 0, also wait for the processes it started to finish.
+    // Return: true, unless (in rank 0) any of them failed, which is reported.
+    bool (*close)(struct transport* t);
+    void* impl;
+} transport;
+
+bool transport_send(transport* t, u32 peer, void const* data, size_t size) {
+    transport_message const message = { peer, (void*)data, size };
+    return t->exchange(t, &message, 1, NULL, 0);
+}
+
+bool transport_recv(transport* t, u32 peer, void* data, size_t size) {
+    transport_message const message = { peer, data, size };
+    return t->exchange(t, NULL, 0, &message, 1);
+}
+
+#define TRANSPORT_LOCAL_MAX_RANKS 16  // Every pair of processes has a socket, so this bounds the number of sockets.
+#define TRANSPORT_MAX_MESSAGES 64  // Most messages to send, and to receive, in one exchange.
+
+#ifndef _WIN32
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // E.g., on macOS, where SO_NOSIGPIPE is set on the sockets instead.
+#endif
+
+typedef struct transport_local {
+    int fds[TRANSPORT_LOCAL_MAX_RANKS];  // This process's end of the socket to each other process; -1 for itself.
+    pid_t pids[TRANSPORT_LOCAL_MAX_RANKS];  // In rank 0: The other processes, which it started.
+} transport_local;
+
+// Find the first message to or from peer in messages that isn't complete, given how much of each is done.
+// Return: Its index, or count if there is none.
+u32 transport_local_next(transport_message const messages[], u32 count, size_t const done[], u32 peer) {
+    u32 i = 0;
+    while (i < count && (messages[i].peer != peer || done[i] == messages[i].size)) {
+        ++i;
+    }
+    return i;
+}
+
+bool transport_local_exchange(transport* t, transport_message const sends[], u32 send_count,
+                              transport_message const recvs[], u32 recv_count) {
+    transport_local const* const tl = t->impl;
+    if (send_count > TRANSPORT_MAX_MESSAGES || recv_count > TRANSPORT_MAX_MESSAGES) {
+        fprintf(stderr, "[ERROR] Too many messages for one exchange.\n");
+        return false;
+    }
+    size_t sent[TRANSPORT_MAX_MESSAGES] = {0};
+    size_t received[TRANSPORT_MAX_MESSAGES] = {0};
+    while (true) {
+        // Wait for any socket with a message to go, or to come, to be ready.
+        struct pollfd fds[TRANSPORT_LOCAL_MAX_RANKS];
+        u32 peers[TRANSPORT_LOCAL_MAX_RANKS];
+        nfds_t n = 0;
+        for (u32 peer = 0; peer < t->ranks; ++peer) {
+            bool const sending = transport_local_next(sends, send_count, sent, peer) < send_count;
+            bool const receiving = transport_local_next(recvs, recv_count, received, peer) < recv_count;
+            if (peer != t->rank && (sending || receiving)) {
+                fds[n] = (struct pollfd){ .fd = tl->fds[peer], .events = (short)((sending ? POLLOUT : 0) |
+                                                                                  (receiving ? POLLIN : 0)) };
+                peers[n++] = peer;
+            }
+        }
+        if (n == 0) {
+            return true;
+        }
+        if (poll(fds, n, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "[ERROR] Failed to wait for messages: %s.\n", strerror(errno));
+            return false;
+        }
+
+        for (nfds_t i = 0; i < n; ++i) {
+            u32 const peer = peers[i];
+            bool ok = true;
+            if (fds[i].revents & POLLOUT) {
+                u32 const m = transport_local_next(sends, send_count, sent, peer);
+                ssize_t const k = send(fds[i].fd, (char const*)sends[m].data + sent[m], sends[m].size - sent[m],
+                                       MSG_NOSIGNAL);
+                ok = k >= 0 || errno == EAGAIN || errno == EINTR;
+                sent[m] += k > 0 ? (size_t)k : 0;
+            }
+            if (ok && (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                u32 const m = transport_local_next(recvs, recv_count, received, peer);
+                if (m == recv_count) {
+                    // Nothing more to receive from this peer, but its socket failed.
+                    ok = !(fds[i].revents & (POLLHUP | POLLERR));
+                } else {
+                    ssize_t const k = recv(fds[i].fd, (char*)recvs[m].data + received[m],
+                                           recvs[m].size - received[m], 0);
+                    // 0: The peer closed its socket.
+                    ok = k > 0 || (k < 0 && (errno == EAGAIN || errno == EINTR));
+                    received[m] += k > 0 ? (size_t)k : 0;
+                }
+            }
+            if (!ok) {
+                fprintf(stderr, "[ERROR] Process %u lost the connection to process %u.\n", t->rank, peer);
+                return false;
+            }
+        }
+    }
+}
+
+bool transport_local_close(transport* t) {
+    transport_local* const tl = t->impl;
+    bool ok = true;
+    for (u32 peer = 0; peer < t->ranks; ++peer) {
+        if (tl->fds[peer] >= 0) {
+            close(tl->fds[peer]);
+        }
+    }
+    // Once their sockets are closed, the other processes can't wait for this one.
+    for (u32 peer = 1; t->rank == 0 && peer < t->ranks; ++peer) {
+        int status;
+        if (tl->pids[peer] <= 0) {
+            continue;
+        }
+        if (waitpid(tl->pids[peer], &status, 0) < 0) {
+            fprintf(stderr, "[ERROR] Failed to wait for process %u: %s.\n", peer, strerror(errno));
+            ok = false;
+        } else if (WIFSIGNALED(status)) {
+            fprintf(stderr, "[ERROR] Process %u was killed by signal %d.\n", peer, WTERMSIG(status));
+            ok = false;
+        } else if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            fprintf(stderr, "[ERROR] Process %u failed.\n", peer);
+            ok = false;
+        }
+    }
+    free(tl);
+    *t = (transport){0};
+    return ok;
+}
+#endif
+
+// Start ranks - 1 more processes, as copies of this one (with fork()), connected to each other and to this one. Like
+// fork(), this returns in each of them: This process becomes rank 0, and the others ranks 1 to ranks - 1, which must
+// end with _exit() (not exit(), which would also flush the copies of this process's output buffers).
+// Return: true on success, in every process; false on failure, in this process only.
+// Notes: Call this before starting any threads, which the other processes wouldn't have.
+bool transport_local_spawn(transport* t, u32 ranks) {
+#ifndef _WIN32
+    if (ranks == 0 || ranks > TRANSPORT_LOCAL_MAX_RANKS) {
+        fprintf(stderr, "[ERROR] Can't run %u processes; at most %u.\n", ranks, TRANSPORT_LOCAL_MAX_RANKS);
+        return false;
+    }
+    transport_local* const tl = malloc(sizeof *tl);
+    if (!tl) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory for the transport.\n");
+        return false;
+    }
+    // fds[a][b]: Process a's end of the socket between a and b.
+    int fds[TRANSPORT_LOCAL_MAX_RANKS][TRANSPORT_LOCAL_MAX_RANKS];
+    memset(fds, -1, sizeof fds);
+    bool ok = true;
+    for (u32 a = 0; ok && a < ranks; ++a) {
+        for (u32 b = a + 1; ok && b < ranks; ++b) {
+            int pair[2];
+            ok = socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0;
+            fds[a][b] = ok ? pair[0] : -1;
+            fds[b][a] = ok ? pair[1] : -1;
+        }
+    }
+
+    u32 rank = 0;
+    memset(tl->pids, 0, sizeof tl->pids);
+    if (ok) {
+        fflush(NULL);
+        for (u32 r = 1; r < ranks; ++r) {
+            pid_t const pid = fork();
+            if (pid == 0) {
+                rank = r;
+                break;
+            }
+            if (pid < 0) {
+                // Those already started see their sockets close, and end.
+                ok = false;
+                break;
+            }
+            tl->pids[r] = pid;
+        }
+    }
+
+    // Keep just this process's ends of its sockets.
+    for (u32 a = 0; a < ranks; ++a) {
+        for (u32 b = 0; b < ranks; ++b) {
+            if (fds[a][b] >= 0 && (a != rank || !ok)) {
+                close(fds[a][b]);
+            }
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "[ERROR] Failed to start %u processes: %s.\n", ranks, strerror(errno));
+        for (u32 r = 1; r < ranks; ++r) {
+            if (tl->pids[r] > 0) {
+                waitpid(tl->pids[r], NULL, 0);
+            }
+        }
+        free(tl);
+        return false;
+    }
+    for (u32 peer = 0; peer < TRANSPORT_LOCAL_MAX_RANKS; ++peer) {
+        tl->fds[peer] = peer < ranks ? fds[rank][peer] : -1;
+        if (tl->fds[peer] >= 0) {
+            fcntl(tl->fds[peer], F_SETFL, fcntl(tl->fds[peer], F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+            int const one = 1;
+            setsockopt(tl->fds[peer], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+        }
+    }
+    *t = (transport){
+        .rank = rank,
+        .ranks = ranks,
+        .exchange = transport_local_exchange,
+        .close = transport_local_close,
+        .impl = tl,
+    };
+    return true;
+#else
+    (void)t;
+    (void)ranks;
+    fprintf(stderr, "[ERROR] Running several processes isn't supported on Windows.\n");
+    return false;
+#endif
+}
+
+/**** Shared memory ****/
+
+// A named segment of memory that other processes on this machine can map, by name, while it exists: On POSIX
+// systems, it's /dev/shm/<name> (where supported); on Windows, the file mapping Local\<name>.
+typedef struct shared_memory {
+    void* p;
+    size_t size;
+    char name[256];  // With a leading slash, on POSIX systems.
+#ifdef _WIN32
+    HANDLE handle;
+#endif
+} shared_memory;
+
+#ifndef _WIN32
+// Whether the segment called name (with its leading slash) was left behind by a process that has ended: It holds that
+// process's ID, as a u32, at pid_offset. A segment too short to hold it is taken to be left behind, too.
+bool shared_memory_abandoned(char const* name, size_t pid_offset) {
+    int const fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+    u32 pid = 0;
+    bool const read = pread(fd, &pid, sizeof pid, (off_t)pid_offset) == (ssize_t)sizeof pid;
+    close(fd);
+    return !read || pid == 0 || (kill((pid_t)pid, 0) < 0 && errno == ESRCH);
+}
+#endif
+
+// Create the segment called name, of size bytes, zeroed except for this process's ID, as a u32 at pid_offset, and map
+// it. A segment of that name that another process is using is left alone, and this fails; one left behind by a process
+// that has ended, and so didn't remove it, is replaced.
+// Return: true on success; false on failure.
+// Notes: If this call is successful, then the caller is responsible for calling shared_memory_destroy(shm).
+bool shared_memory_create(shared_memory* shm, char const* name, size_t size, size_t pid_offset) {
+    assert(pid_offset + sizeof(u32) <= size);
+    *shm = (shared_memory){ .size = size };
+    u32 pid;
+#ifndef _WIN32
+    if (snprintf(shm->name, sizeof shm->name, "/%s", name) >= (int)sizeof shm->name || strchr(name, '/')) {
+        fprintf(stderr, "[ERROR] Invalid shared memory name: %s\n", name);
+        return false;
+    }
+    int fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST && shared_memory_abandoned(shm->name, pid_offset)) {
+        shm_unlink(shm->name);
+        fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    if (fd < 0 && errno == EEXIST) {
+        fprintf(stderr, "[ERROR] Cannot create shared memory %s: Another process is using it.\n", name);
+        return false;
+    }
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] Cannot create shared memory %s: %s\n", name, strerror(errno));
+        return false;
+    }
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int const error = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "[ERROR] Cannot map shared memory %s: %s\n", name, strerror(error));
+        shm_unlink(shm->name);
+        return false;
+    }
+    shm->p = p;
+    pid = (u32)getpid();
+#else
+    if (snprintf(shm->name, sizeof shm->name, "Local\\%s", name) >= (int)sizeof shm->name) {
+        fprintf(stderr, "[ERROR] Invalid shared memory name: %s\n", name);
+        return false;
+    }
+    shm->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((u64)size >> 32),
+                                     (DWORD)(size & 0xFFFFFFFF), shm->name);
+    // A mapping goes away with the last process that has it open, so one that exists is in use.
+    if (shm->handle && GetLastError() == ERROR_ALREADY_EXISTS) {
+        fprintf(stderr, "[ERROR] Cannot create shared memory %s: Another process is using it.\n", name);
+        CloseHandle(shm->handle);
+        return false;
+    }
+    if (!shm->handle || !(shm->p = MapViewOfFile(shm->handle, FILE_MAP_ALL_ACCESS, 0, 0, size))) {
+        fprintf(stderr, "[ERROR] Cannot create shared memory %s: error %lu\n", name, GetLastError());
+        if (shm->handle) {
+            CloseHandle(shm->handle);
+        }
+        return false;
+    }
+    pid = (u32)GetCurrentProcessId();
+#endif
+    memset(shm->p, 0, size);
+    memcpy((u8*)shm->p + pid_offset, &pid, sizeof pid);
+    return true;
+}
+
+// Unmap the segment, and remove its name. Processes that have it mapped keep their mappings.
+void shared_memory_destroy(shared_memory* shm) {
+    if (!shm->p) {
+        return;
+    }
+#ifndef _WIN32
+    munmap(shm->p, shm->size);
+    shm_unlink(shm->name);
+#else
+    UnmapViewOfFile(shm->p);
+    CloseHandle(shm->handle);
+#endif
+    *shm = (shared_memory){0};
+}
+
 
 /**** Random number generator ****/
 
@@ -128,18 +814,70 @@ u32 rand_bool(void) {
     return rand_raw() % 2;
 }
 
-
-// Randomly pick a combination uniformly from the (n choose k) possibilities. Store the result in combination.
-// Implements Robert Floyd's algorithm.
+// Generate a random integer in the half-open interval [0, range), without bias, using Lemire's multiply-shift method.
+// Unlike rand_unif(), this needs no division except (rarely) to decide whether to reject a draw.
+// https://arxiv.org/abs/1805.10941
 // Parameters:
-//    n, k: Will choose k random elements of combination to be true, and n - k to be false.
-//    combination: Must point to contiguous array of n bools.
-void rand_combination(u32 n, u32 k, bool combination[]) {
-    assert(n >= k);
-    for (u32 i = 0; i < n; ++i) {
-        combination[i] = false;
+//   range > 0.
+u32 rand_bounded_s(rand_state* x, u32 range) {
+    u64 m = (u64)(u32)rand_raw_s(x) * range;
+    if ((u32)m < range) {
+        u32 const threshold = (0u - range) % range;
+        while ((u32)m < threshold) {
+            m = (u64)(u32)rand_raw_s(x) * range;
+        }
     }
-    for (u32 j = n - k; j < n; ++j) {
+    return (u32)(m >> 32);
+}
+
+u32 rand_bounded(u32 range) {
+    return rand_bounded_s(&rand_state_global, range);
+}
+
+// Draw from the hypergeometric distribution: the number of successes among `draws` items drawn (without replacement)
+// from `total` items, of which `successes` are successes.
+// Implements selection sampling, drawing one item at a time, with integer arithmetic only, so that the result is the
+// same on every platform. By symmetry (the successes among the draws are the draws among the successes, and the
+// complement of the draws, or of the successes, can be counted instead), it draws the fewest items it can, so it takes
+// O(min(draws, successes, total - draws, total - successes)) steps.
+// Parameters:
+//   successes <= total, draws <= total.
+u32 rand_hypergeometric_s(rand_state* x, u32 total, u32 successes, u32 draws) {
+    assert(successes <= total && draws <= total);
+    u32 drawn = MIN(draws, successes);
+    u32 marked = MAX(draws, successes);
+    bool const complement_drawn = drawn > total - drawn;
+    bool const complement_marked = marked > total - marked;
+    u32 const marked_all = marked;
+    drawn = complement_drawn ? total - drawn : drawn;
+    marked = complement_marked ? total - marked : marked;
+    // The count is symmetric in the two sets, so draw the smaller one.
+    u32 const picks = MIN(drawn, marked);
+    u32 const hits = MAX(drawn, marked);
+    u32 k = 0;
+    for (u32 i = 0; i < picks && k < hits; ++i) {
+        if (rand_bounded_s(x, total - i) < hits - k) {
+            ++k;
+        }
+    }
+    // Undo the complements: Of the drawn items, drawn - k are unmarked; and of the marked items, those not drawn are
+    // the rest.
+    k = complement_marked ? drawn - k : k;
+    return complement_drawn ? marked_all - k : k;
+}
+
+
+// Randomly pick a combination uniformly from the (n choose k) possibilities. Store the result in combination.
+// Implements Robert Floyd's algorithm.
+// Parameters:
+//    n, k: Will choose k random elements of combination to be true, and n - k to be false.
+//    combination: Must point to contiguous array of n bools.
+void rand_combination(u32 n, u32 k, bool combination[]) {
+    assert(n >= k);
+    for (u32 i = 0; i < n; ++i) {
+        combination[i] = false;
+    }
+    for (u32 j = n - k; j < n; ++j) {
         u32 r = rand_unif(0, j);
         if (combination[r]) {
             combination[j] = true;
@@ -158,6 +896,62 @@ void rand_combination(u32 n, u32 k, bool combination[]) {
 }
 
 
+/**** Counter-based random number generator ****/
+
+// rand_counter(key, counter) is a random function of its arguments: different (key, counter) pairs give independent
+// random numbers. There is no state, so a draw depends only on what it's for (e.g., the time step, the cell, and the
+// population), and not on how many draws came before it. Hot loops use this so that draws can be made in batches, in
+// any order, or in parallel, with identical results.
+//
+// For fixed key, rand_counter(key, 0), rand_counter(key, 1), ... is the SplitMix64 sequence seeded with key.
+// https://prng.di.unimi.it/splitmix64.c
+u64 rand_counter(u64 key, u64 counter) {
+    u64 z = key + (counter + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Map a random 64-bit number to the half-open interval [0, range), without bias (Lemire's method, on the high 32 bits).
+// When a draw must be rejected, raw is re-mixed, so that the result is still a function of raw alone.
+// Parameters:
+//   range > 0.
+u32 rand_reduce(u64 raw, u32 range) {
+    u64 m = (raw >> 32) * range;
+    if ((u32)m < range) {
+        u32 const threshold = (0u - range) % range;
+        while ((u32)m < threshold) {
+            raw = rand_counter(raw, 0);
+            m = (raw >> 32) * range;
+        }
+    }
+    return (u32)(m >> 32);
+}
+
+// Batch generation: out[i] = rand_counter(key, first + i), for 0 <= i < n.
+// There are no dependencies between iterations, so the compiler can vectorize this loop.
+void rand_counter_fill(u64 key, u64 first, u64 out[], size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = rand_counter(key, first + i);
+    }
+}
+
+// Batch generation: out[i] = rand_reduce(rand_counter(key, first + i), range), for 0 <= i < n.
+// Parameters:
+//   range > 0. When range is a power of two, no draw is ever rejected, and the loop vectorizes.
+void rand_counter_fill_bounded(u64 key, u64 first, u32 range, u32 out[], size_t n) {
+    if ((range & (range - 1)) == 0) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = (u32)(((rand_counter(key, first + i) >> 32) * range) >> 32);
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = rand_reduce(rand_counter(key, first + i), range);
+        }
+    }
+}
+
+
 /**** Buffer ****/
 
 typedef struct buffer {
@@ -234,6 +1028,54 @@ bool buffer_expand(buffer* buf) {
     return true;
 }
 
+/* Ensure that buf has room for at least extra more bytes, growing it as buffer_expand() does. Do not modify contents.
+   Return true on success. */
+bool buffer_reserve(buffer* buf, size_t extra) {
+    if (buf->len_max - buf->len >= extra) {
+        return true;
+    }
+    size_t new_len = buf->len_max ? buf->len_max : 256;
+    while (new_len - buf->len < extra) {
+        new_len += new_len / 2;
+    }
+    char* new_p = (char*)realloc(buf->p, new_len);
+    if (new_p == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+        return false;
+    }
+    buf->p = new_p;
+    buf->len_max = new_len;
+    return true;
+}
+
+/* Append len bytes from p to buf, growing it as needed. Return true on success. */
+bool buffer_append(buffer* buf, char const* p, size_t len) {
+    if (!buffer_reserve(buf, len)) {
+        return false;
+    }
+    if (len) {
+        memcpy(buf->p + buf->len, p, len);
+        buf->len += len;
+    }
+    return true;
+}
+
+/* Append text formatted as by printf() to buf, growing it as needed. Return true on success. */
+bool buffer_appendf(buffer* buf, char const* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int const len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (len < 0 || !buffer_reserve(buf, (size_t)len + 1)) {
+        return false;
+    }
+    va_start(args, format);
+    vsnprintf(buf->p + buf->len, (size_t)len + 1, format, args);
+    va_end(args);
+    buf->len += (size_t)len;
+    return true;
+}
+
 /* Reclaim unused/unneeded memory at end of buffer. Does not change buf's contents or length. */
 void buffer_compress(buffer* buf) {
     char* new_p = (char*)realloc(buf->p, buf->len);
@@ -246,25 +1088,63 @@ void buffer_compress(buffer* buf) {
     }
 }
 
+// Read an entire file into a new buffer. When the file's size can be found in advance, this takes a single read into a
+// buffer of exactly the right size; otherwise (e.g., for a pipe), the buffer grows as needed.
 buffer buffer_create_from_file(char const* filename) {
     buffer buf = {0, 0, NULL};
-    FILE *f = fopen(filename, "r");
+    FILE *f = fopen(filename, "rb");
     if (NULL == f) {
         fprintf(stderr, "[ERROR] Failed to open file %s: %s\n", filename, strerror(errno));
         return buf;
     }
-    int c = {0};
-    while ((c = getc(f)) != EOF) {
-        if (buf.len == buf.len_max) {
-            if (!buffer_expand(&buf)) {
+    // The largest size that the file can have, beyond which ftell() is wrong: e.g., a directory can be opened, and
+    // reports a huge size.
+    long size_max = LONG_MAX - 1;
+#ifndef _WIN32
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || !(S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode))) {
+        fprintf(stderr, "[ERROR] Failed to read file %s: Not a regular file or a pipe.\n", filename);
+        fclose(f);
+        return buf;
+    }
+    if (S_ISREG(st.st_mode) && st.st_size < LONG_MAX) {
+        size_max = (long)st.st_size;
+    }
+#endif
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        size = ftell(f);
+        if (fseek(f, 0, SEEK_SET) != 0 || size > size_max) {
+            size = -1;
+        }
+    }
+    if (size > 0) {
+        buf.p = (char*)malloc((size_t)size);
+        if (!buf.p) {
+            fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+            fclose(f);
+            return buf;
+        }
+        buf.len_max = (size_t)size;
+        buf.len = fread(buf.p, 1, buf.len_max, f);
+    } else if (size < 0) {
+        while (!feof(f) && !ferror(f)) {
+            if (buf.len == buf.len_max && !buffer_expand(&buf)) {
                 buffer_destroy(&buf);
+                fclose(f);
                 return buf;
             }
+            buf.len += fread(buf.p + buf.len, 1, buf.len_max - buf.len, f);
+        }
+        if (buf.len > 0) {
+            buffer_compress(&buf);
         }
-        buf.p[buf.len++] = (char)c;
+    }
+    if (ferror(f)) {
+        fprintf(stderr, "[ERROR] Failed to read file %s.\n", filename);
+        buffer_destroy(&buf);
     }
     fclose(f);
-    buffer_compress(&buf);
     if (!buffer_valid(buf)) {
         fprintf(stderr, "[ERROR] Failed to create valid buffer from file %s.\n", filename);
         buffer_destroy(&buf);
@@ -274,6 +1154,54 @@ buffer buffer_create_from_file(char const* filename) {
     return buf;
 }
 
+// A read-only view of a file's contents. Where possible, the file is memory-mapped, so that nothing is copied, and
+// pages are read in on demand. Otherwise, the file is read into a buffer by buffer_create_from_file().
+typedef struct file_view {
+    buffer buf;  // The file's contents. Must not be modified, nor destroyed except by file_view_close().
+    bool mapped;  // True if buf points into a memory mapping; false if it was read into the heap.
+} file_view;
+
+// Open a view of a file's contents.
+// Return: true on success; false if the file couldn't be read, or is empty.
+// Notes: If this call is successful, then the caller is responsible for calling file_view_close(view).
+bool file_view_open(char const* filename, file_view* view) {
+    *view = (file_view){0};
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (u64)st.st_size <= SIZE_MAX) {
+            size_t const size = (size_t)st.st_size;
+            void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                // A hint only: The parser reads the file front to back, so read ahead aggressively.
+                madvise(p, size, MADV_SEQUENTIAL);
+                close(fd);
+                view->buf = (buffer){ size, size, (char*)p };
+                view->mapped = true;
+                return true;
+            }
+        }
+        close(fd);
+    }
+#endif
+    // Memory mapping isn't available for this file (or on this platform).
+    view->buf = buffer_create_from_file(filename);
+    return view->buf.len > 0;
+}
+
+void file_view_close(file_view* view) {
+#ifndef _WIN32
+    if (view->mapped) {
+        munmap(view->buf.p, view->buf.len_max);
+        *view = (file_view){0};
+        return;
+    }
+#endif
+    buffer_destroy(&view->buf);
+    *view = (file_view){0};
+}
+
 buffer buffer_clone(buffer const* buf) {
     if (buf->len == 0) {
         return (buffer){0, 0, NULL};
@@ -304,6 +1232,316 @@ bool buffer_eq(buffer const* buf, char const* str) {
 }
 
 
+/**** Asynchronous output ****/
+
+// An async_writer takes writing to a stream (e.g., stdout, which may be a pipe into a slow consumer, or a file on a
+// network file system) off the calling thread: async_writer_write() copies a record (e.g., a line) into a ring buffer,
+// and a dedicated I/O thread drains the ring into the stream. The ring is lock-free, for a single producer (the calling
+// thread) and a single consumer (the I/O thread): Each owns one position in it, which it publishes with
+// atomic_u64_store(), and reads the other's with atomic_u64_load().
+//
+// When a record doesn't fit in the ring, the writer follows its policy:
+//  - ASYNC_WRITER_DROP: Drop the record, and count it. The calling thread never waits.
+//  - ASYNC_WRITER_BLOCK: Wait for the I/O thread to make room. Nothing is lost.
+//  - ASYNC_WRITER_SPILL: Append the record to a spill file, which the I/O thread drains once it has drained the ring.
+//    Later records go to the spill file too, until it's drained, so that the output stays in order. Nothing is lost,
+//    and the calling thread only waits for the local disk.
+
+typedef enum async_writer_policy {
+    ASYNC_WRITER_DROP,
+    ASYNC_WRITER_BLOCK,
+    ASYNC_WRITER_SPILL,
+} async_writer_policy;
+
+#define ASYNC_WRITER_IDLE_MS 1  // How long the I/O thread sleeps when there's nothing to write.
+#define ASYNC_WRITER_SPILL_CHUNK 65536  // Bytes that the I/O thread reads back from the spill file at a time.
+
+typedef struct async_writer {
+    FILE* stream;
+    async_writer_policy policy;
+    char* ring;
+    u64 capacity;  // A power of 2.
+    thread io;
+    char const* spill_filename;
+    FILE* spill;  // Open for appending once the writer first spills.
+    FILE* spill_reader;  // For the I/O thread; opened along with spill.
+    // Owned by the producer:
+    u64 head;  // Bytes written into the ring, ever.
+    u64 spilled;  // Bytes written to the spill file, ever.
+    bool spilling;  // Records go to the spill file, until the I/O thread has drained it.
+    bool spill_failed;  // The spill file couldn't be written, so records that don't fit are dropped instead.
+    u64 dropped;  // Records dropped.
+    u64 dropped_bytes;
+    // Shared:
+    atomic_u64 published_head;  // head, as published to the I/O thread.
+    atomic_u64 published_spilled;  // spilled, as published to the I/O thread (once flushed).
+    atomic_u64 tail;  // Bytes drained from the ring, ever. Stored by the I/O thread.
+    atomic_u64 unspilled;  // Bytes drained from the spill file, ever. Stored by the I/O thread.
+    atomic_u64 stop;  // Set to 1 once there's nothing more to write, to stop the I/O thread once it's done.
+    atomic_u64 failed;  // Set to 1 by the I/O thread if writing to the stream failed.
+} async_writer;
+
+// Write n bytes to the stream, from the I/O thread.
+void async_writer_out(async_writer* aw, char const* p, size_t n) {
+    if (fwrite(p, 1, n, aw->stream) != n) {
+        atomic_u64_store(&aw->failed, 1);
+    }
+}
+
+// The I/O thread: Drain the ring, and then the spill file, into the stream, until stopped.
+void async_writer_drain(void* arg) {
+    async_writer* aw = arg;
+    u64 tail = 0;
+    u64 unspilled = 0;
+    bool flushed = true;
+    char* chunk = NULL;
+    while (true) {
+        u64 const head = atomic_u64_load(&aw->published_head);
+        if (head != tail) {
+            // The records may wrap around the end of the ring, so this may take two writes.
+            u64 const begin = tail & (aw->capacity - 1);
+            u64 const n = MIN(head - tail, aw->capacity - begin);
+            async_writer_out(aw, aw->ring + begin, (size_t)n);
+            tail += n;
+            atomic_u64_store(&aw->tail, tail);
+            flushed = false;
+            continue;
+        }
+        // The producer only spills while the ring is empty, or holds older records. But it may have written records
+        // into the ring, and then spilled newer ones, since head was read: Those in the ring go first.
+        u64 const spilled = atomic_u64_load(&aw->published_spilled);
+        if (atomic_u64_load(&aw->published_head) != tail) {
+            continue;
+        }
+        if (spilled != unspilled) {
+            chunk = chunk ? chunk : malloc(ASYNC_WRITER_SPILL_CHUNK);
+            // The reader may have hit the end of the file before, but there's more now.
+            clearerr(aw->spill_reader);
+            size_t const n = chunk ? fread(chunk, 1, (size_t)MIN(spilled - unspilled, ASYNC_WRITER_SPILL_CHUNK),
+                                           aw->spill_reader) : 0;
+            if (n == 0) {
+                fprintf(stderr, "[ERROR] Failed to read back spilled output from %s.\n", aw->spill_filename);
+                atomic_u64_store(&aw->failed, 1);
+                break;
+            }
+            async_writer_out(aw, chunk, n);
+            unspilled += n;
+            atomic_u64_store(&aw->unspilled, unspilled);
+            flushed = false;
+            continue;
+        }
+        if (!flushed) {
+            // Caught up: Don't hold the output back from the consumer.
+            if (fflush(aw->stream) != 0) {
+                atomic_u64_store(&aw->failed, 1);
+            }
+            flushed = true;
+        }
+        if (atomic_u64_load(&aw->stop)) {
+            // Everything was written before stop was set, but it may have come in since head and spilled were read.
+            if (atomic_u64_load(&aw->published_head) == tail &&
+                atomic_u64_load(&aw->published_spilled) == unspilled) {
+                break;
+            }
+            continue;
+        }
+        time_sleep_ms(ASYNC_WRITER_IDLE_MS);
+    }
+    free(chunk);
+}
+
+// Start writing to stream through a ring of at least capacity bytes, with the given policy when it's full. With
+// ASYNC_WRITER_SPILL, spill_filename is the file to spill to, which is created when needed, and removed at the end.
+// Return: true on success; false on failure.
+// Notes: If this call is successful, then the caller is responsible for calling async_writer_close(aw).
+bool async_writer_open(async_writer* aw, FILE* stream, size_t capacity, async_writer_policy policy,
+                       char const* spill_filename) {
+    u64 size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    *aw = (async_writer){
+        .stream = stream,
+        .policy = policy,
+        .ring = malloc((size_t)size),
+        .capacity = size,
+        .spill_filename = spill_filename,
+    };
+    if (!aw->ring) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory for the output ring.\n");
+        return false;
+    }
+    if (!thread_start(&aw->io, async_writer_drain, aw)) {
+        fprintf(stderr, "[ERROR] Failed to start a thread to write output.\n");
+        free(aw->ring);
+        *aw = (async_writer){0};
+        return false;
+    }
+    return true;
+}
+
+// Drop a record of len bytes.
+bool async_writer_drop(async_writer* aw, size_t len) {
+    ++aw->dropped;
+    aw->dropped_bytes += len;
+    return false;
+}
+
+// Append a record of len bytes to the spill file, and publish it to the I/O thread.
+bool async_writer_spill(async_writer* aw, char const* p, size_t len) {
+    if (!aw->spill && !aw->spill_failed) {
+        aw->spill = fopen(aw->spill_filename, "wb");
+        aw->spill_reader = aw->spill ? fopen(aw->spill_filename, "rb") : NULL;
+        if (!aw->spill_reader) {
+            fprintf(stderr, "[ERROR] Cannot spill output to %s: %s\n", aw->spill_filename, strerror(errno));
+            if (aw->spill) {
+                fclose(aw->spill);
+                aw->spill = NULL;
+            }
+            aw->spill_failed = true;
+        }
+    }
+    if (aw->spill_failed) {
+        return async_writer_drop(aw, len);
+    }
+    if (fwrite(p, 1, len, aw->spill) != len || fflush(aw->spill) != 0) {
+        // The I/O thread only reads what was published, so a partly written record is never read.
+        fprintf(stderr, "[ERROR] Failed to spill output to %s: %s\n", aw->spill_filename, strerror(errno));
+        aw->spill_failed = true;
+        return async_writer_drop(aw, len);
+    }
+    aw->spilled += len;
+    atomic_u64_store(&aw->published_spilled, aw->spilled);
+    return true;
+}
+
+// Write a record of len bytes from p, which is either written whole, or, if it's dropped, not at all.
+// Return: true if the record was written (or will be); false if it was dropped, or on failure.
+bool async_writer_write(async_writer* aw, char const* p, size_t len) {
+    if (aw->spilling) {
+        if (atomic_u64_load(&aw->unspilled) != aw->spilled) {
+            return async_writer_spill(aw, p, len);
+        }
+        // The I/O thread has caught up, so the ring is empty, too.
+        aw->spilling = false;
+    }
+    while (len > 0) {
+        u64 const room = aw->capacity - (aw->head - atomic_u64_load(&aw->tail));
+        if (room < len && aw->policy == ASYNC_WRITER_DROP) {
+            return async_writer_drop(aw, len);
+        }
+        if (room < len && aw->policy == ASYNC_WRITER_SPILL) {
+            aw->spilling = true;
+            return async_writer_spill(aw, p, len);
+        }
+        if (room == 0) {
+            // ASYNC_WRITER_BLOCK: Wait for the I/O thread.
+            time_sleep_ms(ASYNC_WRITER_IDLE_MS);
+            continue;
+        }
+        // A record larger than the ring is written a part at a time.
+        u64 const n = MIN((u64)len, room);
+        u64 const begin = aw->head & (aw->capacity - 1);
+        u64 const first = MIN(n, aw->capacity - begin);
+        memcpy(aw->ring + begin, p, (size_t)first);
+        memcpy(aw->ring, p + first, (size_t)(n - first));
+        aw->head += n;
+        atomic_u64_store(&aw->published_head, aw->head);
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Wait for everything written to reach the stream, and stop the I/O thread. Report any dropped records.
+// Return: true if all of the output was written; false otherwise.
+bool async_writer_close(async_writer* aw) {
+    atomic_u64_store(&aw->stop, 1);
+    thread_join(&aw->io);
+    bool const ok = !atomic_u64_load(&aw->failed) && aw->dropped == 0;
+    if (aw->dropped > 0) {
+        fprintf(stderr, "[WARNING] Dropped %llu records (%llu bytes) of output, which was written faster than it was "
+                "consumed.\n", (unsigned long long)aw->dropped, (unsigned long long)aw->dropped_bytes);
+    }
+    if (aw->spill) {
+        fclose(aw->spill);
+        fclose(aw->spill_reader);
+        remove(aw->spill_filename);
+    }
+    free(aw->ring);
+    *aw = (async_writer){0};
+    return ok;
+}
+
+
+/**** Arena ****/
+
+// An arena is a region of memory from which objects are allocated by bumping a pointer, and which is freed all at once.
+// The memory comes in a few large blocks, each twice the size of the previous one.
+// A zero-initialized arena is valid and empty: arena ar = {0};
+
+#define ARENA_BLOCK_SIZE_MIN ((size_t)1 << 16)
+#define ARENA_BLOCK_SIZE_MAX ((size_t)1 << 26)
+
+typedef struct arena_block {
+    struct arena_block* prev;
+    size_t size;  // Size of the block in bytes, including this header.
+    size_t used;  // Bytes in use, including this header.
+} arena_block;
+
+typedef struct arena {
+    arena_block* head;  // The block currently being allocated from; NULL if the arena is empty.
+    size_t allocated;  // Total bytes handed out, for statistics.
+} arena;
+
+// Allocate size bytes from ar, suitably aligned for any object.
+// Return: Pointer to the memory; NULL if allocation failed.
+void* arena_alloc(arena* ar, size_t size) {
+    size_t const align = _Alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+    arena_block* block = ar->head;
+    if (!block || block->size - block->used < size) {
+        size_t new_size = block ? MIN(2 * block->size, ARENA_BLOCK_SIZE_MAX) : ARENA_BLOCK_SIZE_MIN;
+        new_size = MAX(new_size, size);
+        // The header's size is a multiple of the alignment, so allocations following it are aligned.
+        size_t const header_size = (sizeof(arena_block) + align - 1) & ~(align - 1);
+        block = (arena_block*)malloc(header_size + new_size);
+        if (!block) {
+            fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+            return NULL;
+        }
+        block->prev = ar->head;
+        block->size = header_size + new_size;
+        block->used = header_size;
+        ar->head = block;
+    }
+    void* p = (char*)block + block->used;
+    block->used += size;
+    ar->allocated += size;
+    return p;
+}
+
+// As arena_alloc(), but the memory is zeroed.
+void* arena_calloc(arena* ar, size_t size) {
+    void* p = arena_alloc(ar, size);
+    if (p) {
+        memset(p, 0, size);
+    }
+    return p;
+}
+
+// Free all memory allocated from ar. After the call, ar is valid and empty.
+void arena_destroy(arena* ar) {
+    arena_block* block = ar->head;
+    while (block) {
+        arena_block* prev = block->prev;
+        free(block);
+        block = prev;
+    }
+    *ar = (arena){0};
+}
+
+
 /**** JSON ****/
 
 
@@ -330,17 +1568,41 @@ static const char json_type_name[JSON_TYPES_COUNT][10] = {
     [JSON_TYPE_NULL] = "null\0",
 };
 
+struct json_value;
+struct json_key_index;
+
+// Bookkeeping for objects and arrays, so that appending a child and counting children take constant time.
+typedef struct json_aggregate {
+    struct json_value* last_child;  // NULL if there are no children.
+    size_t count;  // Number of children.
+    union {
+        // Arrays only: If not NULL, index[i] is the i-th child, so that it can be found in constant time. This is built
+        // at the end of parsing, for arrays of at least JSON_ARRAY_INDEX_MIN_COUNT children.
+        struct json_value** index;
+        // Objects only, if has_key_index: A hash table of the children's names, so that they can be found in constant
+        // time. This is built on the first lookup, for objects of at least JSON_OBJECT_INDEX_MIN_COUNT children.
+        struct json_key_index* key_index;
+        // Objects allocated from an arena only, if !has_key_index: The arena, from which key_index will be allocated.
+        arena* ar;
+    };
+} json_aggregate;
+
 typedef union json_datum {
     buffer string;
     i64 integer;
     f64 floating;
     bool boolean;
+    json_aggregate aggregate;
 } json_datum;
 
 // JSON is stored as a tree with dynamically-allocated values.
 // The root value is a JSON_TYPE_OBJECT with unspecified name.
 typedef struct json_value {
     json_type type;
+    // If true, this value (and its string data) was allocated from an arena, and is freed with the arena rather than by
+    // json_value_destroy(). All values in a tree are allocated the same way.
+    bool in_arena;
+    bool has_key_index;  // See json_aggregate.
     json_datum datum;
     // A value is permitted to have an empty name (e.g., array members, and the root object);
     // in that case, it will have name == NULL. If the name is nonempty, then
@@ -358,64 +1620,59 @@ void repeated_printf(char const* item, u32 repeat) {
     }
 }
 
+// Print v and its siblings, for debugging. Each line begins with the type of its value.
 void json_value_printf(json_value const* v, u8 indent_level) {
-    if (!v) {
-        return;
-    }
-    printf("%c| ", toupper(json_type_name[v->type][0]));
-    repeated_printf("    ", indent_level);
-    if (v->name) {
-        printf("\"");
-        buffer_printf(v->name->datum.string, stdout);
-        printf("\": ");
-    }
-    switch (v->type) {
-    case JSON_TYPE_OBJECT:
-        printf("{\n");
-        if (v->child) {
-            json_value_printf(v->child, indent_level+1);
-        }
-        printf("%c| ", ' ');
+    for (; v; v = v->next) {
+        printf("%c| ", toupper(json_type_name[v->type][0]));
         repeated_printf("    ", indent_level);
-        printf("}");
-        break;
-    case JSON_TYPE_ARRAY:
-        printf("[\n");
-        if (v->child) {
-            json_value_printf(v->child, indent_level+1);
+        if (v->name) {
+            printf("\"");
+            buffer_printf(v->name->datum.string, stdout);
+            printf("\": ");
         }
-        printf("%c| ", ' ');
-        repeated_printf("    ", indent_level);
-        printf("]");
-        break;
-    case JSON_TYPE_STRING:
-        printf("\"");
-        buffer_printf(v->datum.string, stdout);
-        printf("\"");
-        break;
-    case JSON_TYPE_INTEGER:
-        // Cast is required for win32/linux portability.
-        printf("%lld", (long long)v->datum.integer);
-        break;
-    case JSON_TYPE_FLOATING:
-        printf("%.15lg", v->datum.floating);
-        break;
-    case JSON_TYPE_BOOLEAN:
-        printf(v->datum.boolean ? "true" : "false");
-        break;
-    case JSON_TYPE_NULL:
-        printf("null");
-        break;
-    default:
-        fprintf(stderr, "[ERROR] Cannot print: Unhandled type.\n");
-        exit(1);
-        break;
-    }
-    if (v->next) {
-        printf(",\n");
-        json_value_printf(v->next, indent_level);
-    } else {
-        printf("\n");
+        switch (v->type) {
+        case JSON_TYPE_OBJECT:
+            printf("{\n");
+            if (v->child) {
+                json_value_printf(v->child, indent_level+1);
+            }
+            printf("%c| ", ' ');
+            repeated_printf("    ", indent_level);
+            printf("}");
+            break;
+        case JSON_TYPE_ARRAY:
+            printf("[\n");
+            if (v->child) {
+                json_value_printf(v->child, indent_level+1);
+            }
+            printf("%c| ", ' ');
+            repeated_printf("    ", indent_level);
+            printf("]");
+            break;
+        case JSON_TYPE_STRING:
+            printf("\"");
+            buffer_printf(v->datum.string, stdout);
+            printf("\"");
+            break;
+        case JSON_TYPE_INTEGER:
+            // Cast is required for win32/linux portability.
+            printf("%lld", (long long)v->datum.integer);
+            break;
+        case JSON_TYPE_FLOATING:
+            printf("%.15lg", v->datum.floating);
+            break;
+        case JSON_TYPE_BOOLEAN:
+            printf(v->datum.boolean ? "true" : "false");
+            break;
+        case JSON_TYPE_NULL:
+            printf("null");
+            break;
+        default:
+            fprintf(stderr, "[ERROR] Cannot print: Unhandled type.\n");
+            exit(1);
+            break;
+        }
+        printf(v->next ? ",\n" : "\n");
     }
 }
 
@@ -426,43 +1683,114 @@ void json_data_printf(json_data* data) {
     }
 }
 
-json_value* json_value_create(void) {
+// Allocate a zeroed value from ar, or from the heap if ar == NULL.
+json_value* json_value_create(arena* ar) {
+    if (ar) {
+        json_value* value = (json_value*)arena_calloc(ar, sizeof(json_value));
+        if (value) {
+            value->in_arena = true;
+        }
+        return value;
+    }
     return (json_value*)calloc(1, sizeof(json_value));
 }
 
+#define JSON_ARRAY_INDEX_MIN_COUNT 16
+#define JSON_OBJECT_INDEX_MIN_COUNT 16
+
+// An open-addressing hash table (with linear probing) of an object's children's names.
+typedef struct json_key_index {
+    arena* ar;  // The arena that this was allocated from, or NULL if it was allocated from the heap.
+    size_t mask;  // The number of slots, minus one. The number of slots is a power of two, at least twice the count.
+    // 0 if the slot is empty; otherwise, 1 + the ordinal of the first child with some name.
+    u32* slots;
+    struct json_value** children;  // children[i] is the i-th child.
+} json_key_index;
+
+bool json_is_aggregate(json_value const* value) {
+    return value->type == JSON_TYPE_OBJECT || value->type == JSON_TYPE_ARRAY;
+}
+
+// Discard value's index of children, if it has one.
+void json_value_drop_index(json_value* value) {
+    json_aggregate* agg = &value->datum.aggregate;
+    if (value->has_key_index) {
+        // Keep the arena (if any), in case the index is rebuilt.
+        arena* ar = agg->key_index->ar;
+        if (!ar) {
+            free(agg->key_index);
+        }
+        agg->ar = ar;
+        value->has_key_index = false;
+    } else if (value->type == JSON_TYPE_ARRAY) {
+        if (!value->in_arena) {
+            free(agg->index);
+        }
+        agg->index = NULL;
+    }
+}
+
+// Append child to value's children, in constant time.
+// Precondition: value is an object or array (or is being parsed as one).
 void json_value_append_child(json_value* value, json_value* child) {
+    json_aggregate* agg = &value->datum.aggregate;
     if (!value->child) {
         value->child = child;
     } else {
-        json_value* v = value->child;
-        while (v->next) {
-            v = v->next;
-        }
-        v->next = child;
+        agg->last_child->next = child;
     }
+    agg->last_child = child;
+    ++agg->count;
+    json_value_drop_index(value);
 }
 
-// Free (and invalidate) value, including all siblings and children.
-void json_value_destroy(json_value** value) {
-    if (value == NULL || *value == NULL) {
+// Build the index of an array's children, so that json_get_child() takes constant time. If ar != NULL, the index is
+// allocated from ar. The index is an optimization only: if it can't be allocated, the array is left without one.
+void json_array_build_index(json_value* value, arena* ar) {
+    json_aggregate* agg = &value->datum.aggregate;
+    if (agg->index) {
+        json_value_drop_index(value);
+    }
+    size_t const bytes = agg->count * sizeof *agg->index;
+    json_value** index = ar ? (json_value**)arena_alloc(ar, bytes) : (json_value**)malloc(bytes);
+    if (!index) {
         return;
     }
-    if ((*value)->type == JSON_TYPE_STRING) {
-        buffer_destroy(&((*value)->datum.string));
+    size_t i = 0;
+    for (json_value* child = value->child; child; child = child->next) {
+        index[i++] = child;
     }
-    if ((*value)->name) {
-        json_value_destroy(&(*value)->name);
-        (*value)->name = NULL;
+    agg->index = index;
+}
+
+// Free (and invalidate) value, including all siblings and children. Values allocated from an arena are only invalidated;
+// their memory is freed by arena_destroy().
+void json_value_destroy(json_value** value) {
+    if (value == NULL || *value == NULL) {
+        return;
     }
-    if ((*value)->child) {
-        json_value_destroy(&(*value)->child);
-        (*value)->child = NULL;
+    if ((*value)->in_arena) {
+        *value = NULL;
+        return;
     }
-    if ((*value)->next) {
-        json_value_destroy(&(*value)->next);
-        (*value)->next = NULL;
+    // Iterate (rather than recurse) over siblings, since arrays may be very long.
+    json_value* v = *value;
+    while (v) {
+        if (v->type == JSON_TYPE_STRING) {
+            buffer_destroy(&v->datum.string);
+        } else if (json_is_aggregate(v)) {
+            json_value_drop_index(v);
+        }
+        if (v->name) {
+            json_value_destroy(&v->name);
+        }
+        if (v->child) {
+            json_value_destroy(&v->child);
+        }
+        json_value* next = v->next;
+        free(v);
+        v = next;
     }
-    free(*value);
     *value = NULL;
 }
 
@@ -470,6 +1798,9 @@ void json_value_destroy_all_children(json_value* value) {
     // Subsequent children are siblings of first child, so it suffices to destroy the first child.
     if (value) {
         json_value_destroy(&(value->child));
+        json_value_drop_index(value);
+        value->datum.aggregate.last_child = NULL;
+        value->datum.aggregate.count = 0;
     }
 }
 
@@ -478,35 +1809,150 @@ void json_data_destroy(json_data* data) {
 }
 
 size_t json_count_children(json_value const* jv) {
-    json_value *child = jv->child;
-    size_t result = 0;
-    while (child) {
-        ++result;
+    return json_is_aggregate(jv) ? jv->datum.aggregate.count : 0;
+}
+
+// Return the i-th child of jv (an object or array), or NULL if there's no such child.
+// Takes constant time for arrays and objects with an index (see json_array_build_index() and json_object_key_index());
+// otherwise, linear time.
+json_value* json_get_child(json_value const* jv, size_t i) {
+    if (!jv || !json_is_aggregate(jv) || i >= jv->datum.aggregate.count) {
+        return NULL;
+    }
+    if (jv->type == JSON_TYPE_ARRAY && jv->datum.aggregate.index) {
+        return jv->datum.aggregate.index[i];
+    }
+    if (jv->has_key_index) {
+        return jv->datum.aggregate.key_index->children[i];
+    }
+    json_value* child = jv->child;
+    while (i--) {
         child = child->next;
     }
-    return result;
+    return child;
 }
 
-json_value* json_find_child(json_value const* jv, char const* name) {
-    if (!jv) {
+// FNV-1a, one character at a time, so that the hashes of all of a string's prefixes can be found in one pass.
+#define JSON_KEY_HASH_INITIAL 2166136261u
+u32 json_key_hash_step(u32 hash, char ch) {
+    return (hash ^ (u8)ch) * 16777619u;
+}
+
+u32 json_key_hash(char const* key, size_t len) {
+    u32 hash = JSON_KEY_HASH_INITIAL;
+    for (size_t i = 0; i < len; ++i) {
+        hash = json_key_hash_step(hash, key[i]);
+    }
+    return hash;
+}
+
+// Return the ordinal of the first child named exactly key[0..len), whose hash is hash, or SIZE_MAX if there's none.
+size_t json_key_index_find(json_key_index const* index, u32 hash, char const* key, size_t len) {
+    for (size_t slot = hash & index->mask; index->slots[slot]; slot = (slot + 1) & index->mask) {
+        size_t const i = index->slots[slot] - 1;
+        buffer const* name = &index->children[i]->name->datum.string;
+        if (name->len == len && (len == 0 || memcmp(name->p, key, len) == 0)) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Build the hash index of an object's children's names. The index is an optimization only: if it can't be allocated,
+// the object is left without one.
+void json_object_build_key_index(json_value* value) {
+    json_aggregate* agg = &value->datum.aggregate;
+    arena* const ar = value->in_arena ? agg->ar : NULL;
+    if ((value->in_arena && !ar) || agg->count > UINT32_MAX / 4) {
+        return;
+    }
+    size_t slot_count = 1;
+    while (slot_count < 2 * agg->count) {
+        slot_count *= 2;
+    }
+    // Allocate everything at once: the header, then the children, then the slots.
+    size_t const bytes = sizeof(json_key_index) + agg->count * sizeof(json_value*) + slot_count * sizeof(u32);
+    json_key_index* index = ar ? (json_key_index*)arena_calloc(ar, bytes) : (json_key_index*)calloc(1, bytes);
+    if (!index) {
+        return;
+    }
+    index->ar = ar;
+    index->mask = slot_count - 1;
+    index->children = (json_value**)(index + 1);
+    index->slots = (u32*)(index->children + agg->count);
+    u32 i = 0;
+    for (json_value* child = value->child; child; child = child->next, ++i) {
+        index->children[i] = child;
+        if (!child->name) {
+            continue;
+        }
+        buffer const* name = &child->name->datum.string;
+        u32 const hash = json_key_hash(name->p, name->len);
+        if (json_key_index_find(index, hash, name->p, name->len) != SIZE_MAX) {
+            continue;  // Only the first child with each name is found.
+        }
+        size_t slot = hash & index->mask;
+        while (index->slots[slot]) {
+            slot = (slot + 1) & index->mask;
+        }
+        index->slots[slot] = i + 1;
+    }
+    agg->key_index = index;
+    value->has_key_index = true;
+}
+
+// Return jv's key index, building it first if jv is a large enough object; or NULL if it has none.
+// Notes: Building the index doesn't change jv's contents, but does write to it. So, concurrent lookups in the same tree
+// aren't safe.
+json_key_index const* json_object_key_index(json_value const* jv) {
+    if (jv->type != JSON_TYPE_OBJECT || jv->datum.aggregate.count < JSON_OBJECT_INDEX_MIN_COUNT) {
         return NULL;
     }
-    json_value *child = jv->child;
-    while (child) {
-        if (buffer_eq(&child->name->datum.string, name)) {
-            return child;
-        } else {
+    if (!jv->has_key_index) {
+        json_object_build_key_index((json_value*)jv);
+    }
+    return jv->has_key_index ? jv->datum.aggregate.key_index : NULL;
+}
+
+// Return the first child of jv whose name matches name, or NULL if there's none.
+// A child's name matches if it's a prefix of name (see buffer_eq()). So, with an index, each prefix is looked up.
+json_value* json_find_first_child(json_value const* jv, char const* name) {
+    json_key_index const* index = json_object_key_index(jv);
+    if (!index) {
+        json_value *child = jv->child;
+        while (child && !buffer_eq(&child->name->datum.string, name)) {
             child = child->next;
         }
+        return child;
     }
-    return NULL;
+    size_t first = SIZE_MAX;
+    u32 hash = JSON_KEY_HASH_INITIAL;
+    for (size_t len = 0; ; ++len) {
+        size_t const i = json_key_index_find(index, hash, name, len);
+        if (i < first) {
+            first = i;
+        }
+        if (!name[len]) {
+            break;
+        }
+        hash = json_key_hash_step(hash, name[len]);
+    }
+    return first == SIZE_MAX ? NULL : index->children[first];
+}
+
+json_value* json_find_child(json_value const* jv, char const* name) {
+    if (!jv) {
+        return NULL;
+    }
+    return json_find_first_child(jv, name);
 }
 
 json_value* json_find_child_of_type(json_value const* jv, char const* name, json_type type) {
     if (!jv) {
         return NULL;
     }
-    json_value *child = jv->child;
+    // Continue from the first child with the name, in case there are several, of different types.
+    json_value *child = json_find_first_child(jv, name);
     while (child) {
         if (buffer_eq(&child->name->datum.string, name) && child->type == type) {
             return child;
@@ -518,8 +1964,361 @@ json_value* json_find_child_of_type(json_value const* jv, char const* name, json
 }
 
 
-// Consume a single character ch, if it is at offset. If the incorrect character is found, or if offset is the end of
-// the buffer, return false. Otherwise, increment offset and return true.
+// Parsing happens in two stages, as in simdjson. Stage 1 scans the whole buffer, many bytes at a time, for the positions
+// of its tokens, recording them in a tape. Stage 2 (json_parse_value(), etc.) builds the tree, using the tape to skip
+// whitespace and to find the ends of strings without examining every byte.
+//
+// The tape holds, in increasing order, the offset of every:
+//   - structural character ('{', '}', '[', ']', ':', ',') outside of strings;
+//   - unescaped '"' (which opens or closes a string);
+//   - first character of a run of other non-whitespace characters outside of strings (e.g., a number, or 'true').
+// So, outside of strings, every non-whitespace character which isn't on the tape continues a run whose first character
+// is. A '"' is escaped if it follows an odd number of consecutive '\'s.
+
+// Which implementation of stage 1 to use. JSON_SCANNER_BEST is the fastest one this processor supports; the others
+// exist for testing and benchmarking.
+typedef enum json_scanner {
+    JSON_SCANNER_BEST,
+    JSON_SCANNER_SCALAR,  // One byte at a time; available everywhere.
+    JSON_SCANNER_SSE2,  // 64 bytes at a time, 16 per instruction; x86-64 only.
+    JSON_SCANNER_AVX2,  // 64 bytes at a time, 32 per instruction; x86-64 processors with AVX2 only.
+    JSON_SCANNERS_COUNT
+} json_scanner;
+
+static const char json_scanner_name[JSON_SCANNERS_COUNT][8] = {
+    [JSON_SCANNER_BEST] = "best",
+    [JSON_SCANNER_SCALAR] = "scalar",
+    [JSON_SCANNER_SSE2] = "sse2",
+    [JSON_SCANNER_AVX2] = "avx2",
+};
+
+// The scanner used by json_read_from_buffer() and json_read_from_file().
+json_scanner json_scanner_selected = JSON_SCANNER_BEST;
+
+bool json_scanner_available(json_scanner scanner) {
+    switch (scanner) {
+    case JSON_SCANNER_BEST:
+    case JSON_SCANNER_SCALAR:
+        return true;
+    case JSON_SCANNER_SSE2:
+#ifdef UTIL_X86_64
+        return true;
+#else
+        return false;
+#endif
+    case JSON_SCANNER_AVX2:
+#ifdef UTIL_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+json_scanner json_scanner_best(void) {
+    if (json_scanner_available(JSON_SCANNER_AVX2)) {
+        return JSON_SCANNER_AVX2;
+    } else if (json_scanner_available(JSON_SCANNER_SSE2)) {
+        return JSON_SCANNER_SSE2;
+    }
+    return JSON_SCANNER_SCALAR;
+}
+
+typedef struct json_tape {
+    // offsets[0..count) are the offsets of the buffer's tokens, in increasing order. offsets[count] == buf.len is a
+    // sentinel, so that looking past the last token finds the end of the buffer.
+    u32* offsets;
+    size_t count;
+    size_t count_max;  // Allocated length of offsets, excluding the sentinel.
+    size_t next;  // Stage 2's position in the tape: every token before offsets[next] has been consumed.
+} json_tape;
+
+void json_tape_destroy(json_tape* tape) {
+    free(tape->offsets);
+    *tape = (json_tape){0};
+}
+
+// Make room for at least n more offsets (and the sentinel).
+bool json_tape_reserve(json_tape* tape, size_t n) {
+    if (tape->count + n <= tape->count_max) {
+        return true;
+    }
+    size_t count_max = MAX(tape->count_max * 2, tape->count + n);
+    u32* offsets = (u32*)realloc(tape->offsets, (count_max + 1) * sizeof *offsets);
+    if (!offsets) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+        return false;
+    }
+    tape->offsets = offsets;
+    tape->count_max = count_max;
+    return true;
+}
+
+// Consume the tokens before offset, and return the offset of the next token (or the end of the buffer, if there are no
+// more tokens).
+size_t json_tape_seek(json_tape* tape, size_t offset) {
+    while (tape->offsets[tape->next] < offset) {
+        ++tape->next;
+    }
+    return tape->offsets[tape->next];
+}
+
+// The characters that json_parse_eat_whitespaces() eats. Same as isspace() in the "C" locale.
+bool json_is_whitespace(char ch) {
+    return ch == ' ' || ('\t' <= ch && ch <= '\r');
+}
+
+bool json_is_structural(char ch) {
+    return ch == '{' || ch == '}' || ch == '[' || ch == ']' || ch == ':' || ch == ',';
+}
+
+// Stage 1, one byte at a time.
+bool json_tape_scan_scalar(buffer buf, json_tape* tape) {
+    bool in_string = false;
+    bool escape = false;
+    bool in_run = false;
+    for (size_t block = 0; block < buf.len; block += 64) {
+        if (!json_tape_reserve(tape, 64)) {
+            return false;
+        }
+        size_t const block_end = MIN(block + 64, buf.len);
+        for (size_t i = block; i < block_end; ++i) {
+            char const ch = buf.p[i];
+            // Like the vectorized scanners, count backslashes outside of strings, too. (They aren't valid JSON there.)
+            bool const quote = ch == '"' && !escape;
+            escape = ch == '\\' && !escape;
+            if (in_string) {
+                if (quote) {
+                    tape->offsets[tape->count++] = (u32)i;
+                    in_string = false;
+                }
+            } else if (quote || json_is_structural(ch)) {
+                tape->offsets[tape->count++] = (u32)i;
+                in_string = quote;
+                in_run = false;
+            } else if (json_is_whitespace(ch)) {
+                in_run = false;
+            } else if (!in_run) {
+                tape->offsets[tape->count++] = (u32)i;
+                in_run = true;
+            }
+        }
+    }
+    return true;
+}
+
+// Stage 1, 64 bytes at a time: the vectorized scanners classify the bytes of a block into bitmasks (bit i describes
+// byte i), from which the tokens are found with bitwise arithmetic.
+
+typedef struct json_block {
+    u64 quote;
+    u64 backslash;
+    u64 structural;
+    u64 whitespace;
+} json_block;
+
+// Characters which follow an odd-length run of backslashes, and so are escaped. The run may have begun in a previous
+// block; *carry records whether one ends this block at odd length. (See simdjson's find_odd_backslash_sequences().)
+u64 json_block_escaped(u64 backslash, u64* carry) {
+    u64 const even_bits = 0x5555555555555555ull;
+    u64 const odd_bits = ~even_bits;
+    u64 const start_edges = backslash & ~(backslash << 1);
+    u64 const even_start_mask = even_bits ^ *carry;
+    u64 const even_starts = start_edges & even_start_mask;
+    u64 const odd_starts = start_edges & ~even_start_mask;
+    u64 const even_carries = backslash + even_starts;
+    u64 odd_carries = backslash + odd_starts;
+    bool const ends_odd = odd_carries < backslash;  // Overflow: the run continues into the next block.
+    odd_carries |= *carry;
+    *carry = ends_odd ? 1 : 0;
+    u64 const even_carry_ends = even_carries & ~backslash;
+    u64 const odd_carry_ends = odd_carries & ~backslash;
+    return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+}
+
+// Bit i of the result is the XOR of bits 0..i of x.
+u64 json_prefix_xor(u64 x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+u32 json_count_trailing_zeros(u64 x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctzll(x);
+#endif
+}
+
+// State carried between blocks.
+typedef struct json_block_carry {
+    u64 escaped;  // 1 if the first byte of the next block is escaped.
+    u64 in_string;  // All ones if the next block begins inside a string.
+    u64 in_run;  // 1 if the last byte of the previous block was part of a run.
+} json_block_carry;
+
+// Append the tokens of the block at offset to the tape.
+void json_block_tokens(json_block const* block, json_block_carry* carry, size_t offset, json_tape* tape) {
+    u64 const quote = block->quote & ~json_block_escaped(block->backslash, &carry->escaped);
+    // From each opening quote (inclusive) to its closing quote (exclusive).
+    u64 const in_string = json_prefix_xor(quote) ^ carry->in_string;
+    carry->in_string = (u64)0 - (in_string >> 63);
+    u64 const structural = block->structural & ~in_string;
+    u64 const run = ~(block->structural | block->whitespace | quote | in_string);
+    u64 const run_start = run & ~((run << 1) | carry->in_run);
+    carry->in_run = run >> 63;
+    u64 tokens = structural | quote | run_start;
+    while (tokens) {
+        tape->offsets[tape->count++] = (u32)(offset + json_count_trailing_zeros(tokens));
+        tokens &= tokens - 1;
+    }
+}
+
+#ifdef UTIL_X86_64
+u64 json_movemask_sse2(__m128i const v[4]) {
+    return (u64)(u32)_mm_movemask_epi8(v[0])
+        | ((u64)(u32)_mm_movemask_epi8(v[1]) << 16)
+        | ((u64)(u32)_mm_movemask_epi8(v[2]) << 32)
+        | ((u64)(u32)_mm_movemask_epi8(v[3]) << 48);
+}
+
+void json_block_classify_sse2(char const* p, json_block* block) {
+    __m128i quote[4], backslash[4], structural[4], whitespace[4];
+    for (int i = 0; i < 4; ++i) {
+        __m128i const v = _mm_loadu_si128((__m128i const*)(p + 16*i));
+        quote[i] = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+        backslash[i] = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+        structural[i] = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v, _mm_set1_epi8('}'))),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('[')), _mm_cmpeq_epi8(v, _mm_set1_epi8(']')))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        // ' ', or '\t' through '\r'. (The comparisons are signed, so bytes >= 0x80 aren't whitespace.)
+        whitespace[i] = _mm_or_si128(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+            _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1))));
+    }
+    block->quote = json_movemask_sse2(quote);
+    block->backslash = json_movemask_sse2(backslash);
+    block->structural = json_movemask_sse2(structural);
+    block->whitespace = json_movemask_sse2(whitespace);
+}
+#endif
+
+#ifdef UTIL_AVX2
+__attribute__((target("avx2")))
+u64 json_movemask_avx2(__m256i lo, __m256i hi) {
+    return (u64)(u32)_mm256_movemask_epi8(lo) | ((u64)(u32)_mm256_movemask_epi8(hi) << 32);
+}
+
+__attribute__((target("avx2")))
+void json_block_classify_avx2(char const* p, json_block* block) {
+    __m256i quote[2], backslash[2], structural[2], whitespace[2];
+    for (int i = 0; i < 2; ++i) {
+        __m256i const v = _mm256_loadu_si256((__m256i const*)(p + 32*i));
+        quote[i] = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+        backslash[i] = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+        structural[i] = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(']')))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        whitespace[i] = _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+            _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                             _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v)));
+    }
+    block->quote = json_movemask_avx2(quote[0], quote[1]);
+    block->backslash = json_movemask_avx2(backslash[0], backslash[1]);
+    block->structural = json_movemask_avx2(structural[0], structural[1]);
+    block->whitespace = json_movemask_avx2(whitespace[0], whitespace[1]);
+}
+#endif
+
+void json_block_classify(json_scanner scanner, char const* p, json_block* block) {
+    switch (scanner) {
+#ifdef UTIL_AVX2
+    case JSON_SCANNER_AVX2:
+        json_block_classify_avx2(p, block);
+        break;
+#endif
+#ifdef UTIL_X86_64
+    case JSON_SCANNER_SSE2:
+        json_block_classify_sse2(p, block);
+        break;
+#endif
+    default:
+        fprintf(stderr, "[ERROR] Unhandled JSON scanner %s.\n", json_scanner_name[scanner]);
+        exit(1);
+        break;
+    }
+}
+
+// Stage 1, 64 bytes at a time.
+bool json_tape_scan_blocks(buffer buf, json_scanner scanner, json_tape* tape) {
+    json_block_carry carry = {0};
+    json_block block;
+    size_t offset = 0;
+    for (; offset + 64 <= buf.len; offset += 64) {
+        if (!json_tape_reserve(tape, 64)) {
+            return false;
+        }
+        json_block_classify(scanner, buf.p + offset, &block);
+        json_block_tokens(&block, &carry, offset, tape);
+    }
+    if (offset < buf.len) {
+        // Pad the last, partial block with whitespace, which adds no tokens.
+        char last[64];
+        memset(last, ' ', sizeof last);
+        memcpy(last, buf.p + offset, buf.len - offset);
+        if (!json_tape_reserve(tape, 64)) {
+            return false;
+        }
+        json_block_classify(scanner, last, &block);
+        json_block_tokens(&block, &carry, offset, tape);
+    }
+    return true;
+}
+
+// Run stage 1 over buf, with the given scanner, writing the tape into tape (which must be zeroed).
+// Return: true on success; false if there's an error.
+// Notes: If this call is successful, then the caller is responsible for calling json_tape_destroy(tape).
+bool json_tape_build(buffer buf, json_scanner scanner, json_tape* tape) {
+    if (buf.len > UINT32_MAX) {
+        fprintf(stderr, "[ERROR] JSON data larger than 4 GiB is not supported.\n");
+        return false;
+    }
+    if (scanner == JSON_SCANNER_BEST) {
+        scanner = json_scanner_best();
+    }
+    if (!json_scanner_available(scanner)) {
+        fprintf(stderr, "[ERROR] JSON scanner %s isn't available on this processor.\n", json_scanner_name[scanner]);
+        return false;
+    }
+    // JSON is typically about one-eighth tokens; json_tape_reserve() grows the tape if there are more.
+    bool ok = json_tape_reserve(tape, buf.len / 8 + 64)
+        && (scanner == JSON_SCANNER_SCALAR ? json_tape_scan_scalar(buf, tape)
+                                           : json_tape_scan_blocks(buf, scanner, tape));
+    if (!ok) {
+        json_tape_destroy(tape);
+        return false;
+    }
+    tape->offsets[tape->count] = (u32)buf.len;
+    tape->next = 0;
+    return true;
+}
+
+
+// Consume a single character ch, if it is at offset. If the incorrect character is found, or if offset is the end of
+// the buffer, return false. Otherwise, increment offset and return true.
 bool json_parse_eat_char(
     buffer buf,
     size_t* offset,
@@ -571,25 +2370,31 @@ bool json_parse_eat_string(
 // *new_offset == buf.len after the call (if only whitespace is found).
 void json_parse_eat_whitespaces(
     buffer buf,
-    size_t* offset
+    size_t* offset,
+    json_tape* tape
     ) {
-    while (*offset < buf.len && isspace(buf.p[*offset])) {
-        ++(*offset);
+    if (*offset < buf.len && !json_is_whitespace(buf.p[*offset])) {
+        return;
     }
+    // The whitespace runs until the next token.
+    *offset = json_tape_seek(tape, *offset);
 }
 
 bool json_parse_value(
     buffer buf,
     size_t* offset,
+    json_tape* tape,
     json_value* value,
-    bool expect_name);
+    bool expect_name,
+    arena* ar);
 
 bool json_parse_value_null(
     buffer buf,
     size_t* offset,
+    json_tape* tape,
     json_value* value
     ) {
-    json_parse_eat_whitespaces(buf, offset);
+    json_parse_eat_whitespaces(buf, offset, tape);
     if (!json_parse_eat_string(buf, offset, "null")) {
         fprintf(stderr, "[ERROR] Bad parse: Invalid 'null' at offset %zu.\n", *offset);
         return false;
@@ -601,9 +2406,10 @@ bool json_parse_value_null(
 bool json_parse_value_boolean(
     buffer buf,
     size_t* offset,
+    json_tape* tape,
     json_value* value
     ) {
-    json_parse_eat_whitespaces(buf, offset);
+    json_parse_eat_whitespaces(buf, offset, tape);
     if (*offset >= buf.len) {
         fprintf(stderr, "[ERROR] Bad parse: Buffer overrun.\n");
         return false;
@@ -631,30 +2437,98 @@ bool json_parse_value_boolean(
     return true;
 }
 
-bool json_parse_value_string(
-    buffer buf,
-    size_t* offset,
-    json_value* value
-    ) {
-    json_parse_eat_whitespaces(buf, offset);
-    if (!json_parse_eat_char(buf, offset, '"')) {
-        fprintf(stderr, "[ERROR] Bad parse: Invalid string at offset %zu.\n", *offset);
+// Read the 4 hex digits of a Unicode escape sequence from p[0..4), which must be before end.
+// Return: true on success; false if there aren't 4 hex digits.
+bool json_unescape_hex4(char const* p, char const* end, u32* code_unit) {
+    if (end - p < 4) {
         return false;
     }
+    u32 v = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        u8 const ch = (u8)p[i];
+        u32 const digit = ('0' <= ch && ch <= '9') ? (u32)(ch - '0')
+            : ('a' <= (ch | 0x20) && (ch | 0x20) <= 'f') ? (u32)((ch | 0x20) - 'a' + 10) : 16;
+        if (digit == 16) {
+            return false;
+        }
+        v = (v << 4) | digit;
+    }
+    *code_unit = v;
+    return true;
+}
 
-    size_t offset_new = *offset;
-    char* ch = buf.p + offset_new;
-    buffer str = buffer_create("");
-    bool escape = false;
-    while (offset_new < buf.len && (*ch != '"' || escape)) {
-        if (str.len == str.len_max) {
-            if (!buffer_expand(&str)) {
-                fprintf(stderr, "[ERROR] Bad parse: Failed to allocate memory at offset %zu.\n", *offset);
-                buffer_destroy(&str);
+// Write code_point to dst in UTF-8.
+// Return: The number of bytes written (1 to 4).
+size_t utf8_encode(u32 code_point, char* dst) {
+    if (code_point < 0x80) {
+        dst[0] = (char)code_point;
+        return 1;
+    }
+    if (code_point < 0x800) {
+        dst[0] = (char)(0xC0 | (code_point >> 6));
+        dst[1] = (char)(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if (code_point < 0x10000) {
+        dst[0] = (char)(0xE0 | (code_point >> 12));
+        dst[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+        dst[2] = (char)(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    dst[0] = (char)(0xF0 | (code_point >> 18));
+    dst[1] = (char)(0x80 | ((code_point >> 12) & 0x3F));
+    dst[2] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+    dst[3] = (char)(0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+// Decode the escape sequences in the contents of a string, src[0..src_len) (excluding the quotes), into dst, which must
+// have room for src_len characters, and may be src itself. Write the decoded length into dst_len. offset is the position
+// of src, for error messages. Unicode escape sequences are decoded to UTF-8, with unpaired surrogates replaced by
+// U+FFFD.
+// Return: true on success; false if there's an invalid escape sequence.
+bool json_unescape(char const* src, size_t src_len, char* dst, size_t* dst_len, size_t offset) {
+    char const* ch = src;
+    char const* const ch_end = src + src_len;
+    size_t len = 0;
+    while (ch < ch_end) {
+        // Copy everything up to the next backslash at once.
+        char const* backslash = (char const*)memchr(ch, '\\', (size_t)(ch_end - ch));
+        size_t const literal_len = (size_t)((backslash ? backslash : ch_end) - ch);
+        if (literal_len > 0) {
+            memmove(dst + len, ch, literal_len);
+            len += literal_len;
+            ch += literal_len;
+        }
+        if (!backslash) {
+            break;
+        }
+        // A backslash can't be the last character of the string, or else it would have escaped the closing '"'.
+        ++ch;
+        if (*ch == 'u') {
+            // Decode a code point, which is written in UTF-16: Anything past the BMP as a surrogate pair.
+            u32 code_point = 0;
+            if (!json_unescape_hex4(ch + 1, ch_end, &code_point)) {
+                fprintf(stderr, "[ERROR] Bad parse: Invalid escape sequence '\\u' at offset %zu.\n", offset);
                 return false;
             }
-        }
-        if (escape) {
+            ch += 5;
+            if (0xD800 <= code_point && code_point < 0xDC00) {
+                u32 low = 0;
+                if (ch_end - ch >= 6 && ch[0] == '\\' && ch[1] == 'u' && json_unescape_hex4(ch + 2, ch_end, &low)
+                    && 0xDC00 <= low && low < 0xE000) {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    ch += 6;
+                } else {
+                    code_point = 0xFFFD;
+                }
+            } else if (0xDC00 <= code_point && code_point < 0xE000) {
+                code_point = 0xFFFD;
+            }
+            // The encoding (at most 4 bytes) is never longer than the escape sequence (6 or 12 characters), so dst
+            // never overtakes src.
+            len += utf8_encode(code_point, dst + len);
+        } else {
             char escaped_ch = {0};
             switch (*ch) {
             case '"': escaped_ch = '"'; break;
@@ -665,38 +2539,60 @@ bool json_parse_value_string(
             case 'n': escaped_ch = '\n'; break;
             case 'r': escaped_ch = '\r'; break;
             case 't': escaped_ch = '\t'; break;
-            case 'u':
-                // TODO Handle Unicode escape sequences correctly.
-                escaped_ch = 'U';
-                break;
             default:
-                fprintf(stderr, "[ERROR] Bad parse: Invalid escape sequence '\\%c' at offset %zu.\n", *ch, *offset);
-                buffer_destroy(&str);
-                return false;                
+                fprintf(stderr, "[ERROR] Bad parse: Invalid escape sequence '\\%c' at offset %zu.\n", *ch, offset);
+                return false;
                 break;
             }
-            str.p[str.len++] = escaped_ch;
-            escape = false;
-        } else if (*ch == '\\'
-                   // TODO This is to ignore unicode escape sequences:
-                   && (offset_new + 1 < buf.len)
-                   && *(ch+1) != 'u') {
-            escape = true;
-        } else {
-            str.p[str.len++] = *ch;
+            dst[len++] = escaped_ch;
+            ++ch;
         }
-        ++ch;
-        ++offset_new;
     }
-    if (offset_new == buf.len) {
+    *dst_len = len;
+    return true;
+}
+
+bool json_parse_value_string(
+    buffer buf,
+    size_t* offset,
+    json_tape* tape,
+    json_value* value,
+    arena* ar
+    ) {
+    json_parse_eat_whitespaces(buf, offset, tape);
+    if (!json_parse_eat_char(buf, offset, '"')) {
+        fprintf(stderr, "[ERROR] Bad parse: Invalid string at offset %zu.\n", *offset);
+        return false;
+    }
+
+    // Find the terminating '"' (or buf.len, if the string is unterminated). Nothing inside a string is a token, so the
+    // opening '"' is followed on the tape by the terminating one.
+    size_t const end = json_tape_seek(tape, *offset);
+    if (end == buf.len) {
         fprintf(stderr, "[ERROR] Bad parse: Unterminated string at offset %zu.\n", *offset);
         return false;
-    } else if (!json_parse_eat_char(buf, &offset_new, '"')) {
-        fprintf(stderr, "[ERROR] Bad parse: Bad string terminator at offset %zu.\n", *offset);
+    }
+
+    // The decoded string is no longer than the encoded one, so allocate that much, once.
+    size_t const len_max = end - *offset;
+    buffer str = {0, 0, NULL};
+    if (len_max > 0) {
+        str.p = ar ? (char*)arena_alloc(ar, len_max) : (char*)malloc(len_max);
+        if (!str.p) {
+            fprintf(stderr, "[ERROR] Bad parse: Failed to allocate memory at offset %zu.\n", *offset);
+            return false;
+        }
+        str.len_max = len_max;
+    }
+
+    if (!json_unescape(buf.p + *offset, len_max, str.p, &str.len, *offset)) {
+        if (!ar) {
+            buffer_destroy(&str);
+        }
         return false;
     }
 
-    *offset = offset_new;
+    *offset = end + 1;  // Eat the terminating '"'.
     value->datum.string = str;
     value->type = JSON_TYPE_STRING;
     return true;
@@ -705,12 +2601,14 @@ bool json_parse_value_string(
 bool json_parse_value_aggregate(
     buffer buf,
     size_t* offset,
+    json_tape* tape,
     json_value* value,
     json_type type,
     char opener,
-    char closer
+    char closer,
+    arena* ar
     ) {
-    json_parse_eat_whitespaces(buf, offset);
+    json_parse_eat_whitespaces(buf, offset, tape);
     if (!json_parse_eat_char(buf, offset, opener)) {
         fprintf(stderr,
                 "[ERROR] Bad parse: Could not find correct aggregate opener '%c' at offzet %zu.\n",
@@ -723,7 +2621,7 @@ bool json_parse_value_aggregate(
     bool got_comma = false;
     bool failure = false;
     while (true) {
-        json_parse_eat_whitespaces(buf, &offset_new);
+        json_parse_eat_whitespaces(buf, &offset_new, tape);
         if (offset_new >= buf.len) {
             fprintf(stderr, "[ERROR] Bad parse: Unexpected end-of-buffer.\n");
             failure = true;
@@ -758,11 +2656,16 @@ bool json_parse_value_aggregate(
                 failure = true;
                 break;
             }
-            json_value *child = json_value_create();
+            json_value *child = json_value_create(ar);
+            if (!child) {
+                fprintf(stderr, "[ERROR] Bad parse: Failed to allocate memory at offset %zu.\n", offset_new);
+                failure = true;
+                break;
+            }
             json_value_append_child(value, child);
             // Objects' ({...}) children are named; arrays' ([...]) children are not.
             bool expect_name = type == JSON_TYPE_OBJECT;
-            if (!json_parse_value(buf, &offset_new, child, expect_name)) {
+            if (!json_parse_value(buf, &offset_new, tape, child, expect_name, ar)) {
                 fprintf(stderr, "[ERROR] Bad parse: Could not parse value at offset %zu.\n", offset_new);
                 failure = true;
                 break;
@@ -777,6 +2680,11 @@ bool json_parse_value_aggregate(
     } else {
         *offset = offset_new;
         value->type = type;
+        if (type == JSON_TYPE_ARRAY && value->datum.aggregate.count >= JSON_ARRAY_INDEX_MIN_COUNT) {
+            json_array_build_index(value, ar);
+        } else if (type == JSON_TYPE_OBJECT) {
+            value->datum.aggregate.ar = ar;  // For json_object_build_key_index().
+        }
         return true;
     }
 }
@@ -784,138 +2692,406 @@ bool json_parse_value_aggregate(
 bool json_parse_value_object(
     buffer buf,
     size_t* offset,
-    json_value* value
+    json_tape* tape,
+    json_value* value,
+    arena* ar
     ) {
-    return json_parse_value_aggregate(buf, offset, value, JSON_TYPE_OBJECT, '{', '}');
+    return json_parse_value_aggregate(buf, offset, tape, value, JSON_TYPE_OBJECT, '{', '}', ar);
 }
 
 bool json_parse_value_array(
     buffer buf,
     size_t* offset,
-    json_value* value
+    json_tape* tape,
+    json_value* value,
+    arena* ar
     ) {
-    return json_parse_value_aggregate(buf, offset, value, JSON_TYPE_ARRAY, '[', ']');
+    return json_parse_value_aggregate(buf, offset, tape, value, JSON_TYPE_ARRAY, '[', ']', ar);
 }
 
-bool json_parse_value_number(
-    buffer buf,
-    size_t* offset,
-    json_value* value
-    ) {
-    json_parse_eat_whitespaces(buf, offset);
-    size_t offset_new = *offset;
-    bool negate = false;
-    bool got_digit = false;
-    bool is_floating = false;
-    bool got_digit_after_point = false;
-    i64 integer = 0;
-    u8 fractional_digits = 0;
-
-    // Parse the number.
-    while (offset_new < buf.len) {
-        char ch = buf.p[offset_new];
-        if (!got_digit && !negate && '-' == ch) {
-            negate = true;
-        } else if (got_digit && '.' == ch) {
-            if (is_floating == true) {
-                fprintf(stderr, "[ERROR] Bad parse: Too many decimal points at offset %zu.\n", offset_new);
-                return false;
-            }
-            is_floating = true;
-        } else if ('0' <= ch && ch <= '9') {
-            // Non-conformant to spec: Sequences starting with '0' but not with '0.' will be accepted as integers.
-            // Sloppy: A handful of almost-maximal integers can fit in an i64, but will be rejected.
-            if (integer > (INT64_MAX - (i64)9) / (i64)10) {
-                if (!is_floating) {
-                    fprintf(stderr, "[ERROR] Bad parse: Integer overflow at offset %zu.\n", offset_new);
-                    return false;
-                } else {
-                    fprintf(stderr, "[WARNING] Ignoring high-precision digits at offset %zu.\n", offset_new);
-                }
-            } else {
-                integer = 10*integer + (ch - '0');
-                got_digit = true;
-                if (is_floating) {
-                    ++fractional_digits;
-                    got_digit_after_point = true;
-                }
-            }
-        } else {
-            // UNIMPLEMENTED: Exponential notation for JSON numbers.
-            // This ch is not part of this number token (e.g., ch is whitespace, a comma, or a closing brace).
+/* Decimal to binary floating point.
+ *
+ * A JSON number is w * 10^q for an integer w of its digits (the significand) and an exponent q. Converting it to the
+ * nearest f64 takes one of three paths, from fastest to slowest:
+ *
+ *  1. Clinger's fast path: If w and 10^|q| are both exactly representable, then one correctly rounded multiplication or
+ *     division gives the answer.
+ *  2. Eisel-Lemire: Multiply w by a 128-bit approximation of 5^q (from pow5_table.h), and keep the top bits. If w has at
+ *     most 19 digits, this is always correctly rounded (see Lemire, "Number Parsing at a Gigabyte per Second", 2021,
+ *     and Mushtak and Lemire, "Fast Number Parsing Without Fallback", 2023).
+ *  3. strtod(), which is exact but slow, for the rare significand of more than 19 digits that was truncated and lies
+ *     too close to a halfway point between two doubles.
+ */
+
+// The full 128-bit product of a and b.
+void json_multiply_u64(u64 a, u64 b, u64* high, u64* low) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 const product = (unsigned __int128)a * b;
+    *high = (u64)(product >> 64);
+    *low = (u64)product;
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *low = _umul128(a, b, high);
+#else
+    u64 const a_lo = (u32)a, a_hi = a >> 32, b_lo = (u32)b, b_hi = b >> 32;
+    u64 const lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    u64 const middle = (lo_lo >> 32) + (u32)hi_lo + lo_hi;
+    *high = hi_hi + (hi_lo >> 32) + (middle >> 32);
+    *low = (middle << 32) | (u32)lo_lo;
+#endif
+}
+
+u32 json_count_leading_zeros(u64 x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - (u32)index;
+#else
+    return (u32)__builtin_clzll(x);
+#endif
+}
+
+// Whether the 8 bytes in chunk (as loaded from memory by memcpy(), on a little-endian processor) are all digits.
+bool json_is_eight_digits(u64 chunk) {
+    return 0 == (((chunk + 0x4646464646464646) | (chunk - 0x3030303030303030)) & 0x8080808080808080);
+}
+
+// The value of the 8 digits in chunk (which must pass json_is_eight_digits()), combining neighbouring digits in pairs,
+// then pairs of pairs, with a few multiplications instead of 8 dependent ones.
+u32 json_parse_eight_digits(u64 chunk) {
+    u64 const mask = 0x000000FF000000FF;
+    u64 const mul1 = 100 + ((u64)1000000 << 32);
+    u64 const mul2 = 1 + ((u64)10000 << 32);
+    chunk -= 0x3030303030303030;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+    return (u32)chunk;
+}
+
+// Accumulate the digits at p (up to end) into w, returning the first non-digit.
+char const* json_parse_digits(char const* p, char const* end, u64* w) {
+    u64 value = *w;
+#if defined(UTIL_X86_64) || defined(__aarch64__) || defined(_M_ARM64)  // Little-endian.
+    while (end - p >= 8) {
+        u64 chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+        if (!json_is_eight_digits(chunk)) {
             break;
         }
-        ++offset_new;
+        value = 100000000*value + json_parse_eight_digits(chunk);
+        p += 8;
     }
-    if (is_floating && !got_digit_after_point) {
-        fprintf(stderr, "[ERROR] Bad parse: Decimal point without subsequent digit at offset %zu.\n", offset_new);
-        return false;
+#endif
+    while (p < end && '0' <= *p && *p <= '9') {
+        value = 10*value + (u64)(*p - '0');
+        ++p;
     }
+    *w = value;
+    return p;
+}
 
-    // Construct the number.
-    if (negate) {
-        integer *= -1;
+// The f64 nearest to w * 10^q, by the Eisel-Lemire algorithm. w must not be 0, and q must be within
+// [POW5_TABLE_MIN, POW5_TABLE_MAX]. This follows the reference implementation in fast_float (compute_float()).
+f64 json_eisel_lemire(u64 w, i32 q) {
+    enum {
+        MANTISSA_BITS = 52,  // Explicit bits, i.e., without the implicit leading 1.
+        EXPONENT_BIAS = 1023,
+        EXPONENT_INFINITE = 0x7FF,
+    };
+    u32 const lz = json_count_leading_zeros(w);
+    w <<= lz;
+
+    // The top 64 bits of w * 5^q. We need 55 of them (the mantissa, the implicit bit, a rounding bit, and one bit that
+    // may be 0 depending on the magnitude). Only if the rest are all ones could a carry from the low word change them.
+    u64 const* const pow5 = &pow5_table[2 * (q - POW5_TABLE_MIN)];
+    u64 high, low;
+    json_multiply_u64(w, pow5[0], &high, &low);
+    u64 const precision_mask = UINT64_MAX >> (MANTISSA_BITS + 3);
+    if ((high & precision_mask) == precision_mask) {
+        u64 high2, low2;
+        json_multiply_u64(w, pow5[1], &high2, &low2);
+        low += high2;
+        if (high2 > low) {
+            ++high;
+        }
     }
-    if (is_floating) {
-        f64 floating = (f64)integer;
-        for (int i = 0; i < fractional_digits; ++i) {
-            floating *= (f64)0.1;
+
+    u32 const upper_bit = (u32)(high >> 63);
+    u32 const shift = upper_bit + 64 - MANTISSA_BITS - 3;
+    u64 mantissa = high >> shift;
+    // floor(log2(10^q)) = floor(q * log2(10)), exactly for |q| < 1700, plus the 63 bits we shifted away.
+    i32 power2 = (i32)((((152170 + 65536) * (i64)q) >> 16) + 63) + (i32)upper_bit - (i32)lz + EXPONENT_BIAS;
+
+    if (power2 <= 0) {
+        // Subnormal, or zero.
+        if (-power2 + 1 >= 64) {
+            return 0.0;
         }
-        value->datum.floating = floating;
-        value->type = JSON_TYPE_FLOATING;
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;  // Round up.
+        mantissa >>= 1;
+        // A subnormal may round up into the smallest normal number.
+        power2 = mantissa < ((u64)1 << MANTISSA_BITS) ? 0 : 1;
     } else {
-        value->datum.integer = integer;
-        value->type = JSON_TYPE_INTEGER;
+        // Usually we round up, but a value exactly halfway between two doubles must round to even. Exact halfway
+        // values can only arise for small q.
+        if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high) {
+            mantissa &= ~(u64)1;
+        }
+        mantissa += mantissa & 1;  // Round up.
+        mantissa >>= 1;
+        if (mantissa >= ((u64)2 << MANTISSA_BITS)) {
+            // Rounding up overflowed into the next power of two.
+            mantissa = (u64)1 << MANTISSA_BITS;
+            ++power2;
+        }
+        mantissa &= ~((u64)1 << MANTISSA_BITS);
+        if (power2 >= EXPONENT_INFINITE) {
+            power2 = EXPONENT_INFINITE;
+            mantissa = 0;
+        }
     }
 
-    *offset = offset_new;
+    u64 const bits = mantissa | ((u64)power2 << MANTISSA_BITS);
+    f64 result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// The f64 nearest to w * 10^q (where w is not negative), or false if that can't be decided quickly: when w was
+// truncated to 19 digits (see json_parse_number()), w and w + 1 bound the true significand, and both must round to the
+// same f64.
+bool json_decimal_to_double(u64 w, i64 q, bool truncated, f64* result) {
+    // Exact powers of ten that fit in an f64's 53-bit mantissa.
+    static const f64 powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    if (w == 0) {
+        *result = 0.0;
+        return true;
+    }
+    if (q < POW5_TABLE_MIN) {
+        *result = 0.0;
+        return true;
+    }
+    if (q > POW5_TABLE_MAX) {
+        *result = INFINITY;
+        return true;
+    }
+    if (!truncated && -22 <= q && q <= 22 && w <= (u64)1 << 53) {
+        // Requires f64 arithmetic without extended precision (i.e., FLT_EVAL_METHOD == 0), as on x86-64 and ARM64.
+        *result = q < 0 ? (f64)w / powers_of_ten[-q] : (f64)w * powers_of_ten[q];
+        return true;
+    }
+    *result = json_eisel_lemire(w, (i32)q);
+    if (truncated && w < UINT64_MAX && json_eisel_lemire(w + 1, (i32)q) != *result) {
+        return false;
+    }
     return true;
 }
 
-/* Parse buf at offset, reading a single JSON value into value. Write into new_offset the location (within buf) one past
- * the end of the parsed value.
- *
- * The parsed text will not include any whitespace or possible comma just past the end of the value (so that
- * buf.p[new_offset] may be whitespace, or ',' if there is a subsequent sibling value).
- *
- * If this call is successful, then the caller is responsible for eventually calling json_value_destroy(value) to
- * release resources.
- *
- * If this call is successful, offset will be updated to point to after the value. If unsuccessful, offset will not be
- * unmodified.
- *
- * Return: true on success, false if there was an error.
- */
-bool json_parse_value(
+// Parse the number at offset (with no leading whitespace) into value. The number must follow the JSON grammar:
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][-+]?[0-9]+)?
+//
+// A number without a fraction or exponent is an integer if it fits in an i64; otherwise, it is a correctly rounded
+// f64. Numbers that are too large for an f64 are an error, and numbers that are too small become zero.
+bool json_parse_number(
     buffer buf,
     size_t* offset,
-    json_value* value,
-    bool expect_name
+    json_value* value
     ) {
-    size_t offset_new = *offset;
+    char const* const start = buf.p + *offset;
+    char const* const end = buf.p + buf.len;
+    char const* p = start;
 
-    json_parse_eat_whitespaces(buf, &offset_new);
-    if (offset_new >= buf.len) {
-        fprintf(stderr, "[ERROR] Bad parse: Unexpected end-of-buffer.\n");
+    bool const negative = p < end && '-' == *p;
+    if (negative) {
+        ++p;
+    }
+
+    // Accumulate all digits into w. This wraps around past 19 digits, in which case they are re-read below, so that
+    // this loop has no overflow checks.
+    u64 w = 0;
+    char const* const int_start = p;
+    p = json_parse_digits(p, end, &w);
+    char const* const int_end = p;
+    size_t digits = (size_t)(int_end - int_start);
+    if (0 == digits) {
+        fprintf(stderr, "[ERROR] Bad parse: Expected a digit at offset %zu.\n", *offset + (size_t)(p - start));
+        return false;
+    }
+    if (digits > 1 && '0' == *int_start) {
+        fprintf(stderr, "[ERROR] Bad parse: Leading zero in number at offset %zu.\n", *offset);
         return false;
     }
 
-    if (expect_name) {
-        // Parse the name (a string).
-        if (buf.p[offset_new] != '"') {
-            fprintf(stderr, "[ERROR] Bad parse: Expected value name at offset %zu, but did not find a string.\n", offset_new);
-            return false;
-        }
-        value->name = json_value_create();
-        if(!json_parse_value_string(buf, &offset_new, value->name)) {
-            return false;
-        }
-        json_parse_eat_whitespaces(buf, &offset_new);
-        if (!json_parse_eat_char(buf, &offset_new, ':')) {
-            fprintf(stderr, "[ERROR] Bad parse: Failed to find ':' after offset %zu.\n", offset_new);
+    bool is_floating = false;
+    i64 exponent = 0;
+    char const* frac_start = int_end;
+    char const* frac_end = int_end;
+    if (p < end && '.' == *p) {
+        is_floating = true;
+        ++p;
+        frac_start = p;
+        p = json_parse_digits(p, end, &w);
+        frac_end = p;
+        if (frac_end == frac_start) {
+            fprintf(stderr, "[ERROR] Bad parse: Decimal point without subsequent digit at offset %zu.\n",
+                    *offset + (size_t)(p - start));
             return false;
         }
-        json_parse_eat_whitespaces(buf, &offset_new);
+        digits += (size_t)(frac_end - frac_start);
+        exponent = -(i64)(frac_end - frac_start);
+    }
+
+    if (p < end && ('e' == *p || 'E' == *p)) {
+        is_floating = true;
+        ++p;
+        bool const exponent_negative = p < end && '-' == *p;
+        if (p < end && ('-' == *p || '+' == *p)) {
+            ++p;
+        }
+        char const* const exponent_start = p;
+        i64 explicit_exponent = 0;
+        while (p < end && '0' <= *p && *p <= '9') {
+            // Saturate: anything this large is zero or infinity anyway.
+            if (explicit_exponent < 0x10000000) {
+                explicit_exponent = 10*explicit_exponent + (*p - '0');
+            }
+            ++p;
+        }
+        if (p == exponent_start) {
+            fprintf(stderr, "[ERROR] Bad parse: Exponent without digits at offset %zu.\n", *offset + (size_t)(p - start));
+            return false;
+        }
+        exponent += exponent_negative ? -explicit_exponent : explicit_exponent;
+    }
+    *offset += (size_t)(p - start);
+
+    if (!is_floating) {
+        // Up to 18 digits always fit; 19 digits may overflow an i64, but not a u64.
+        if (digits < 19 || (digits == 19 && w <= (u64)INT64_MAX + negative)) {
+            value->datum.integer = negative ? (i64)(0 - w) : (i64)w;
+            value->type = JSON_TYPE_INTEGER;
+            return true;
+        }
+    }
+
+    bool truncated = false;
+    if (digits > 19) {
+        // Leading zeros (as in 0.000123) aren't significant.
+        char const* s = int_start;
+        while (s < frac_end && ('0' == *s || '.' == *s)) {
+            digits -= '0' == *s;
+            ++s;
+        }
+        if (digits > 19) {
+            // Keep the first 19 significant digits, and scale by the rest.
+            truncated = true;
+            w = 0;
+            size_t kept = 0;
+            for (; kept < 19 && s < frac_end; ++s) {
+                if ('.' != *s) {
+                    w = 10*w + (u64)(*s - '0');
+                    ++kept;
+                }
+            }
+            exponent += (i64)(digits - kept);
+        }
+    }
+
+    f64 floating;
+    if (json_decimal_to_double(w, exponent, truncated, &floating)) {
+        floating = negative ? -floating : floating;
+    } else {
+        // The exact fallback. strtod() needs a terminated string, and follows the locale's decimal point, which is '.'
+        // as long as nothing calls setlocale().
+        size_t const len = (size_t)(p - start);
+        char small[64];
+        char* const text = len < sizeof(small) ? small : malloc(len + 1);
+        if (!text) {
+            fprintf(stderr, "[ERROR] Memory allocation failed for number at offset %zu.\n", *offset - len);
+            return false;
+        }
+        memcpy(text, start, len);
+        text[len] = '\0';
+        floating = strtod(text, NULL);
+        if (text != small) {
+            free(text);
+        }
+    }
+    if (isinf(floating)) {
+        // JSON has no infinities to round-trip, so reject numbers that overflow an f64, instead of making them one.
+        fprintf(stderr, "[ERROR] Bad parse: Number out of range at offset %zu.\n", *offset - (size_t)(p - start));
+        return false;
+    }
+    value->datum.floating = floating;
+    value->type = JSON_TYPE_FLOATING;
+    return true;
+}
+
+bool json_parse_value_number(
+    buffer buf,
+    size_t* offset,
+    json_tape* tape,
+    json_value* value
+    ) {
+    json_parse_eat_whitespaces(buf, offset, tape);
+    return json_parse_number(buf, offset, value);
+}
+
+/* Parse buf at offset, reading a single JSON value into value. Write into new_offset the location (within buf) one past
+ * the end of the parsed value.
+ *
+ * The parsed text will not include any whitespace or possible comma just past the end of the value (so that
+ * buf.p[new_offset] may be whitespace, or ',' if there is a subsequent sibling value).
+ *
+ * tape is buf's tape, from json_tape_build(), positioned at or before offset.
+ *
+ * If this call is successful, then the caller is responsible for eventually calling json_value_destroy(value) to
+ * release resources. If ar != NULL, then all values and strings are allocated from ar.
+ *
+ * If this call is successful, offset will be updated to point to after the value. If unsuccessful, offset will not be
+ * unmodified.
+ *
+ * Return: true on success, false if there was an error.
+ */
+bool json_parse_value(
+    buffer buf,
+    size_t* offset,
+    json_tape* tape,
+    json_value* value,
+    bool expect_name,
+    arena* ar
+    ) {
+    size_t offset_new = *offset;
+
+    json_parse_eat_whitespaces(buf, &offset_new, tape);
+    if (offset_new >= buf.len) {
+        fprintf(stderr, "[ERROR] Bad parse: Unexpected end-of-buffer.\n");
+        return false;
+    }
+
+    if (expect_name) {
+        // Parse the name (a string).
+        if (buf.p[offset_new] != '"') {
+            fprintf(stderr, "[ERROR] Bad parse: Expected value name at offset %zu, but did not find a string.\n", offset_new);
+            return false;
+        }
+        value->name = json_value_create(ar);
+        if (!value->name) {
+            fprintf(stderr, "[ERROR] Bad parse: Failed to allocate memory at offset %zu.\n", offset_new);
+            return false;
+        }
+        if(!json_parse_value_string(buf, &offset_new, tape, value->name, ar)) {
+            return false;
+        }
+        json_parse_eat_whitespaces(buf, &offset_new, tape);
+        if (!json_parse_eat_char(buf, &offset_new, ':')) {
+            fprintf(stderr, "[ERROR] Bad parse: Failed to find ':' after offset %zu.\n", offset_new);
+            return false;
+        }
+        json_parse_eat_whitespaces(buf, &offset_new, tape);
     }
 
     if (offset_new >= buf.len) {
@@ -927,17 +3103,17 @@ bool json_parse_value(
     char initial = buf.p[offset_new];
     bool good_parse = true;
     if ('{' == initial) {
-        good_parse = json_parse_value_object(buf, &offset_new, value);
+        good_parse = json_parse_value_object(buf, &offset_new, tape, value, ar);
     } else if ('[' == initial) {
-        good_parse = json_parse_value_array(buf, &offset_new, value);
+        good_parse = json_parse_value_array(buf, &offset_new, tape, value, ar);
     } else if ('"' == initial) {
-        good_parse = json_parse_value_string(buf, &offset_new, value);
+        good_parse = json_parse_value_string(buf, &offset_new, tape, value, ar);
     } else if ('n' == initial) {
-        good_parse = json_parse_value_null(buf, &offset_new, value);
+        good_parse = json_parse_value_null(buf, &offset_new, tape, value);
     } else if ('t' == initial || 'f' == initial) {
-        good_parse = json_parse_value_boolean(buf, &offset_new, value);
+        good_parse = json_parse_value_boolean(buf, &offset_new, tape, value);
     } else if ('-' == initial || ('0' <= initial && initial <= '9')) {
-        good_parse = json_parse_value_number(buf, &offset_new, value);
+        good_parse = json_parse_value_number(buf, &offset_new, tape, value);
     } else {
         fprintf(stderr,
                 "[ERROR] Bad parse: Unexpected character '%c' (0x%X) at buffer offset %zu. Expected a JSON value, instead.\n",
@@ -954,9 +3130,10 @@ bool json_parse_value(
 
 bool json_parse_nothing_until_end(
     buffer buf,
-    size_t* offset
+    size_t* offset,
+    json_tape* tape
     ) {
-    json_parse_eat_whitespaces(buf, offset);
+    json_parse_eat_whitespaces(buf, offset, tape);
 
     if (*offset != buf.len) {
         fprintf(stderr,
@@ -973,35 +3150,922 @@ bool json_parse_nothing_until_end(
  * Parameters:
  *   buf: Stores textual data, to be parsed as JSON.
  *   data: Must be uninitialized and unallocated. Will be written to.
+ *   ar: Optional (may be NULL). If given, all of the data's memory is allocated from this arena, and is freed along with
+ *       it. This is much faster, for large data.
  * Return: true on success; false if there's an error.
- * Notes: If this call is successful, then the caller is responsible for calling json_data_destroy(data).
+ * Notes: If this call is successful, then the caller is responsible for calling json_data_destroy(data). (If ar was
+ *        given, this only invalidates data; the memory is freed by arena_destroy(ar).)
  */
-bool json_read_from_buffer(buffer buf, json_data* data) {
+bool json_read_from_buffer(buffer buf, json_data* data, arena* ar) {
     size_t offset = 0;
-    *data = json_value_create();
-    if (!json_parse_value(buf, &offset, *data, false)) {
-        fprintf(stderr, "[ERROR] Bad parse at top level.\n");
-        json_data_destroy(data);
+    json_tape tape = {0};
+    if (!json_tape_build(buf, json_scanner_selected, &tape)) {
+        fprintf(stderr, "[ERROR] Failed to index JSON data.\n");
+        return false;
+    }
+    *data = json_value_create(ar);
+    if (!*data) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+        json_tape_destroy(&tape);
         return false;
     }
-    // Make sure there's nothing after the top-level JSON value.
-    if (!json_parse_nothing_until_end(buf, &offset)) {
+    bool ok = true;
+    if (!json_parse_value(buf, &offset, &tape, *data, false, ar)) {
+        fprintf(stderr, "[ERROR] Bad parse at top level.\n");
+        ok = false;
+    } else if (!json_parse_nothing_until_end(buf, &offset, &tape)) {
+        // There's something after the top-level JSON value.
         fprintf(stderr, "[ERROR] Too many values at top level.\n");
+        ok = false;
+    }
+    if (!ok) {
         json_data_destroy(data);
-        return false;
     }
-    return true;
+    json_tape_destroy(&tape);
+    return ok;
 }
 
-// Read file into data.
+// Read file into data. See json_read_from_buffer().
 // Return: true on success; false if there's an error.
-bool json_read_from_file(char const filename[], json_data* data) {
-    buffer buf = buffer_create_from_file(filename);
-    if (buf.len == 0) {
+bool json_read_from_file(char const filename[], json_data* data, arena* ar) {
+    file_view view;
+    if (!file_view_open(filename, &view)) {
         fprintf(stderr, "[ERROR] Failed to read JSON data from file %s.\n", filename);
         return false;
     }
-    bool rtn = json_read_from_buffer(buf, data);
-    buffer_destroy(&buf);
+    bool rtn = json_read_from_buffer(view.buf, data, ar);
+    file_view_close(&view);
     return rtn;
 }
+
+
+// Streaming ("SAX") parsing: Rather than building a tree, report each value to callbacks as it's parsed. The input may
+// be fed in chunks of any size, e.g., as it's read from a pipe, and memory use is bounded by the longest single token
+// (string or number) and the nesting depth, rather than by the size of the input.
+//
+// The accepted syntax, and the values reported, are the same as json_read_from_buffer()'s. But callbacks are made as
+// soon as each value is complete; so, if there's an error, they will already have been made for the values before it.
+
+// Callbacks for streaming parsing. Any of them may be NULL, to ignore those events. Each returns false to stop
+// parsing (in which case, json_sax_feed() returns false).
+typedef struct json_sax_handler {
+    void* ctx;  // Passed to each callback.
+    bool (*begin_object)(void* ctx);
+    bool (*end_object)(void* ctx);
+    bool (*begin_array)(void* ctx);
+    bool (*end_array)(void* ctx);
+    // The name of the next value, which is a member of the current object. The string is only valid during the call.
+    bool (*key)(void* ctx, char const* p, size_t len);
+    // The string is only valid during the call.
+    bool (*string)(void* ctx, char const* p, size_t len);
+    bool (*integer)(void* ctx, i64 value);
+    bool (*floating)(void* ctx, f64 value);
+    bool (*boolean)(void* ctx, bool value);
+    bool (*null)(void* ctx);
+} json_sax_handler;
+
+typedef enum json_sax_state {
+    JSON_SAX_EXPECT_VALUE,  // At the top level, or after ':'.
+    JSON_SAX_EXPECT_ELEMENT,  // After ',' in an array.
+    JSON_SAX_EXPECT_VALUE_OR_CLOSE,  // Just after '['.
+    JSON_SAX_EXPECT_KEY,  // After ',' in an object.
+    JSON_SAX_EXPECT_KEY_OR_CLOSE,  // Just after '{'.
+    JSON_SAX_EXPECT_COLON,
+    JSON_SAX_EXPECT_COMMA_OR_CLOSE,  // After a member of an object or array.
+    JSON_SAX_EXPECT_NOTHING,  // After the top-level value.
+    JSON_SAX_IN_KEY,
+    JSON_SAX_IN_STRING,
+    JSON_SAX_IN_SCALAR,  // A number, or 'true', 'false', or 'null'.
+    JSON_SAX_FAILED,
+} json_sax_state;
+
+typedef struct json_sax_parser {
+    json_sax_handler handler;
+    json_sax_state state;
+    bool escape;  // In a key or string: The previous character was an unescaped backslash.
+    size_t offset;  // Number of characters fed so far.
+    size_t token_offset;  // Where the current key, string or scalar began.
+    buffer token;  // The current key, string or scalar, so far.
+    buffer stack;  // For each object or array that's open, outermost first: '{' or '['.
+} json_sax_parser;
+
+// Prepare parser to parse a new input, reporting its values to handler.
+// Notes: The caller is responsible for calling json_sax_parser_destroy(parser).
+void json_sax_parser_init(json_sax_parser* parser, json_sax_handler handler) {
+    *parser = (json_sax_parser){0};
+    parser->handler = handler;
+    parser->state = JSON_SAX_EXPECT_VALUE;
+}
+
+void json_sax_parser_destroy(json_sax_parser* parser) {
+    buffer_destroy(&parser->token);
+    buffer_destroy(&parser->stack);
+}
+
+// Append ch to buf, growing it as needed.
+bool json_sax_push(buffer* buf, char ch) {
+    if (buf->len == buf->len_max) {
+        size_t const len_max = buf->len_max ? 2 * buf->len_max : 64;
+        char* p = (char*)realloc(buf->p, len_max);
+        if (!p) {
+            fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+            return false;
+        }
+        buf->p = p;
+        buf->len_max = len_max;
+    }
+    buf->p[buf->len++] = ch;
+    return true;
+}
+
+// Append p[0..len) to buf, growing it as needed.
+bool json_sax_append(buffer* buf, char const* p, size_t len) {
+    // Nothing to copy; buf->p may still be NULL, which memcpy() mustn't be given, even for 0 bytes.
+    if (len == 0) {
+        return true;
+    }
+    if (buf->len + len > buf->len_max) {
+        size_t len_max = buf->len_max ? buf->len_max : 64;
+        while (len_max < buf->len + len) {
+            len_max *= 2;
+        }
+        char* q = (char*)realloc(buf->p, len_max);
+        if (!q) {
+            fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+            return false;
+        }
+        buf->p = q;
+        buf->len_max = len_max;
+    }
+    memcpy(buf->p + buf->len, p, len);
+    buf->len += len;
+    return true;
+}
+
+// A value has ended; expect what may follow it.
+void json_sax_value_done(json_sax_parser* parser) {
+    parser->state = parser->stack.len ? JSON_SAX_EXPECT_COMMA_OR_CLOSE : JSON_SAX_EXPECT_NOTHING;
+}
+
+// The current key or string has ended (at its closing '"'): decode and report it.
+bool json_sax_end_string(json_sax_parser* parser) {
+    buffer* tok = &parser->token;
+    size_t len = 0;
+    if (tok->len && !json_unescape(tok->p, tok->len, tok->p, &len, parser->token_offset)) {
+        return false;
+    }
+    json_sax_handler const* h = &parser->handler;
+    if (parser->state == JSON_SAX_IN_KEY) {
+        if (h->key && !h->key(h->ctx, tok->p, len)) {
+            return false;
+        }
+        parser->state = JSON_SAX_EXPECT_COLON;
+    } else {
+        if (h->string && !h->string(h->ctx, tok->p, len)) {
+            return false;
+        }
+        json_sax_value_done(parser);
+    }
+    tok->len = 0;
+    return true;
+}
+
+// The current scalar has ended (at whitespace, a structural character, '"', or the end of the input): parse and report
+// it. It must be a single number or literal, with nothing after it.
+bool json_sax_end_scalar(json_sax_parser* parser) {
+    buffer const tok = parser->token;
+    json_sax_handler const* h = &parser->handler;
+    bool ok = true;
+    char const initial = tok.p[0];
+    if ('-' == initial || ('0' <= initial && initial <= '9')) {
+        json_value number = {0};
+        size_t offset = 0;
+        if (!json_parse_number(tok, &offset, &number)) {
+            return false;
+        }
+        if (offset != tok.len) {
+            fprintf(stderr, "[ERROR] Bad parse: Unexpected character '%c' (0x%X) at offset %zu.\n",
+                    tok.p[offset], tok.p[offset], parser->token_offset + offset);
+            return false;
+        }
+        if (number.type == JSON_TYPE_INTEGER) {
+            ok = !h->integer || h->integer(h->ctx, number.datum.integer);
+        } else {
+            ok = !h->floating || h->floating(h->ctx, number.datum.floating);
+        }
+    } else if (tok.len == 4 && memcmp(tok.p, "true", 4) == 0) {
+        ok = !h->boolean || h->boolean(h->ctx, true);
+    } else if (tok.len == 5 && memcmp(tok.p, "false", 5) == 0) {
+        ok = !h->boolean || h->boolean(h->ctx, false);
+    } else if (tok.len == 4 && memcmp(tok.p, "null", 4) == 0) {
+        ok = !h->null || h->null(h->ctx);
+    } else {
+        fprintf(stderr,
+                "[ERROR] Bad parse: Unexpected character '%c' (0x%X) at offset %zu. Expected a JSON value, instead.\n",
+                initial, initial, parser->token_offset);
+        return false;
+    }
+    parser->token.len = 0;
+    json_sax_value_done(parser);
+    return ok;
+}
+
+// Handle a character which isn't whitespace, nor part of a key, string or scalar token.
+bool json_sax_step(json_sax_parser* parser, char ch) {
+    json_sax_handler const* h = &parser->handler;
+    json_sax_state const state = parser->state;
+    bool const expect_value = state == JSON_SAX_EXPECT_VALUE || state == JSON_SAX_EXPECT_ELEMENT
+        || state == JSON_SAX_EXPECT_VALUE_OR_CLOSE;
+    bool const expect_key = state == JSON_SAX_EXPECT_KEY || state == JSON_SAX_EXPECT_KEY_OR_CLOSE;
+    char const open = parser->stack.len ? parser->stack.p[parser->stack.len - 1] : '\0';
+    if ((ch == '}' && open == '{' && (state == JSON_SAX_EXPECT_KEY_OR_CLOSE || state == JSON_SAX_EXPECT_COMMA_OR_CLOSE))
+        || (ch == ']' && open == '[' && (state == JSON_SAX_EXPECT_VALUE_OR_CLOSE || state == JSON_SAX_EXPECT_COMMA_OR_CLOSE))) {
+        --parser->stack.len;
+        json_sax_value_done(parser);
+        if (ch == '}') {
+            return !h->end_object || h->end_object(h->ctx);
+        }
+        return !h->end_array || h->end_array(h->ctx);
+    } else if (ch == ',' && (state == JSON_SAX_EXPECT_COMMA_OR_CLOSE
+                             // Like json_parse_value_aggregate(), accept repeated commas.
+                             || state == JSON_SAX_EXPECT_KEY || state == JSON_SAX_EXPECT_ELEMENT)) {
+        parser->state = open == '{' ? JSON_SAX_EXPECT_KEY : JSON_SAX_EXPECT_ELEMENT;
+        return true;
+    } else if (ch == ':' && state == JSON_SAX_EXPECT_COLON) {
+        parser->state = JSON_SAX_EXPECT_VALUE;
+        return true;
+    } else if (ch == '"' && (expect_value || expect_key)) {
+        parser->state = expect_key ? JSON_SAX_IN_KEY : JSON_SAX_IN_STRING;
+        parser->token_offset = parser->offset + 1;
+        return true;
+    } else if ((ch == '{' || ch == '[') && expect_value) {
+        if (!json_sax_push(&parser->stack, ch)) {
+            return false;
+        }
+        if (ch == '{') {
+            parser->state = JSON_SAX_EXPECT_KEY_OR_CLOSE;
+            return !h->begin_object || h->begin_object(h->ctx);
+        }
+        parser->state = JSON_SAX_EXPECT_VALUE_OR_CLOSE;
+        return !h->begin_array || h->begin_array(h->ctx);
+    } else if (expect_value && !json_is_structural(ch)) {
+        parser->state = JSON_SAX_IN_SCALAR;
+        parser->token_offset = parser->offset;
+        return json_sax_push(&parser->token, ch);
+    }
+    fprintf(stderr, "[ERROR] Bad parse: Unexpected character '%c' (0x%X) at offset %zu.\n", ch, ch, parser->offset);
+    return false;
+}
+
+// Parse the next chunk of input, p[0..len), making callbacks for each value completed within it.
+// Return: true on success; false if there's an error, or if a callback returned false. After that, the parser only
+// fails.
+bool json_sax_feed(json_sax_parser* parser, char const* p, size_t len) {
+    if (parser->state == JSON_SAX_FAILED) {
+        return false;
+    }
+    size_t i = 0;
+    bool ok = true;
+    while (ok && i < len) {
+        if (parser->state == JSON_SAX_IN_KEY || parser->state == JSON_SAX_IN_STRING) {
+            // Find the closing '"', copying everything up to it (still escaped) into the token.
+            size_t j = i;
+            while (j < len && (p[j] != '"' || parser->escape)) {
+                parser->escape = !parser->escape && p[j] == '\\';
+                ++j;
+            }
+            ok = json_sax_append(&parser->token, p + i, j - i);
+            parser->offset += j - i;
+            i = j;
+            if (ok && i < len) {
+                ok = json_sax_end_string(parser);
+                ++parser->offset;
+                ++i;
+            }
+        } else if (parser->state == JSON_SAX_IN_SCALAR) {
+            size_t j = i;
+            while (j < len && p[j] != '"' && !json_is_whitespace(p[j]) && !json_is_structural(p[j])) {
+                ++j;
+            }
+            ok = json_sax_append(&parser->token, p + i, j - i);
+            parser->offset += j - i;
+            i = j;
+            if (ok && i < len) {
+                // The character which ends the scalar is handled on the next iteration.
+                ok = json_sax_end_scalar(parser);
+            }
+        } else if (json_is_whitespace(p[i])) {
+            size_t j = i + 1;
+            while (j < len && json_is_whitespace(p[j])) {
+                ++j;
+            }
+            parser->offset += j - i;
+            i = j;
+        } else {
+            ok = json_sax_step(parser, p[i]);
+            ++parser->offset;
+            ++i;
+        }
+    }
+    if (!ok) {
+        parser->state = JSON_SAX_FAILED;
+    }
+    return ok;
+}
+
+// Signal the end of the input.
+// Return: true on success; false if the input was incomplete (or json_sax_feed() had failed).
+bool json_sax_finish(json_sax_parser* parser) {
+    if (parser->state == JSON_SAX_IN_SCALAR && !json_sax_end_scalar(parser)) {
+        parser->state = JSON_SAX_FAILED;
+    }
+    if (parser->state == JSON_SAX_FAILED) {
+        return false;
+    }
+    if (parser->state != JSON_SAX_EXPECT_NOTHING) {
+        fprintf(stderr, "[ERROR] Bad parse: Unexpected end of input at offset %zu.\n", parser->offset);
+        parser->state = JSON_SAX_FAILED;
+        return false;
+    }
+    return true;
+}
+
+#define JSON_SAX_CHUNK_SIZE ((size_t)1 << 16)
+
+// Parse the JSON file (which may be a pipe) in fixed-size chunks, reporting its values to handler.
+// Return: true on success; false if there's an error, or if a callback returned false.
+bool json_sax_parse_file(char const* filename, json_sax_handler handler) {
+    FILE* f = fopen(filename, "rb");
+    if (!f) {
+        fprintf(stderr, "[ERROR] Failed to open file %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    char* chunk = (char*)malloc(JSON_SAX_CHUNK_SIZE);
+    if (!chunk) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+        fclose(f);
+        return false;
+    }
+    json_sax_parser parser;
+    json_sax_parser_init(&parser, handler);
+    bool ok = true;
+    while (ok) {
+        size_t const len = fread(chunk, 1, JSON_SAX_CHUNK_SIZE, f);
+        if (len == 0) {
+            break;
+        }
+        ok = json_sax_feed(&parser, chunk, len);
+    }
+    if (ok && ferror(f)) {
+        fprintf(stderr, "[ERROR] Failed to read file %s.\n", filename);
+        ok = false;
+    }
+    ok = ok && json_sax_finish(&parser);
+    json_sax_parser_destroy(&parser);
+    free(chunk);
+    fclose(f);
+    return ok;
+}
+
+
+// Writing JSON: A json_writer appends JSON text to a growable buffer, either value by value (begin an object, write a
+// key, write a value, ..., end the object), or a whole json_value tree at once with json_writer_value(). The output can
+// be compact, on one line, or indented. Floating-point numbers are written in the fewest digits that parse back to the
+// same f64.
+//
+// Values written at the top level, one after another, are separated by newlines (as in the JSON Lines format).
+//
+// Writing the buffer out is up to the caller, e.g., with json_writer_flush(), which may be called at any point to
+// keep the buffer small.
+
+typedef struct json_writer {
+    buffer out;  // The JSON written since the last json_writer_flush().
+    u32 indent;  // Spaces per level of nesting; 0 for compact output.
+    buffer stack;  // For each object or array that's open, outermost first: '{' or '['.
+    bool empty;  // Nothing has been written in the innermost open object or array (or at the top level) yet.
+    bool after_key;  // A key was just written, so its value is next.
+    bool failed;  // An allocation failed, so the output is incomplete. Further writes do nothing.
+} json_writer;
+
+// Initialize w, to write with the given indentation (spaces per level of nesting), or compactly if indent == 0.
+// Notes: The caller is responsible for calling json_writer_destroy(w).
+void json_writer_init(json_writer* w, u32 indent) {
+    *w = (json_writer){0};
+    w->indent = indent;
+    w->empty = true;
+}
+
+void json_writer_destroy(json_writer* w) {
+    buffer_destroy(&w->out);
+    buffer_destroy(&w->stack);
+    *w = (json_writer){0};
+}
+
+// Append len bytes from p to the output.
+bool json_writer_raw(json_writer* w, char const* p, size_t len) {
+    if (!w->failed && !buffer_append(&w->out, p, len)) {
+        w->failed = true;
+    }
+    return !w->failed;
+}
+
+// Start a line at the current depth of nesting.
+bool json_writer_newline(json_writer* w) {
+    size_t const spaces = (size_t)w->indent * w->stack.len;
+    if (w->failed || !buffer_reserve(&w->out, 1 + spaces)) {
+        w->failed = true;
+        return false;
+    }
+    w->out.p[w->out.len++] = '\n';
+    memset(w->out.p + w->out.len, ' ', spaces);
+    w->out.len += spaces;
+    return true;
+}
+
+// Prepare to write a value (or, in an object, a key): separate it from the previous one, and indent it.
+bool json_writer_separate(json_writer* w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return !w->failed;
+    }
+    bool const first = w->empty;
+    w->empty = false;
+    if (w->stack.len == 0) {
+        return first || json_writer_raw(w, "\n", 1);
+    }
+    if (!first && !json_writer_raw(w, ",", 1)) {
+        return false;
+    }
+    return w->indent == 0 || json_writer_newline(w);
+}
+
+bool json_writer_begin(json_writer* w, char open) {
+    assert(w->stack.len == 0 || w->stack.p[w->stack.len - 1] == '[' || w->after_key);
+    if (!json_writer_separate(w) || !json_writer_raw(w, &open, 1)) {
+        return false;
+    }
+    if (!json_sax_push(&w->stack, open)) {
+        w->failed = true;
+        return false;
+    }
+    w->empty = true;
+    return true;
+}
+
+bool json_writer_end(json_writer* w, char open, char close) {
+    assert(w->stack.len > 0 && w->stack.p[w->stack.len - 1] == open && !w->after_key);
+    (void)open;
+    --w->stack.len;
+    if (!w->empty && w->indent && !json_writer_newline(w)) {
+        return false;
+    }
+    w->empty = false;
+    return json_writer_raw(w, &close, 1);
+}
+
+bool json_writer_begin_object(json_writer* w) {
+    return json_writer_begin(w, '{');
+}
+
+bool json_writer_end_object(json_writer* w) {
+    return json_writer_end(w, '{', '}');
+}
+
+bool json_writer_begin_array(json_writer* w) {
+    return json_writer_begin(w, '[');
+}
+
+bool json_writer_end_array(json_writer* w) {
+    return json_writer_end(w, '[', ']');
+}
+
+// Append p[0..len) as a quoted JSON string, escaping quotes, backslashes and control characters.
+bool json_writer_quoted(json_writer* w, char const* p, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    if (len == 0) {
+        return json_writer_raw(w, "\"\"", 2);
+    }
+    if (!json_writer_raw(w, "\"", 1)) {
+        return false;
+    }
+    // Copy runs of characters that need no escaping all at once.
+    size_t run_start = 0;
+    for (size_t i = 0; i < len; ++i) {
+        u8 const ch = (u8)p[i];
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+        char escape[6] = { '\\', (char)ch, 0, 0, 0, 0 };
+        size_t escape_len = 2;
+        switch (ch) {
+        case '"': case '\\': break;
+        case '\b': escape[1] = 'b'; break;
+        case '\f': escape[1] = 'f'; break;
+        case '\n': escape[1] = 'n'; break;
+        case '\r': escape[1] = 'r'; break;
+        case '\t': escape[1] = 't'; break;
+        default:
+            memcpy(escape + 1, "u00", 3);
+            escape[4] = hex[ch >> 4];
+            escape[5] = hex[ch & 0xF];
+            escape_len = 6;
+            break;
+        }
+        if (!json_writer_raw(w, p + run_start, i - run_start) || !json_writer_raw(w, escape, escape_len)) {
+            return false;
+        }
+        run_start = i + 1;
+    }
+    return json_writer_raw(w, p + run_start, len - run_start) && json_writer_raw(w, "\"", 1);
+}
+
+// Write the name of the next member of the current object.
+bool json_writer_key(json_writer* w, char const* p, size_t len) {
+    assert(w->stack.len > 0 && w->stack.p[w->stack.len - 1] == '{' && !w->after_key);
+    if (!json_writer_separate(w) || !json_writer_quoted(w, p, len)
+        || !json_writer_raw(w, ": ", w->indent ? 2 : 1)) {
+        return false;
+    }
+    w->after_key = true;
+    return true;
+}
+
+bool json_writer_string(json_writer* w, char const* p, size_t len) {
+    return json_writer_separate(w) && json_writer_quoted(w, p, len);
+}
+
+bool json_writer_integer(json_writer* w, i64 value) {
+    // Write the digits backwards, from the least significant.
+    char digits[20];
+    char* p = digits + sizeof(digits);
+    u64 magnitude = value < 0 ? 0 - (u64)value : (u64)value;
+    do {
+        *--p = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) {
+        *--p = '-';
+    }
+    return json_writer_separate(w) && json_writer_raw(w, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+/* Binary to decimal floating point, by the Ryu algorithm (Adams, "Ryu: Fast Float-to-String Conversion", 2018). This
+ * follows the reference implementation (d2d() in https://github.com/ulfjack/ryu), and uses its tables, from
+ * pow5_table.h.
+ *
+ * Of all the decimals that parse back to a given f64, Ryu finds the one with the fewest digits (and of those, the
+ * closest), like Python's repr() and JavaScript's Number.prototype.toString().
+ */
+
+// ceil(log2(5^e)), or 1 if e == 0. For 0 <= e <= 3528.
+i32 ryu_pow5_bits(i32 e) {
+    return (i32)((((u32)e * 1217359) >> 19) + 1);
+}
+
+// floor(log10(2^e)), for 0 <= e <= 1650.
+u32 ryu_log10_pow2(i32 e) {
+    return ((u32)e * 78913) >> 18;
+}
+
+// floor(log10(5^e)), for 0 <= e <= 2620.
+u32 ryu_log10_pow5(i32 e) {
+    return ((u32)e * 732923) >> 20;
+}
+
+bool ryu_multiple_of_pow5(u64 value, u32 p) {
+    u32 count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        ++count;
+    }
+    return count >= p;
+}
+
+bool ryu_multiple_of_pow2(u64 value, u32 p) {
+    return (value & (((u64)1 << p) - 1)) == 0;
+}
+
+// (m * mul) >> j, where mul is a 128-bit table entry (low word first), and 64 < j < 128.
+u64 ryu_multiply_shift(u64 m, u64 const mul[2], i32 j) {
+    u64 b0_high, b0_low, b2_high, b2_low;
+    json_multiply_u64(m, mul[0], &b0_high, &b0_low);
+    json_multiply_u64(m, mul[1], &b2_high, &b2_low);
+    u64 const sum_low = b0_high + b2_low;
+    u64 const sum_high = b2_high + (sum_low < b0_high);
+    u32 const shift = (u32)(j - 64);
+    return (sum_high << (64 - shift)) | (sum_low >> shift);
+}
+
+// Find the shortest decimal digits * 10^exponent that parses back to value, which must be finite and positive.
+void json_shortest_decimal(f64 value, u64* digits, i32* exponent) {
+    enum {
+        MANTISSA_BITS = 52,
+        EXPONENT_BIAS = 1023,
+    };
+    u64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u64 const ieee_mantissa = bits & (((u64)1 << MANTISSA_BITS) - 1);
+    u32 const ieee_exponent = (u32)(bits >> MANTISSA_BITS) & 0x7FF;
+
+    // Step 1: Decode value as m2 * 2^e2. Subtract 2 more from e2, so that the bounds below are integers.
+    i32 e2;
+    u64 m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - EXPONENT_BIAS - MANTISSA_BITS - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = (i32)ieee_exponent - EXPONENT_BIAS - MANTISSA_BITS - 2;
+        m2 = ((u64)1 << MANTISSA_BITS) | ieee_mantissa;
+    }
+    // Parsing rounds ties to even, so if m2 is even, the bounds themselves parse back to value.
+    bool const accept_bounds = (m2 & 1) == 0;
+
+    // Step 2: The interval of decimals that parse back to value is (mm, mp) * 2^e2, around mv * 2^e2. The lower bound
+    // is closer when value is a power of two (except the smallest normal number).
+    u64 const mv = 4 * m2;
+    u32 const mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+    // Step 3: Convert mv, mp and mm to a decimal power, as vr, vp and vm * 10^e10, with 128-bit arithmetic. Keep track
+    // of whether the digits dropped by the conversion were all zeros, for exact rounding in the rare cases it matters.
+    u64 vr, vp, vm;
+    i32 e10;
+    bool vm_is_trailing_zeros = false;
+    bool vr_is_trailing_zeros = false;
+    if (e2 >= 0) {
+        u32 const q = ryu_log10_pow2(e2) - (e2 > 3);
+        e10 = (i32)q;
+        i32 const k = RYU_POW5_BITS + ryu_pow5_bits((i32)q) - 1;
+        i32 const i = -e2 + (i32)q + k;
+        vr = ryu_multiply_shift(4 * m2, ryu_pow5_inv_table[q], i);
+        vp = ryu_multiply_shift(4 * m2 + 2, ryu_pow5_inv_table[q], i);
+        vm = ryu_multiply_shift(4 * m2 - 1 - mm_shift, ryu_pow5_inv_table[q], i);
+        if (q <= 21) {
+            // Only one of mp, mv and mm can be a multiple of 5, if any.
+            if (mv % 5 == 0) {
+                vr_is_trailing_zeros = ryu_multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_is_trailing_zeros = ryu_multiple_of_pow5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= ryu_multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        u32 const q = ryu_log10_pow5(-e2) - (-e2 > 1);
+        e10 = (i32)q + e2;
+        i32 const i = -e2 - (i32)q;
+        i32 const k = ryu_pow5_bits(i) - RYU_POW5_BITS;
+        i32 const j = (i32)q - k;
+        vr = ryu_multiply_shift(4 * m2, ryu_pow5_table[i], j);
+        vp = ryu_multiply_shift(4 * m2 + 2, ryu_pow5_table[i], j);
+        vm = ryu_multiply_shift(4 * m2 - 1 - mm_shift, ryu_pow5_table[i], j);
+        if (q <= 1) {
+            // mv = 4 * m2 always has at least two trailing zero bits.
+            vr_is_trailing_zeros = true;
+            if (accept_bounds) {
+                // mm = mv - 1 - mm_shift has one trailing zero bit if mm_shift == 1.
+                vm_is_trailing_zeros = mm_shift == 1;
+            } else {
+                // mp = mv + 2 always has at least one trailing zero bit.
+                --vp;
+            }
+        } else if (q < 63) {
+            vr_is_trailing_zeros = ryu_multiple_of_pow2(mv, q);
+        }
+    }
+
+    // Step 4: Drop digits while the interval still contains a decimal of that length, then round.
+    i32 removed = 0;
+    u64 output;
+    if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+        // The general case, which is rare.
+        u32 last_removed_digit = 0;
+        while (vp / 10 > vm / 10) {
+            vm_is_trailing_zeros &= vm % 10 == 0;
+            vr_is_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = (u32)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+        if (vm_is_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_is_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = (u32)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+        }
+        if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) {
+            // Exactly halfway: round to even.
+            last_removed_digit = 4;
+        }
+        output = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros)) || last_removed_digit >= 5);
+    } else {
+        // The common case.
+        bool round_up = false;
+        if (vp / 100 > vm / 100) {
+            // Drop two digits at a time, first.
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+    *digits = output;
+    *exponent = e10 + removed;
+}
+
+// Write value in the fewest significant digits that parse back to exactly value, formatted as Python's repr() does:
+// with a decimal point (so that it parses back as floating-point, not as an integer), or, for very large or small
+// magnitudes, an exponent. JSON has no infinities or NaNs, so those are written as null.
+bool json_writer_floating(json_writer* w, f64 value) {
+    if (!isfinite(value)) {
+        return json_writer_separate(w) && json_writer_raw(w, "null", 4);
+    }
+    char text[32];
+    size_t len = 0;
+    if (signbit(value)) {
+        text[len++] = '-';
+        value = -value;
+    }
+    if (value == 0.0) {
+        memcpy(text + len, "0.0", 3);
+        return json_writer_separate(w) && json_writer_raw(w, text, len + 3);
+    }
+    u64 digits_value;
+    i32 exponent;
+    json_shortest_decimal(value, &digits_value, &exponent);
+    char digits[20] = {0};
+    i32 digits_count = 0;
+    for (u64 d = digits_value; d; d /= 10) {
+        ++digits_count;
+    }
+    for (i32 i = digits_count - 1; i >= 0; --i) {
+        digits[i] = (char)('0' + digits_value % 10);
+        digits_value /= 10;
+    }
+    // value = 0.digits * 10^point.
+    i32 const point = exponent + digits_count;
+    if (point <= -4 || point > 16) {
+        // d.ddde+XX, with an exponent of at least two digits.
+        text[len++] = digits[0];
+        if (digits_count > 1) {
+            text[len++] = '.';
+            memcpy(text + len, digits + 1, (size_t)digits_count - 1);
+            len += (size_t)digits_count - 1;
+        }
+        i32 const e = point - 1;
+        len += (size_t)snprintf(text + len, sizeof(text) - len, "e%c%02d", e < 0 ? '-' : '+', e < 0 ? -e : e);
+    } else if (point <= 0) {
+        // 0.000ddd
+        memcpy(text + len, "0.000", (size_t)(2 - point));
+        len += (size_t)(2 - point);
+        memcpy(text + len, digits, (size_t)digits_count);
+        len += (size_t)digits_count;
+    } else if (point >= digits_count) {
+        // ddd000.0
+        memcpy(text + len, digits, (size_t)digits_count);
+        len += (size_t)digits_count;
+        memset(text + len, '0', (size_t)(point - digits_count));
+        len += (size_t)(point - digits_count);
+        memcpy(text + len, ".0", 2);
+        len += 2;
+    } else {
+        // ddd.ddd
+        memcpy(text + len, digits, (size_t)point);
+        len += (size_t)point;
+        text[len++] = '.';
+        memcpy(text + len, digits + point, (size_t)(digits_count - point));
+        len += (size_t)(digits_count - point);
+    }
+    return json_writer_separate(w) && json_writer_raw(w, text, len);
+}
+
+bool json_writer_boolean(json_writer* w, bool value) {
+    return json_writer_separate(w) && (value ? json_writer_raw(w, "true", 4) : json_writer_raw(w, "false", 5));
+}
+
+bool json_writer_null(json_writer* w) {
+    return json_writer_separate(w) && json_writer_raw(w, "null", 4);
+}
+
+// Write the tree rooted at v (but not v's siblings). Members of objects are written with their names.
+bool json_writer_value(json_writer* w, json_value const* v) {
+    // The aggregates that are open, outermost first. This is iterative, so that neither deep nesting nor long arrays
+    // can overflow the call stack.
+    json_value const** parents = NULL;
+    size_t depth = 0;
+    size_t depth_max = 0;
+    while (v && !w->failed) {
+        if (depth > 0 && parents[depth - 1]->type == JSON_TYPE_OBJECT) {
+            buffer const name = v->name ? v->name->datum.string : (buffer){0};
+            json_writer_key(w, name.p, name.len);
+        }
+        switch (v->type) {
+        case JSON_TYPE_OBJECT:
+        case JSON_TYPE_ARRAY:
+            json_writer_begin(w, v->type == JSON_TYPE_OBJECT ? '{' : '[');
+            if (v->child) {
+                if (depth == depth_max) {
+                    depth_max = depth_max ? 2 * depth_max : 16;
+                    json_value const** p = (json_value const**)realloc((void*)parents, depth_max * sizeof(*parents));
+                    if (!p) {
+                        fprintf(stderr, "[ERROR] Failed to allocate memory: %s\n", strerror(errno));
+                        w->failed = true;
+                        break;
+                    }
+                    parents = p;
+                }
+                parents[depth++] = v;
+                v = v->child;
+                continue;
+            }
+            if (v->type == JSON_TYPE_OBJECT) {
+                json_writer_end_object(w);
+            } else {
+                json_writer_end_array(w);
+            }
+            break;
+        case JSON_TYPE_STRING:
+            json_writer_string(w, v->datum.string.p, v->datum.string.len);
+            break;
+        case JSON_TYPE_INTEGER:
+            json_writer_integer(w, v->datum.integer);
+            break;
+        case JSON_TYPE_FLOATING:
+            json_writer_floating(w, v->datum.floating);
+            break;
+        case JSON_TYPE_BOOLEAN:
+            json_writer_boolean(w, v->datum.boolean);
+            break;
+        case JSON_TYPE_NULL:
+            json_writer_null(w);
+            break;
+        default:
+            fprintf(stderr, "[ERROR] Cannot write: Unhandled type.\n");
+            w->failed = true;
+            break;
+        }
+        // Move on to the next sibling, closing each aggregate that has no more children.
+        while (depth > 0 && !v->next) {
+            v = parents[--depth];
+            if (v->type == JSON_TYPE_OBJECT) {
+                json_writer_end_object(w);
+            } else {
+                json_writer_end_array(w);
+            }
+        }
+        v = depth > 0 ? v->next : NULL;
+    }
+    free((void*)parents);
+    return !w->failed;
+}
+
+// Write out everything written to w so far, and empty its buffer.
+// Return: true on success; false if the write failed, or if w's output is incomplete.
+bool json_writer_flush(json_writer* w, FILE* stream) {
+    if (w->failed) {
+        return false;
+    }
+    size_t const len = w->out.len;
+    w->out.len = 0;
+    if (len && fwrite(w->out.p, 1, len, stream) != len) {
+        fprintf(stderr, "[ERROR] Failed to write JSON: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Write the tree rooted at data to a file, with the given indentation (see json_writer_init()), and a final newline.
+// Return: true on success; false if there's an error.
+bool json_write_to_file(json_data const data, char const* filename, u32 indent) {
+    json_writer w;
+    json_writer_init(&w, indent);
+    bool ok = json_writer_value(&w, data) && json_writer_raw(&w, "\n", 1);
+    FILE* f = ok ? fopen(filename, "wb") : NULL;
+    if (ok && !f) {
+        fprintf(stderr, "[ERROR] Failed to open file %s: %s\n", filename, strerror(errno));
+        ok = false;
+    }
+    if (f) {
+        ok = json_writer_flush(&w, f);
+        if (fclose(f) != 0) {
+            fprintf(stderr, "[ERROR] Failed to write file %s: %s\n", filename, strerror(errno));
+            ok = false;
+        }
+    }
+    json_writer_destroy(&w);
+    return ok;
+}
@@ -4,19 +4,450 @@
 #include <windows.h>
 #endif
 
+// True if the values a and b, and all of their siblings and children, are identical.
+bool json_value_eq(json_value const* a, json_value const* b) {
+    while (a && b) {
+        if (a->type != b->type || !a->name != !b->name
+            || (a->name && !json_value_eq(a->name, b->name))) {
+            return false;
+        }
+        switch (a->type) {
+        case JSON_TYPE_OBJECT:
+        case JSON_TYPE_ARRAY:
+            if (json_count_children(a) != json_count_children(b) || !json_value_eq(a->child, b->child)) {
+                return false;
+            }
+            break;
+        case JSON_TYPE_STRING:
+            if (a->datum.string.len != b->datum.string.len
+                || (a->datum.string.len && memcmp(a->datum.string.p, b->datum.string.p, a->datum.string.len))) {
+                return false;
+            }
+            break;
+        case JSON_TYPE_INTEGER:
+            if (a->datum.integer != b->datum.integer) {
+                return false;
+            }
+            break;
+        case JSON_TYPE_FLOATING:
+            if (memcmp(&a->datum.floating, &b->datum.floating, sizeof a->datum.floating)) {
+                return false;
+            }
+            break;
+        case JSON_TYPE_BOOLEAN:
+            if (a->datum.boolean != b->datum.boolean) {
+                return false;
+            }
+            break;
+        default:
+            break;
+        }
+        a = a->next;
+        b = b->next;
+    }
+    return !a && !b;
+}
+
+// Check that every available stage-1 scanner agrees with the scalar one: first on the tape, then on the parsed tree.
+bool check_scanners(buffer buf, bool reference_ok, json_data reference) {
+    json_tape reference_tape = {0};
+    if (!json_tape_build(buf, JSON_SCANNER_SCALAR, &reference_tape)) {
+        return false;
+    }
+    bool ok = true;
+    for (json_scanner scanner = JSON_SCANNER_SCALAR + 1; scanner < JSON_SCANNERS_COUNT; ++scanner) {
+        if (!json_scanner_available(scanner)) {
+            continue;
+        }
+        json_tape tape = {0};
+        if (!json_tape_build(buf, scanner, &tape)) {
+            ok = false;
+            continue;
+        }
+        if (tape.count != reference_tape.count
+            || memcmp(tape.offsets, reference_tape.offsets, (tape.count + 1) * sizeof *tape.offsets)) {
+            fprintf(stderr, "[ERROR] The %s scanner's tape differs from the scalar scanner's.\n",
+                    json_scanner_name[scanner]);
+            ok = false;
+        }
+        json_tape_destroy(&tape);
+
+        json_scanner_selected = scanner;
+        json_data data = NULL;
+        bool const data_ok = json_read_from_buffer(buf, &data, NULL);
+        if (data_ok != reference_ok || (data_ok && !json_value_eq(data, reference))) {
+            fprintf(stderr, "[ERROR] The %s scanner's tree differs from the scalar scanner's.\n",
+                    json_scanner_name[scanner]);
+            ok = false;
+        }
+        json_data_destroy(&data);
+    }
+    json_scanner_selected = JSON_SCANNER_BEST;
+    json_tape_destroy(&reference_tape);
+    return ok;
+}
+
+json_value* json_find_child_linear(json_value const* jv, char const* name, bool of_type, json_type type) {
+    for (json_value* child = jv->child; child; child = child->next) {
+        if (buffer_eq(&child->name->datum.string, name) && (!of_type || child->type == type)) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+// Check that lookups in jv, and recursively in its children and siblings, give the same results with a key index as by
+// a linear scan: for each child's name (or, in very large objects, a sample of them, since each linear scan takes a while),
+// and for that name truncated and extended.
+bool check_key_index(json_value* jv) {
+    bool ok = true;
+    for (; jv; jv = jv->next) {
+        if (jv->type == JSON_TYPE_OBJECT && json_count_children(jv) >= JSON_OBJECT_INDEX_MIN_COUNT) {
+            size_t const stride = MAX(json_count_children(jv) / 64, 1);
+            size_t i = 0;
+            for (json_value* child = jv->child; child; child = child->next, ++i) {
+                buffer const* name = &child->name->datum.string;
+                if (json_get_child(jv, i) != child) {
+                    fprintf(stderr, "[ERROR] Key index: Wrong child %zu.\n", i);
+                    ok = false;
+                }
+                if (i % stride || (name->len && memchr(name->p, '\0', name->len))) {
+                    continue;
+                }
+                char* key = (char*)malloc(name->len + 3);
+                if (name->len) {
+                    memcpy(key, name->p, name->len);
+                }
+                memcpy(key + name->len, "_x", 3);
+                for (size_t len = (name->len ? name->len - 1 : 0); len <= name->len + 2; ++len) {
+                    char const saved = key[len];
+                    key[len] = '\0';
+                    if (json_find_child(jv, key) != json_find_child_linear(jv, key, false, 0)) {
+                        fprintf(stderr, "[ERROR] Key index: Wrong child named \"%s\".\n", key);
+                        ok = false;
+                    }
+                    json_type const types[] = { child->type, JSON_TYPE_NULL };
+                    for (size_t t = 0; t < sizeof types / sizeof types[0]; ++t) {
+                        json_type const type = types[t];
+                        if (json_find_child_of_type(jv, key, type) != json_find_child_linear(jv, key, true, type)) {
+                            fprintf(stderr, "[ERROR] Key index: Wrong %s child named \"%s\".\n", json_type_name[type], key);
+                            ok = false;
+                        }
+                    }
+                    key[len] = saved;
+                }
+                free(key);
+            }
+        }
+        if (json_is_aggregate(jv) && !check_key_index(jv->child)) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Builds a tree from streaming events, to check them against json_read_from_buffer()'s.
+typedef struct sax_tree {
+    json_value* root;
+    json_value** stack;  // The open objects and arrays, outermost first.
+    size_t depth;
+    size_t depth_max;
+    json_value* name;  // The name of the next value, if any.
+} sax_tree;
+
+json_value* sax_tree_string(char const* p, size_t len) {
+    json_value* v = json_value_create(NULL);
+    v->type = JSON_TYPE_STRING;
+    if (len) {
+        v->datum.string = (buffer){ len, len, (char*)malloc(len) };
+        memcpy(v->datum.string.p, p, len);
+    }
+    return v;
+}
+
+json_value* sax_tree_add(sax_tree* t, json_value* v) {
+    if (!t->depth) {
+        t->root = v;
+    } else {
+        v->name = t->name;
+        t->name = NULL;
+        json_value_append_child(t->stack[t->depth - 1], v);
+    }
+    return v;
+}
+
+bool sax_tree_begin(sax_tree* t, json_type type) {
+    json_value* v = json_value_create(NULL);
+    v->type = type;
+    sax_tree_add(t, v);
+    if (t->depth == t->depth_max) {
+        t->depth_max = t->depth_max ? 2 * t->depth_max : 16;
+        t->stack = (json_value**)realloc(t->stack, t->depth_max * sizeof *t->stack);
+    }
+    t->stack[t->depth++] = v;
+    return true;
+}
+bool sax_tree_end(void* ctx) {
+    --((sax_tree*)ctx)->depth;
+    return true;
+}
+bool sax_tree_begin_object(void* ctx) { return sax_tree_begin((sax_tree*)ctx, JSON_TYPE_OBJECT); }
+bool sax_tree_begin_array(void* ctx) { return sax_tree_begin((sax_tree*)ctx, JSON_TYPE_ARRAY); }
+bool sax_tree_key(void* ctx, char const* p, size_t len) {
+    ((sax_tree*)ctx)->name = sax_tree_string(p, len);
+    return true;
+}
+bool sax_tree_string_value(void* ctx, char const* p, size_t len) {
+    sax_tree_add((sax_tree*)ctx, sax_tree_string(p, len));
+    return true;
+}
+bool sax_tree_integer(void* ctx, i64 value) {
+    json_value* v = sax_tree_add((sax_tree*)ctx, json_value_create(NULL));
+    v->type = JSON_TYPE_INTEGER;
+    v->datum.integer = value;
+    return true;
+}
+bool sax_tree_floating(void* ctx, f64 value) {
+    json_value* v = sax_tree_add((sax_tree*)ctx, json_value_create(NULL));
+    v->type = JSON_TYPE_FLOATING;
+    v->datum.floating = value;
+    return true;
+}
+bool sax_tree_boolean(void* ctx, bool value) {
+    json_value* v = sax_tree_add((sax_tree*)ctx, json_value_create(NULL));
+    v->type = JSON_TYPE_BOOLEAN;
+    v->datum.boolean = value;
+    return true;
+}
+bool sax_tree_null(void* ctx) {
+    json_value* v = sax_tree_add((sax_tree*)ctx, json_value_create(NULL));
+    v->type = JSON_TYPE_NULL;
+    return true;
+}
+
+json_sax_handler sax_tree_handler(sax_tree* t) {
+    return (json_sax_handler){
+        .ctx = t,
+        .begin_object = sax_tree_begin_object,
+        .end_object = sax_tree_end,
+        .begin_array = sax_tree_begin_array,
+        .end_array = sax_tree_end,
+        .key = sax_tree_key,
+        .string = sax_tree_string_value,
+        .integer = sax_tree_integer,
+        .floating = sax_tree_floating,
+        .boolean = sax_tree_boolean,
+        .null = sax_tree_null,
+    };
+}
+
+void sax_tree_destroy(sax_tree* t) {
+    json_value_destroy(&t->root);
+    json_value_destroy(&t->name);
+    free(t->stack);
+    *t = (sax_tree){0};
+}
+
+// Check that streaming parsing, with the input fed in chunks of various sizes (and read from the file), succeeds or
+// fails as the tree parser did, and that its events describe the same tree.
+bool check_sax(char const* filename, buffer buf, bool reference_ok, json_data reference) {
+    size_t const chunk_sizes[] = { 1, 7, 4096, 0 };  // 0: All at once.
+    bool ok = true;
+    for (size_t i = 0; i <= sizeof chunk_sizes / sizeof chunk_sizes[0]; ++i) {
+        sax_tree t = {0};
+        bool sax_ok = true;
+        if (i < sizeof chunk_sizes / sizeof chunk_sizes[0]) {
+            size_t const chunk_size = chunk_sizes[i] ? chunk_sizes[i] : MAX(buf.len, 1);
+            json_sax_parser parser;
+            json_sax_parser_init(&parser, sax_tree_handler(&t));
+            for (size_t offset = 0; sax_ok && offset < buf.len; offset += chunk_size) {
+                sax_ok = json_sax_feed(&parser, buf.p + offset, MIN(chunk_size, buf.len - offset));
+            }
+            sax_ok = sax_ok && json_sax_finish(&parser);
+            json_sax_parser_destroy(&parser);
+        } else {
+            sax_ok = json_sax_parse_file(filename, sax_tree_handler(&t));
+        }
+        if (sax_ok != reference_ok || (sax_ok && !json_value_eq(t.root, reference))) {
+            fprintf(stderr, "[ERROR] Streaming parse differs from the tree parser's (chunk size %zu).\n",
+                    i < sizeof chunk_sizes / sizeof chunk_sizes[0] ? chunk_sizes[i] : JSON_SAX_CHUNK_SIZE);
+            ok = false;
+        }
+        sax_tree_destroy(&t);
+    }
+    return ok;
+}
+
+// Check every number in buf (found through its tape) against the C library: strtoll() for integers, and the correctly
+// rounded strtod() for everything else.
+bool check_numbers(buffer buf) {
+    json_tape tape = {0};
+    if (!json_tape_build(buf, JSON_SCANNER_SCALAR, &tape)) {
+        return false;
+    }
+    bool ok = true;
+    char text[512];
+    for (size_t i = 0; i < tape.count; ++i) {
+        size_t offset = tape.offsets[i];
+        char const ch = buf.p[offset];
+        if (!('-' == ch || ('0' <= ch && ch <= '9'))) {
+            continue;
+        }
+        size_t const start = offset;
+        json_value number = {0};
+        if (!json_parse_number(buf, &offset, &number)) {
+            continue;  // The parse fails, which the other checks cover.
+        }
+        size_t const len = offset - start;
+        if (len >= sizeof text) {
+            continue;
+        }
+        memcpy(text, buf.p + start, len);
+        text[len] = '\0';
+        bool same;
+        if (number.type == JSON_TYPE_INTEGER) {
+            same = number.datum.integer == strtoll(text, NULL, 10);
+        } else {
+            f64 const expected = strtod(text, NULL);
+            same = 0 == memcmp(&number.datum.floating, &expected, sizeof expected);
+        }
+        if (!same) {
+            fprintf(stderr, "[ERROR] Number %s at offset %zu parsed incorrectly.\n", text, start);
+            ok = false;
+        }
+    }
+    json_tape_destroy(&tape);
+    return ok;
+}
+
+// Check that writing the tree, compactly and indented, and parsing the output, gives back the same tree.
+bool check_writer(json_data data) {
+    bool ok = true;
+    u32 const indents[] = { 0, 4 };
+    for (size_t i = 0; i < sizeof indents / sizeof indents[0]; ++i) {
+        json_writer w;
+        json_writer_init(&w, indents[i]);
+        json_data written = NULL;
+        if (!json_writer_value(&w, data) || !json_read_from_buffer(w.out, &written, NULL)
+            || !json_value_eq(written, data)) {
+            fprintf(stderr, "[ERROR] Written JSON (indent %u) doesn't parse back to the same tree.\n", indents[i]);
+            ok = false;
+        }
+        json_data_destroy(&written);
+        json_writer_destroy(&w);
+    }
+    return ok;
+}
+
+// Check that escape sequences in strings are decoded as expected, and that the decoded strings are written back so that
+// they parse to the same strings.
+bool check_strings(void) {
+    struct { char const* json; char const* decoded; size_t decoded_len; } const cases[] = {
+        { "[\"\\\\u0041\"]", "\\u0041", 6 },  // A backslash, and then "u0041".
+        { "[\"\\u0041\"]", "A", 1 },
+        { "[\"\\u00e9\"]", "\xC3\xA9", 2 },
+        { "[\"\\u20AC\"]", "\xE2\x82\xAC", 3 },
+        { "[\"\\ud83d\\ude00\"]", "\xF0\x9F\x98\x80", 4 },
+        { "[\"\\ud83d!\"]", "\xEF\xBF\xBD!", 4 },  // An unpaired surrogate.
+        { "[\"\\u0000\"]", "\0", 1 },
+        { "[\"C:\\\\dir\\\\u00ff\"]", "C:\\dir\\u00ff", 12 },
+        { "[\"\\u00g0\"]", NULL, 0 },  // Invalid.
+        { "[\"\\u00\"]", NULL, 0 },
+    };
+    bool ok = true;
+    for (size_t i = 0; i < sizeof cases / sizeof cases[0]; ++i) {
+        char text[64];
+        size_t const len = strlen(cases[i].json);
+        memcpy(text, cases[i].json, len);
+        json_data data = NULL;
+        bool const parsed = json_read_from_buffer((buffer){ len, sizeof text, text }, &data, NULL);
+        if (!cases[i].decoded) {
+            if (parsed) {
+                fprintf(stderr, "[ERROR] String %s should fail to parse.\n", cases[i].json);
+                ok = false;
+            }
+        } else if (!parsed || data->child->datum.string.len != cases[i].decoded_len
+            || memcmp(data->child->datum.string.p, cases[i].decoded, cases[i].decoded_len)) {
+            fprintf(stderr, "[ERROR] String %s decoded incorrectly.\n", cases[i].json);
+            ok = false;
+        } else if (!check_writer(data)) {
+            ok = false;
+        }
+        json_data_destroy(&data);
+    }
+    return ok;
+}
+
+// Check that numbers too large for an f64 fail to parse, rather than becoming infinities (which JSON can't represent,
+// so the writer writes them as null), and that those at the limits round-trip.
+bool check_number_range(void) {
+    struct { char const* json; bool valid; } const cases[] = {
+        { "[1e400]", false },
+        { "[-1e400]", false },
+        { "[1.8e308]", false },
+        { "[1.7976931348623157e308]", true },
+        { "[-1.7976931348623157e308]", true },
+        { "[4.9e-324]", true },
+        { "[1e-400]", true },
+    };
+    bool ok = true;
+    for (size_t i = 0; i < sizeof cases / sizeof cases[0]; ++i) {
+        char text[64];
+        size_t const len = strlen(cases[i].json);
+        memcpy(text, cases[i].json, len);
+        json_data data = NULL;
+        bool const parsed = json_read_from_buffer((buffer){ len, sizeof text, text }, &data, NULL);
+        if (parsed != cases[i].valid) {
+            fprintf(stderr, "[ERROR] Number %s should %s.\n", cases[i].json,
+                    cases[i].valid ? "parse" : "fail to parse");
+            ok = false;
+        } else if (parsed && !check_writer(data)) {
+            ok = false;
+        }
+        json_data_destroy(&data);
+    }
+    return ok;
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 2) {
         fprintf(stderr, "Usage: json_test <json_filename>\n");
         return 1;
     }
     char const* const filename = argv[1];
+    file_view view;
+    if (!file_view_open(filename, &view)) {
+        printf("Failed to parse JSON file %s.\n", filename);
+        return EXIT_FAILURE;
+    }
+    json_scanner_selected = JSON_SCANNER_SCALAR;
     json_data data = {0};
-    if (json_read_from_file(filename, &data)) {
+    bool const ok = json_read_from_buffer(view.buf, &data, NULL);
+    bool const scanners_agree = check_scanners(view.buf, ok, data);
+    bool const sax_agrees = check_sax(filename, view.buf, ok, data);
+    bool const numbers_ok = check_numbers(view.buf);
+    // Key indexes are allocated differently for trees in an arena, so check those, too.
+    bool key_index_ok = true;
+    bool writer_ok = true;
+    if (ok) {
+        writer_ok = check_writer(data);
+        arena ar = {0};
+        json_data data_in_arena = NULL;
+        key_index_ok = check_key_index(data)
+            && json_read_from_buffer(view.buf, &data_in_arena, &ar) && check_key_index(data_in_arena);
+        json_data_destroy(&data_in_arena);
+        arena_destroy(&ar);
+    }
+    file_view_close(&view);
+    if (ok) {
         //printf("Successfully parsed JSON file %s. Contents:\n", filename);
         json_data_printf(&data);
         json_data_destroy(&data);
     } else {
         printf("Failed to parse JSON file %s.\n", filename);
+    }
+    if (!ok || !scanners_agree || !sax_agrees || !numbers_ok || !key_index_ok || !writer_ok || !check_strings()
+        || !check_number_range()) {
         return EXIT_FAILURE;
     }
     /*